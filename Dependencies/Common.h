@@ -1,5 +1,8 @@
 #pragma once
 
+// Projects that define COMMON_MOD_DATABASE get the mod config and file queries at the end of this
+// header from ModDatabase.h, cached and indexed, at the cost of its oneTBB and xxHash requirements.
+
 #define PI 3.141592
 #define PI_F 3.141592f
 #define DEG_TO_RAD PI_F / 180.0f
@@ -1939,6 +1942,7 @@ inline bool SolveBallisticArc
 	return true;
 }
 
+#ifndef COMMON_MOD_DATABASE
 inline bool IsFileExist(std::string const& file)
 {
 	struct stat buffer;
@@ -2111,6 +2115,7 @@ inline bool TestModPriority(std::string const& currentModName, std::string const
 	// Mod not found
 	return false;
 }
+#endif
 
 inline std::string wideCharToMultiByte(LPCWSTR value)
 {
@@ -2126,6 +2131,7 @@ inline std::wstring multiByteToWideChar(const char* value)
 	return std::wstring(wideChar);
 }
 
+#ifndef COMMON_MOD_DATABASE
 inline bool DoesArchiveExist(std::string const& archiveName, std::set<std::string> ignoreModList = {})
 {
 	std::vector<std::string> modIniList;
@@ -2160,5 +2166,10 @@ inline bool DoesArchiveExist(std::string const& archiveName, std::set<std::strin
 	}
 	return false;
 }
+#endif
 
 } // namespace Common
+
+#ifdef COMMON_MOD_DATABASE
+#include "ModDatabase.h"
+#endif
@@ -0,0 +1,283 @@
+#pragma once
+
+// CPU decoding of BC1-BC5 textures, for devices that can't sample the format a texture was shipped in.
+// BC1-BC3 and BC5 decode to B8G8R8A8 (D3DFMT_A8R8G8B8 in memory), BC5 into red and green like D3D10
+// samples it. BC4 decodes to R8. Every value is the format's exact UNORM value rounded once: 565
+// palettes are interpolated from the unexpanded endpoints, so the output matches a floating point
+// decode bit for bit.
+// Decoding is scalar and single threaded: BCDecoderBench measured an SSE2 palette select and
+// splitting surfaces over oneTBB workers both slower at the sizes the loaders decode.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "DDSLayout.h"
+
+namespace BCDecoder
+{
+
+using Compression = DDSLayout::Compression;
+
+// Bytes per decoded pixel, 0 if the format can't be decoded
+inline uint32_t GetOutputBytes(Compression compression)
+{
+	switch (compression)
+	{
+	case Compression::BC1:
+	case Compression::BC2:
+	case Compression::BC3:
+	case Compression::BC5: return 4;
+	case Compression::BC4: return 1;
+	default: return 0;
+	}
+}
+
+namespace Detail
+{
+
+inline uint16_t Read16(const uint8_t* data)
+{
+	return (uint16_t)(data[0] | (data[1] << 8));
+}
+
+inline uint32_t Read32(const uint8_t* data)
+{
+	uint32_t value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+inline uint64_t Read48(const uint8_t* data)
+{
+	uint64_t value = 0;
+	memcpy(&value, data, 6);
+	return value;
+}
+
+// (w0 * c0 + w1 * c1) / divisor of two maximum based UNORM values, to 8 bits rounded to nearest
+inline uint32_t InterpolateChannel(uint32_t c0, uint32_t c1, uint32_t w0, uint32_t w1, uint32_t divisor, uint32_t maximum)
+{
+	uint32_t denominator = divisor * maximum;
+	return (510 * (w0 * c0 + w1 * c1) + denominator) / (2 * denominator);
+}
+
+// BGRA, alpha opaque
+inline uint32_t Interpolate565(uint16_t color0, uint16_t color1, uint32_t w0, uint32_t w1, uint32_t divisor)
+{
+	uint32_t r = InterpolateChannel(color0 >> 11, color1 >> 11, w0, w1, divisor, 31);
+	uint32_t g = InterpolateChannel((color0 >> 5) & 63, (color1 >> 5) & 63, w0, w1, divisor, 63);
+	uint32_t b = InterpolateChannel(color0 & 31, color1 & 31, w0, w1, divisor, 31);
+	return b | (g << 8) | (r << 16) | 0xFF000000;
+}
+
+// BC2 and BC3 always use four colors, BC1 has a punch through mode when color0 <= color1
+inline void GetColorPalette(const uint8_t* block, bool punchThrough, uint32_t palette[4])
+{
+	uint16_t color0 = Read16(block), color1 = Read16(block + 2);
+	palette[0] = Interpolate565(color0, color1, 1, 0, 1);
+	palette[1] = Interpolate565(color0, color1, 0, 1, 1);
+
+	if (color0 > color1 || !punchThrough)
+	{
+		palette[2] = Interpolate565(color0, color1, 2, 1, 3);
+		palette[3] = Interpolate565(color0, color1, 1, 2, 3);
+	}
+	else
+	{
+		palette[2] = Interpolate565(color0, color1, 1, 1, 2);
+		palette[3] = 0;
+	}
+}
+
+inline void GetChannelPalette(const uint8_t* block, uint8_t palette[8])
+{
+	uint32_t value0 = block[0], value1 = block[1];
+	palette[0] = (uint8_t)value0;
+	palette[1] = (uint8_t)value1;
+
+	if (value0 > value1)
+	{
+		for (uint32_t i = 2; i < 8; i++)
+		{
+			palette[i] = (uint8_t)(((8 - i) * value0 + (i - 1) * value1 + 3) / 7);
+		}
+	}
+	else
+	{
+		for (uint32_t i = 2; i < 6; i++)
+		{
+			palette[i] = (uint8_t)(((6 - i) * value0 + (i - 1) * value1 + 2) / 5);
+		}
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+}
+
+// 16 values of a BC4 style block in pixel order
+inline void DecodeChannelScalar(const uint8_t* block, uint8_t output[16])
+{
+	uint8_t palette[8];
+	GetChannelPalette(block, palette);
+
+	uint64_t indices = Read48(block + 2);
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		output[i] = palette[(indices >> (3 * i)) & 7];
+	}
+}
+
+// 16 BGRA pixels of a color block in pixel order
+inline void DecodeColorScalar(const uint8_t* block, bool punchThrough, uint32_t output[16])
+{
+	uint32_t palette[4];
+	GetColorPalette(block, punchThrough, palette);
+
+	uint32_t indices = Read32(block + 4);
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		output[i] = palette[(indices >> (2 * i)) & 3];
+	}
+}
+
+// Decodes one block into 16 pixels of GetOutputBytes each, in pixel order
+inline void DecodeBlockScalar(Compression compression, const uint8_t* block, uint8_t* output)
+{
+	uint32_t* pixels = reinterpret_cast<uint32_t*>(output);
+	uint8_t channel[16], channel2[16];
+
+	switch (compression)
+	{
+	case Compression::BC1:
+		DecodeColorScalar(block, true, pixels);
+		break;
+
+	case Compression::BC2:
+	{
+		DecodeColorScalar(block + 8, false, pixels);
+		uint64_t alpha;
+		memcpy(&alpha, block, sizeof(alpha));
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			pixels[i] = (pixels[i] & 0x00FFFFFF) | ((uint32_t)((alpha >> (4 * i)) & 15) * 17 << 24);
+		}
+		break;
+	}
+
+	case Compression::BC3:
+		DecodeColorScalar(block + 8, false, pixels);
+		DecodeChannelScalar(block, channel);
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			pixels[i] = (pixels[i] & 0x00FFFFFF) | ((uint32_t)channel[i] << 24);
+		}
+		break;
+
+	case Compression::BC4:
+		DecodeChannelScalar(block, output);
+		break;
+
+	case Compression::BC5:
+		DecodeChannelScalar(block, channel);
+		DecodeChannelScalar(block + 8, channel2);
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			pixels[i] = 0xFF000000 | ((uint32_t)channel[i] << 16) | ((uint32_t)channel2[i] << 8);
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+} // namespace Detail
+
+// Decodes one 4x4 block to output, pitch bytes between its rows
+inline void DecodeBlock(Compression compression, const uint8_t* block, uint8_t* output, size_t pitch)
+{
+	uint8_t pixels[64];
+	uint32_t bytes = GetOutputBytes(compression);
+	Detail::DecodeBlockScalar(compression, block, pixels);
+	for (uint32_t row = 0; row < 4; row++)
+	{
+		memcpy(output + row * pitch, pixels + row * 4 * bytes, 4 * bytes);
+	}
+}
+
+// Decodes a width x height surface of blocks to output, pitch bytes between its rows.
+// Returns false for formats that can't be decoded.
+inline bool DecodeSurface(Compression compression, const uint8_t* source, uint32_t width, uint32_t height, uint8_t* output, size_t pitch)
+{
+	uint32_t bytes = GetOutputBytes(compression);
+	if (!bytes)
+	{
+		return false;
+	}
+
+	uint32_t blockBytes = compression == Compression::BC1 || compression == Compression::BC4 ? 8 : 16;
+	uint32_t blocksWide = std::max<uint32_t>(1, (width + 3) / 4);
+	uint32_t blocksHigh = std::max<uint32_t>(1, (height + 3) / 4);
+
+	const uint8_t* block = source;
+	for (uint32_t y = 0; y < blocksHigh; y++)
+	{
+		uint32_t rows = std::min<uint32_t>(4, height - y * 4);
+		for (uint32_t x = 0; x < blocksWide; x++, block += blockBytes)
+		{
+			uint8_t* destination = output + (size_t)y * 4 * pitch + (size_t)x * 4 * bytes;
+			uint32_t columns = std::min<uint32_t>(4, width - x * 4);
+			if (rows == 4 && columns == 4)
+			{
+				DecodeBlock(compression, block, destination, pitch);
+				continue;
+			}
+
+			// Edge blocks of surfaces that aren't a multiple of 4
+			uint8_t pixels[64];
+			Detail::DecodeBlockScalar(compression, block, pixels);
+			for (uint32_t row = 0; row < rows; row++)
+			{
+				memcpy(destination + row * pitch, pixels + row * 4 * bytes, columns * bytes);
+			}
+		}
+	}
+
+	return true;
+}
+
+// Decodes every subresource of a parsed file into output, tightly packed in the same order.
+// Returns false for formats that can't be decoded.
+inline bool Decode(DDSLayout const& layout, const uint8_t* data, std::vector<uint8_t>& output)
+{
+	uint32_t bytes = GetOutputBytes(layout.compression);
+	if (!bytes)
+	{
+		return false;
+	}
+
+	size_t size = 0;
+	for (DDSLayout::Subresource const& subresource : layout.subresources)
+	{
+		size += (size_t)subresource.width * subresource.height * subresource.depth * bytes;
+	}
+	output.resize(size);
+
+	uint8_t* destination = output.data();
+	for (DDSLayout::Subresource const& subresource : layout.subresources)
+	{
+		size_t sliceSize = (size_t)subresource.rowPitch * subresource.rowCount;
+		size_t pitch = (size_t)subresource.width * bytes;
+
+		for (uint32_t slice = 0; slice < subresource.depth; slice++, destination += pitch * subresource.height)
+		{
+			DecodeSurface(layout.compression, data + subresource.offset + slice * sliceSize, subresource.width, subresource.height, destination, pitch);
+		}
+	}
+
+	return true;
+}
+
+} // namespace BCDecoder
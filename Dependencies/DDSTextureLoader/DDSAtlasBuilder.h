@@ -0,0 +1,564 @@
+#pragma once
+
+// Packs small DDS textures into shared atlases, so UI heavy mods cost a handful of resources and
+// binds instead of one per icon. Textures are grouped by identical pixel format and packed with
+// imgui's imstb_rectpack, block compressed ones on whole blocks so no block is ever re-encoded.
+// Only the top mip is used and atlases have no mips. Padding between textures is cleared to zero.
+//
+// Results are cached in a directory under the XXH3 hash of every input's path and contents and of
+// the options: a table "<key>.atlas" plus one "<key>.<n>.dds" per atlas. A cached build maps those
+// instead of packing again.
+//
+//   DDSAtlasBuilder atlases;
+//   atlases.Build(uiTextures, L"cache\\atlas");
+//   for (auto const& atlas : atlases.GetAtlases())
+//       DirectX::CreateDDSTextureFromMemory(device, atlas.data.data(), atlas.data.size(), ...);
+//   if (auto placement = atlases.Find(L"mods\\Foo\\ui\\icon.dds"))
+//       // Sample atlas placement->atlas between (u0, v0) and (u1, v1)
+//
+// Textures that aren't placed (too large, cube maps, arrays, volumes, unreadable) are left to the
+// caller. Requires Dependencies\imgui and Dependencies\xxHash in the include path. Defining
+// DDS_LOADER_LZ4 adds .dds.lz4 inputs, which needs Dependencies\lz4\include in the include path and
+// liblz4_static.lib linked.
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifndef STB_RECT_PACK_IMPLEMENTATION
+#define STBRP_STATIC
+#define STB_RECT_PACK_IMPLEMENTATION
+#endif
+#include <imstb_rectpack.h>
+
+#define XXH_INLINE_ALL
+#include <xxhash.h>
+
+#include "../MappedFile.h"
+#include "DDSLayout.h"
+#ifdef DDS_LOADER_LZ4
+#include "DDSLz4.h"
+#endif
+
+class DDSAtlasBuilder
+{
+public:
+	struct Options
+	{
+		uint32_t maxInputSize = 256;	// Largest width or height packed
+		uint32_t atlasSize = 2048;		// Largest width and height of an atlas
+		uint32_t padding = 4;			// Pixels between textures, whole blocks for compressed formats
+	};
+
+	struct Placement
+	{
+		std::string path;
+		uint32_t atlas;
+		uint32_t x;
+		uint32_t y;
+		uint32_t width;
+		uint32_t height;
+		float u0;
+		float v0;
+		float u1;
+		float v1;
+	};
+
+	struct Atlas
+	{
+		std::vector<uint8_t> data;		// A complete DDS file
+		uint32_t width;
+		uint32_t height;
+	};
+
+	DDSAtlasBuilder() = default;
+
+	explicit DDSAtlasBuilder(Options const& options) : m_options(options)
+	{
+	}
+
+	// Packs every eligible texture, or loads the result of an earlier identical build from
+	// cacheDirectory. An empty cacheDirectory always packs and stores nothing.
+	// Returns false if nothing could be read or the cache couldn't be written.
+	bool Build(std::vector<std::filesystem::path> const& textures, std::filesystem::path const& cacheDirectory = {})
+	{
+		m_atlases.clear();
+		m_placements.clear();
+		m_index.clear();
+
+		std::vector<Input> inputs;
+		inputs.reserve(textures.size());
+		for (std::filesystem::path const& path : textures)
+		{
+			Input input;
+			input.path = path.lexically_normal().string();
+			if (Read(path, input.data))
+			{
+				inputs.push_back(std::move(input));
+			}
+		}
+
+		if (inputs.empty())
+		{
+			return false;
+		}
+
+		std::sort(inputs.begin(), inputs.end(), [](Input const& a, Input const& b) { return a.path < b.path; });
+		m_key = GetKey(inputs);
+
+		if (!cacheDirectory.empty() && LoadCache(cacheDirectory))
+		{
+			return true;
+		}
+
+		Pack(inputs);
+		Reindex();
+		return cacheDirectory.empty() || SaveCache(cacheDirectory);
+	}
+
+	std::vector<Atlas> const& GetAtlases() const
+	{
+		return m_atlases;
+	}
+
+	std::vector<Placement> const& GetPlacements() const
+	{
+		return m_placements;
+	}
+
+	Placement const* Find(std::filesystem::path const& path) const
+	{
+		auto it = m_index.find(GetPathKey(path.lexically_normal().string()));
+		return it != m_index.end() ? &m_placements[it->second] : nullptr;
+	}
+
+	// Hash of the last build's inputs and options
+	uint64_t GetKey() const
+	{
+		return m_key;
+	}
+
+private:
+	static constexpr uint32_t c_magic = 0x53544C41; // "ALTS"
+	static constexpr uint32_t c_version = 1;
+
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t payloadSize;
+		uint64_t payloadHash;
+	};
+
+	struct Input
+	{
+		std::string path;
+		std::vector<uint8_t> data;		// Decompressed when it was a .dds.lz4 container
+		DDSLayout layout;
+	};
+
+	struct Reader
+	{
+		const uint8_t* current;
+		const uint8_t* end;
+		bool valid{ true };
+
+		template<typename T>
+		T Read()
+		{
+			T value{};
+			if (!valid || (size_t)(end - current) < sizeof(T))
+			{
+				valid = false;
+				return value;
+			}
+
+			memcpy(&value, current, sizeof(T));
+			current += sizeof(T);
+			return value;
+		}
+
+		std::string ReadString()
+		{
+			uint32_t length = Read<uint32_t>();
+			if (!valid || (size_t)(end - current) < length)
+			{
+				valid = false;
+				return {};
+			}
+
+			std::string value(reinterpret_cast<const char*>(current), length);
+			current += length;
+			return value;
+		}
+	};
+
+	Options m_options;
+	uint64_t m_key{};
+	std::vector<Atlas> m_atlases;
+	std::vector<Placement> m_placements;
+	std::unordered_map<uint64_t, size_t> m_index;	// Hash of the lowercased path
+
+	template<typename T>
+	static void Write(std::string& payload, T value)
+	{
+		payload.append(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	static void WriteString(std::string& payload, std::string_view value)
+	{
+		Write(payload, (uint32_t)value.size());
+		payload.append(value);
+	}
+
+	static uint64_t GetPathKey(std::string path)
+	{
+		for (char& c : path)
+		{
+			c = (char)std::tolower((unsigned char)c);
+		}
+		return XXH3_64bits(path.data(), path.size());
+	}
+
+	static bool Read(std::filesystem::path const& path, std::vector<uint8_t>& data)
+	{
+		MappedFile file(path);
+		if (!file)
+		{
+			return false;
+		}
+
+#ifdef DDS_LOADER_LZ4
+		if (DDSLz4::IsFrame(file.GetData(), file.GetSize()))
+		{
+			size_t size = DDSLz4::GetContentSize(file.GetData(), file.GetSize());
+			data.resize(size);
+			return size && DDSLz4::Decompress(file.GetData(), file.GetSize(), data.data(), size);
+		}
+#endif
+
+		data.assign(file.GetData(), file.GetData() + file.GetSize());
+		return true;
+	}
+
+	uint64_t GetKey(std::vector<Input> const& inputs) const
+	{
+		XXH3_state_t state;
+		XXH3_64bits_reset(&state);
+		XXH3_64bits_update(&state, &c_version, sizeof(c_version));
+		XXH3_64bits_update(&state, &m_options, sizeof(m_options));
+		for (Input const& input : inputs)
+		{
+			uint64_t sizes[2] = { input.path.size(), input.data.size() };
+			XXH3_64bits_update(&state, sizes, sizeof(sizes));
+			XXH3_64bits_update(&state, input.path.data(), input.path.size());
+			XXH3_64bits_update(&state, input.data.data(), input.data.size());
+		}
+		return XXH3_64bits_digest(&state);
+	}
+
+	// Every header field that decides how pixels are stored, textures only share an atlas when these match
+	static uint64_t GetFormatKey(DDSLayout const& layout)
+	{
+		DDSLayout::PixelFormat format = layout.header.ddspf;
+		uint32_t dxgiFormat = layout.hasDXT10 ? layout.dxt10.dxgiFormat : 0;
+		uint64_t key = XXH3_64bits(&format, sizeof(format));
+		return XXH3_64bits_withSeed(&dxgiFormat, sizeof(dxgiFormat), key);
+	}
+
+	static uint32_t NextPowerOfTwo(uint32_t value)
+	{
+		uint32_t result = 1;
+		while (result < value)
+		{
+			result <<= 1;
+		}
+		return result;
+	}
+
+	void Pack(std::vector<Input>& inputs)
+	{
+		// Grouped by format in a stable order, so identical inputs always give identical atlases
+		std::map<uint64_t, std::vector<Input*>> groups;
+		for (Input& input : inputs)
+		{
+			DDSLayout& layout = input.layout;
+			if (!layout.Parse(input.data.data(), input.data.size()) || layout.isCube || layout.isVolume || layout.arraySize != 1 ||
+				std::max<uint32_t>(layout.width, layout.height) > std::min<uint32_t>(m_options.maxInputSize, m_options.atlasSize) ||
+				(!layout.GetBlockBytes() && layout.bitsPerPixel % 8))
+			{
+				continue;
+			}
+
+			groups[GetFormatKey(layout)].push_back(&input);
+		}
+
+		for (auto& group : groups)
+		{
+			PackGroup(group.second);
+		}
+	}
+
+	// Rectangles are in units of one block for compressed formats and one pixel otherwise
+	void PackGroup(std::vector<Input*>& members)
+	{
+		DDSLayout const& format = members.front()->layout;
+		uint32_t unit = format.GetBlockBytes() ? 4 : 1;
+		uint32_t padding = (m_options.padding + unit - 1) / unit;
+		uint32_t atlasUnits = m_options.atlasSize / unit;
+
+		// Textures that don't fit an empty atlas with their padding are left out
+		std::vector<stbrp_rect> pending;
+		for (size_t i = 0; i < members.size(); i++)
+		{
+			DDSLayout const& layout = members[i]->layout;
+			stbrp_rect rect{};
+			rect.id = (int)i;
+			rect.w = (stbrp_coord)((layout.width + unit - 1) / unit + padding);
+			rect.h = (stbrp_coord)((layout.height + unit - 1) / unit + padding);
+			if (rect.w <= atlasUnits && rect.h <= atlasUnits)
+			{
+				pending.push_back(rect);
+			}
+		}
+
+		std::vector<stbrp_node> nodes(atlasUnits);
+		while (!pending.empty())
+		{
+			stbrp_context context;
+			stbrp_init_target(&context, (int)atlasUnits, (int)atlasUnits, nodes.data(), (int)nodes.size());
+			stbrp_pack_rects(&context, pending.data(), (int)pending.size());
+
+			std::vector<stbrp_rect> packed, rest;
+			for (stbrp_rect const& rect : pending)
+			{
+				(rect.was_packed ? packed : rest).push_back(rect);
+			}
+
+			// Can't happen with the sizes above, but never loop on it
+			if (packed.empty())
+			{
+				break;
+			}
+
+			WriteAtlas(members, packed, unit);
+			pending = std::move(rest);
+		}
+	}
+
+	void WriteAtlas(std::vector<Input*> const& members, std::vector<stbrp_rect> const& rects, uint32_t unit)
+	{
+		DDSLayout const& format = members.front()->layout;
+
+		uint32_t usedWidth = 0, usedHeight = 0;
+		for (stbrp_rect const& rect : rects)
+		{
+			DDSLayout const& layout = members[rect.id]->layout;
+			usedWidth = std::max<uint32_t>(usedWidth, (uint32_t)rect.x * unit + layout.width);
+			usedHeight = std::max<uint32_t>(usedHeight, (uint32_t)rect.y * unit + layout.height);
+		}
+
+		// Power of two sizes unless that exceeds atlasSize, which the packer kept everything within
+		uint32_t maxSize = m_options.atlasSize / unit * unit;
+		Atlas atlas;
+		atlas.width = std::min<uint32_t>(std::max<uint32_t>(NextPowerOfTwo(usedWidth), unit), maxSize);
+		atlas.height = std::min<uint32_t>(std::max<uint32_t>(NextPowerOfTwo(usedHeight), unit), maxSize);
+
+		uint32_t rowPitch, rowCount;
+		format.GetSurfaceInfo(atlas.width, atlas.height, rowPitch, rowCount);
+
+		DDSLayout::Header header = format.header;
+		header.width = atlas.width;
+		header.height = atlas.height;
+		header.mipMapCount = 1;
+		header.pitchOrLinearSize = format.GetBlockBytes() ? rowPitch * rowCount : rowPitch;
+
+		atlas.data.assign(format.dataOffset + (size_t)rowPitch * rowCount, 0);
+		memcpy(atlas.data.data(), &DDSLayout::c_magic, sizeof(uint32_t));
+		memcpy(atlas.data.data() + sizeof(uint32_t), &header, sizeof(header));
+		if (format.hasDXT10)
+		{
+			memcpy(atlas.data.data() + sizeof(uint32_t) + sizeof(header), &format.dxt10, sizeof(format.dxt10));
+		}
+
+		uint32_t atlasIndex = (uint32_t)m_atlases.size();
+		uint32_t unitBytes = format.GetBlockBytes() ? format.GetBlockBytes() : format.bitsPerPixel / 8;
+		uint8_t* pixels = atlas.data.data() + format.dataOffset;
+		for (stbrp_rect const& rect : rects)
+		{
+			Input const& input = *members[rect.id];
+			DDSLayout::Subresource const& top = input.layout.GetSubresource(0, 0);
+
+			size_t offset = (size_t)rect.x * unitBytes;
+			for (uint32_t row = 0; row < top.rowCount; row++)
+			{
+				memcpy(pixels + ((size_t)rect.y + row) * rowPitch + offset, input.data.data() + top.offset + (size_t)row * top.rowPitch, top.rowPitch);
+			}
+
+			uint32_t x = rect.x * unit, y = rect.y * unit;
+			m_placements.push_back({ input.path, atlasIndex, x, y, top.width, top.height,
+				(float)x / atlas.width, (float)y / atlas.height,
+				(float)(x + top.width) / atlas.width, (float)(y + top.height) / atlas.height });
+		}
+
+		m_atlases.push_back(std::move(atlas));
+	}
+
+	void Reindex()
+	{
+		m_index.clear();
+		for (size_t i = 0; i < m_placements.size(); i++)
+		{
+			m_index.emplace(GetPathKey(m_placements[i].path), i);
+		}
+	}
+
+	std::filesystem::path GetCachePath(std::filesystem::path const& directory, const char* suffix) const
+	{
+		char name[64];
+		snprintf(name, sizeof(name), "%016llx%s", (unsigned long long)m_key, suffix);
+		return directory / name;
+	}
+
+	bool LoadCache(std::filesystem::path const& directory)
+	{
+		MappedFile file(GetCachePath(directory, ".atlas"));
+		if (!file || file.GetSize() < sizeof(Header))
+		{
+			return false;
+		}
+
+		Header header;
+		memcpy(&header, file.GetData(), sizeof(Header));
+		if (header.magic != c_magic || header.version != c_version || header.payloadSize != file.GetSize() - sizeof(Header) ||
+			XXH3_64bits(file.GetData() + sizeof(Header), (size_t)header.payloadSize) != header.payloadHash)
+		{
+			return false;
+		}
+
+		Reader reader{ file.GetData() + sizeof(Header), file.GetData() + file.GetSize() };
+		std::vector<Atlas> atlases(reader.Read<uint32_t>());
+		for (size_t i = 0; i < atlases.size() && reader.valid; i++)
+		{
+			atlases[i].width = reader.Read<uint32_t>();
+			atlases[i].height = reader.Read<uint32_t>();
+
+			MappedFile atlasFile(GetCachePath(directory, ("." + std::to_string(i) + ".dds").c_str()));
+			if (!atlasFile)
+			{
+				return false;
+			}
+			atlases[i].data.assign(atlasFile.GetData(), atlasFile.GetData() + atlasFile.GetSize());
+		}
+
+		std::vector<Placement> placements(reader.Read<uint32_t>());
+		for (Placement& placement : placements)
+		{
+			placement.path = reader.ReadString();
+			placement.atlas = reader.Read<uint32_t>();
+			placement.x = reader.Read<uint32_t>();
+			placement.y = reader.Read<uint32_t>();
+			placement.width = reader.Read<uint32_t>();
+			placement.height = reader.Read<uint32_t>();
+			placement.u0 = reader.Read<float>();
+			placement.v0 = reader.Read<float>();
+			placement.u1 = reader.Read<float>();
+			placement.v1 = reader.Read<float>();
+			if (!reader.valid || placement.atlas >= atlases.size())
+			{
+				return false;
+			}
+		}
+
+		if (!reader.valid || reader.current != reader.end)
+		{
+			return false;
+		}
+
+		m_atlases = std::move(atlases);
+		m_placements = std::move(placements);
+		Reindex();
+		return true;
+	}
+
+	// The table is written last and renamed into place, it only ever refers to complete atlases
+	bool SaveCache(std::filesystem::path const& directory) const
+	{
+		std::error_code ec;
+		std::filesystem::create_directories(directory, ec);
+
+		for (size_t i = 0; i < m_atlases.size(); i++)
+		{
+			std::ofstream stream(GetCachePath(directory, ("." + std::to_string(i) + ".dds").c_str()), std::ios::binary | std::ios::trunc);
+			stream.write(reinterpret_cast<const char*>(m_atlases[i].data.data()), (std::streamsize)m_atlases[i].data.size());
+			if (!stream)
+			{
+				return false;
+			}
+		}
+
+		std::string payload;
+		Write(payload, (uint32_t)m_atlases.size());
+		for (Atlas const& atlas : m_atlases)
+		{
+			Write(payload, atlas.width);
+			Write(payload, atlas.height);
+		}
+
+		Write(payload, (uint32_t)m_placements.size());
+		for (Placement const& placement : m_placements)
+		{
+			WriteString(payload, placement.path);
+			Write(payload, placement.atlas);
+			Write(payload, placement.x);
+			Write(payload, placement.y);
+			Write(payload, placement.width);
+			Write(payload, placement.height);
+			Write(payload, placement.u0);
+			Write(payload, placement.v0);
+			Write(payload, placement.u1);
+			Write(payload, placement.v1);
+		}
+
+		Header header{ c_magic, c_version, payload.size(), XXH3_64bits(payload.data(), payload.size()) };
+
+		std::filesystem::path table = GetCachePath(directory, ".atlas");
+		std::filesystem::path temporary = table;
+		temporary += "." + std::to_string(XXH3_64bits_withSeed(&header, sizeof(header),
+			std::hash<std::thread::id>()(std::this_thread::get_id()) ^ (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count())) + ".tmp";
+
+		{
+			std::ofstream stream(temporary, std::ios::binary | std::ios::trunc);
+			stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			stream.write(payload.data(), (std::streamsize)payload.size());
+			if (!stream)
+			{
+				stream.close();
+				std::filesystem::remove(temporary, ec);
+				return false;
+			}
+		}
+
+		std::filesystem::rename(temporary, table, ec);
+		if (ec)
+		{
+			std::filesystem::remove(temporary, ec);
+			return false;
+		}
+
+		return true;
+	}
+};
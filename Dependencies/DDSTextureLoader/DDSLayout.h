@@ -0,0 +1,368 @@
+#pragma once
+
+// Portable DDS header parsing and subresource layout, shared by the streaming, caching and
+// conversion code around DDSTextureLoader9/11. Covers the block compressed formats, the common
+// uncompressed DXGI and legacy formats, cube maps, arrays and volumes. Anything else fails to
+// parse, callers fall back to the regular loader for those.
+//
+// Subresources are in file order: every array item (cube face) holds its full mip chain.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+class DDSLayout
+{
+public:
+	static constexpr uint32_t c_magic = 0x20534444; // "DDS "
+	static constexpr uint32_t c_fourCCFlag = 0x4;	// DDS_FOURCC, PixelFormat::fourCC is set
+
+	// D3D11 resource limits, anything larger can't be created and fails to parse
+	static constexpr uint32_t c_maxDimension = 16384;	// D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION
+	static constexpr uint32_t c_maxVolumeDimension = 2048;	// D3D11_REQ_TEXTURE3D_U_V_OR_W_DIMENSION
+	static constexpr uint32_t c_maxArraySize = 2048;	// D3D11_REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION
+
+#pragma pack(push, 1)
+	struct PixelFormat
+	{
+		uint32_t size;
+		uint32_t flags;
+		uint32_t fourCC;
+		uint32_t rgbBitCount;
+		uint32_t rBitMask;
+		uint32_t gBitMask;
+		uint32_t bBitMask;
+		uint32_t aBitMask;
+	};
+
+	struct Header
+	{
+		uint32_t size;
+		uint32_t flags;
+		uint32_t height;
+		uint32_t width;
+		uint32_t pitchOrLinearSize;
+		uint32_t depth;
+		uint32_t mipMapCount;
+		uint32_t reserved1[11];
+		PixelFormat ddspf;
+		uint32_t caps;
+		uint32_t caps2;
+		uint32_t caps3;
+		uint32_t caps4;
+		uint32_t reserved2;
+	};
+
+	struct HeaderDXT10
+	{
+		uint32_t dxgiFormat;
+		uint32_t resourceDimension;
+		uint32_t miscFlag;
+		uint32_t arraySize;
+		uint32_t miscFlags2;
+	};
+#pragma pack(pop)
+
+	enum class Compression
+	{
+		None,
+		BC1,
+		BC2,
+		BC3,
+		BC4,
+		BC5,
+		BC6H,
+		BC7,
+	};
+
+	struct Subresource
+	{
+		uint64_t offset;		// From the start of the file
+		uint64_t size;
+		uint32_t rowPitch;
+		uint32_t rowCount;		// Rows of blocks for compressed formats
+		uint32_t width;
+		uint32_t height;
+		uint32_t depth;
+		uint32_t mip;
+		uint32_t item;			// Array item or cube face
+	};
+
+	Header header{};
+	HeaderDXT10 dxt10{};
+	bool hasDXT10{};
+
+	uint32_t width{};
+	uint32_t height{};
+	uint32_t depth{};
+	uint32_t mipCount{};
+	uint32_t arraySize{};		// Cube faces included
+	bool isCube{};
+	bool isVolume{};
+
+	Compression compression{};
+	uint32_t bitsPerPixel{};	// Per pixel for uncompressed formats, per texel of a block otherwise
+	uint32_t dataOffset{};		// Size of magic and headers
+	uint64_t dataSize{};		// Bytes covered by subresources
+	std::vector<Subresource> subresources;
+
+	// Only the headers are needed, data may be truncated right after them when fileSize says how
+	// large the whole file is. Returns false for invalid files and unsupported formats.
+	bool Parse(const uint8_t* data, size_t size, uint64_t fileSize = 0)
+	{
+		*this = DDSLayout();
+		fileSize = fileSize ? fileSize : size;
+
+		if (size < sizeof(uint32_t) + sizeof(Header))
+		{
+			return false;
+		}
+
+		uint32_t magic;
+		memcpy(&magic, data, sizeof(magic));
+		memcpy(&header, data + sizeof(uint32_t), sizeof(Header));
+		if (magic != c_magic || header.size != sizeof(Header) || header.ddspf.size != sizeof(PixelFormat))
+		{
+			return false;
+		}
+
+		dataOffset = sizeof(uint32_t) + sizeof(Header);
+		hasDXT10 = (header.ddspf.flags & c_fourCCFlag) && header.ddspf.fourCC == MakeFourCC('D', 'X', '1', '0');
+		if (hasDXT10)
+		{
+			if (size < dataOffset + sizeof(HeaderDXT10))
+			{
+				return false;
+			}
+
+			memcpy(&dxt10, data + dataOffset, sizeof(HeaderDXT10));
+			dataOffset += sizeof(HeaderDXT10);
+		}
+
+		if (fileSize < dataOffset)
+		{
+			return false;
+		}
+
+		width = std::max<uint32_t>(header.width, 1);
+		height = std::max<uint32_t>(header.height, 1);
+		depth = 1;
+		mipCount = std::max<uint32_t>(header.mipMapCount, 1);
+		arraySize = 1;
+
+		if (hasDXT10)
+		{
+			if (!GetDXGIFormatInfo(dxt10.dxgiFormat, compression, bitsPerPixel) || dxt10.arraySize == 0 || dxt10.arraySize > c_maxArraySize)
+			{
+				return false;
+			}
+
+			arraySize = dxt10.arraySize;
+			isVolume = dxt10.resourceDimension == 4;
+			isCube = !isVolume && (dxt10.miscFlag & 0x4);
+			if (isCube)
+			{
+				arraySize *= 6;
+			}
+			if (isVolume)
+			{
+				depth = std::max<uint32_t>(header.depth, 1);
+			}
+		}
+		else
+		{
+			if (!GetLegacyFormatInfo(header.ddspf, compression, bitsPerPixel))
+			{
+				return false;
+			}
+
+			isVolume = (header.flags & c_volumeFlag) != 0;
+			isCube = !isVolume && (header.caps2 & c_cubemapFlag);
+			if (isCube)
+			{
+				// Partial cube maps aren't supported by D3D10+ and rare enough to leave to the loader
+				if ((header.caps2 & c_cubemapAllFaces) != c_cubemapAllFaces)
+				{
+					return false;
+				}
+				arraySize = 6;
+			}
+			if (isVolume)
+			{
+				depth = std::max<uint32_t>(header.depth, 1);
+			}
+		}
+
+		uint32_t maxExtent = isVolume ? c_maxVolumeDimension : c_maxDimension;
+		if (width > maxExtent || height > maxExtent || depth > maxExtent)
+		{
+			return false;
+		}
+
+		uint32_t maxMips = 1;
+		for (uint32_t extent = std::max<uint32_t>({ width, height, depth }); extent > 1; extent >>= 1)
+		{
+			maxMips++;
+		}
+		if (mipCount > maxMips || (isVolume && arraySize > 1))
+		{
+			return false;
+		}
+
+		// Every subresource takes at least a byte, a header claiming more than the file can hold
+		// mustn't make this allocate for them
+		uint64_t offset = dataOffset;
+		subresources.reserve((size_t)std::min<uint64_t>((uint64_t)arraySize * mipCount, fileSize - dataOffset));
+		for (uint32_t item = 0; item < arraySize; item++)
+		{
+			uint32_t w = width, h = height, d = depth;
+			for (uint32_t mip = 0; mip < mipCount; mip++)
+			{
+				Subresource subresource{ offset, 0, 0, 0, w, h, d, mip, item };
+				GetSurfaceInfo(w, h, subresource.rowPitch, subresource.rowCount);
+				subresource.size = (uint64_t)subresource.rowPitch * subresource.rowCount * d;
+				subresources.push_back(subresource);
+
+				offset += subresource.size;
+				if (offset > fileSize)
+				{
+					return false;
+				}
+
+				w = std::max<uint32_t>(w >> 1, 1);
+				h = std::max<uint32_t>(h >> 1, 1);
+				d = std::max<uint32_t>(d >> 1, 1);
+			}
+		}
+
+		dataSize = offset - dataOffset;
+		return true;
+	}
+
+	Subresource const& GetSubresource(uint32_t item, uint32_t mip) const
+	{
+		return subresources[(size_t)item * mipCount + mip];
+	}
+
+	uint32_t GetBlockBytes() const
+	{
+		switch (compression)
+		{
+		case Compression::None: return 0;
+		case Compression::BC1:
+		case Compression::BC4: return 8;
+		default: return 16;
+		}
+	}
+
+	void GetSurfaceInfo(uint32_t w, uint32_t h, uint32_t& rowPitch, uint32_t& rowCount) const
+	{
+		if (uint32_t blockBytes = GetBlockBytes())
+		{
+			rowPitch = std::max<uint32_t>(1, (w + 3) / 4) * blockBytes;
+			rowCount = std::max<uint32_t>(1, (h + 3) / 4);
+		}
+		else
+		{
+			rowPitch = (uint32_t)(((uint64_t)w * bitsPerPixel + 7) / 8);
+			rowCount = h;
+		}
+	}
+
+	static constexpr uint32_t MakeFourCC(char a, char b, char c, char d)
+	{
+		return (uint32_t)(uint8_t)a | ((uint32_t)(uint8_t)b << 8) | ((uint32_t)(uint8_t)c << 16) | ((uint32_t)(uint8_t)d << 24);
+	}
+
+private:
+	static constexpr uint32_t c_volumeFlag = 0x800000;
+	static constexpr uint32_t c_cubemapFlag = 0x200;
+	static constexpr uint32_t c_cubemapAllFaces = 0xFE00;
+
+	static bool GetLegacyFormatInfo(PixelFormat const& format, Compression& compression, uint32_t& bitsPerPixel)
+	{
+		compression = Compression::None;
+		if (!(format.flags & c_fourCCFlag))
+		{
+			// RGB, luminance, alpha and bump formats are described by their bit count
+			bitsPerPixel = format.rgbBitCount;
+			return bitsPerPixel == 8 || bitsPerPixel == 16 || bitsPerPixel == 24 || bitsPerPixel == 32;
+		}
+
+		switch (format.fourCC)
+		{
+		case MakeFourCC('D', 'X', 'T', '1'):
+			compression = Compression::BC1;
+			break;
+		case MakeFourCC('D', 'X', 'T', '2'):
+		case MakeFourCC('D', 'X', 'T', '3'):
+			compression = Compression::BC2;
+			break;
+		case MakeFourCC('D', 'X', 'T', '4'):
+		case MakeFourCC('D', 'X', 'T', '5'):
+			compression = Compression::BC3;
+			break;
+		case MakeFourCC('A', 'T', 'I', '1'):
+		case MakeFourCC('B', 'C', '4', 'U'):
+		case MakeFourCC('B', 'C', '4', 'S'):
+			compression = Compression::BC4;
+			break;
+		case MakeFourCC('A', 'T', 'I', '2'):
+		case MakeFourCC('B', 'C', '5', 'U'):
+		case MakeFourCC('B', 'C', '5', 'S'):
+			compression = Compression::BC5;
+			break;
+
+		// D3DFORMAT values stored as the FourCC
+		case 111:	// D3DFMT_R16F
+			bitsPerPixel = 16;
+			return true;
+		case 112:	// D3DFMT_G16R16F
+		case 114:	// D3DFMT_R32F
+			bitsPerPixel = 32;
+			return true;
+		case 36:	// D3DFMT_A16B16G16R16
+		case 110:	// D3DFMT_Q16W16V16U16
+		case 113:	// D3DFMT_A16B16G16R16F
+		case 115:	// D3DFMT_G32R32F
+			bitsPerPixel = 64;
+			return true;
+		case 116:	// D3DFMT_A32B32G32R32F
+			bitsPerPixel = 128;
+			return true;
+
+		default:
+			return false;
+		}
+
+		bitsPerPixel = compression == Compression::BC1 || compression == Compression::BC4 ? 4 : 8;
+		return true;
+	}
+
+	static bool GetDXGIFormatInfo(uint32_t format, Compression& compression, uint32_t& bitsPerPixel)
+	{
+		compression = Compression::None;
+		if (format >= 1 && format <= 4) bitsPerPixel = 128;			// R32G32B32A32
+		else if (format >= 5 && format <= 8) bitsPerPixel = 96;		// R32G32B32
+		else if (format >= 9 && format <= 22) bitsPerPixel = 64;	// R16G16B16A16, R32G32, R32G8X24
+		else if ((format >= 23 && format <= 47) || format == 67 || (format >= 87 && format <= 93)) bitsPerPixel = 32;
+		else if ((format >= 48 && format <= 59) || format == 85 || format == 86 || format == 115) bitsPerPixel = 16;
+		else if (format >= 60 && format <= 65) bitsPerPixel = 8;	// R8, A8
+		else if (format >= 70 && format <= 72) compression = Compression::BC1;
+		else if (format >= 73 && format <= 75) compression = Compression::BC2;
+		else if (format >= 76 && format <= 78) compression = Compression::BC3;
+		else if (format >= 79 && format <= 81) compression = Compression::BC4;
+		else if (format >= 82 && format <= 84) compression = Compression::BC5;
+		else if (format >= 94 && format <= 96) compression = Compression::BC6H;
+		else if (format >= 97 && format <= 99) compression = Compression::BC7;
+		else return false;
+
+		if (compression != Compression::None)
+		{
+			bitsPerPixel = compression == Compression::BC1 || compression == Compression::BC4 ? 4 : 8;
+		}
+		return true;
+	}
+};
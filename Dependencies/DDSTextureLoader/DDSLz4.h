@@ -0,0 +1,142 @@
+#pragma once
+
+// .dds.lz4 container: a whole DDS file as one lz4 frame with its content size in the frame header.
+// Decompression writes straight into the caller's buffer of exactly that size, which then serves
+// as the DDS data itself, so loading one costs no copy beyond the decompressed texture.
+// Independent 4 MB blocks keep the decoder from needing a history buffer of its own.
+//
+// Requires Dependencies\lz4\include in the include path and liblz4_static.lib linked.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <lz4frame.h>
+#include <lz4hc.h>
+
+namespace DDSLz4
+{
+
+constexpr uint32_t c_frameMagic = 0x184D2204;
+
+inline bool IsFrame(const uint8_t* data, size_t size)
+{
+	uint32_t magic = 0;
+	if (size < sizeof(magic))
+	{
+		return false;
+	}
+
+	memcpy(&magic, data, sizeof(magic));
+	return magic == c_frameMagic;
+}
+
+// Decompressed size, 0 if the frame is invalid or was written without it
+inline size_t GetContentSize(const uint8_t* data, size_t size)
+{
+	LZ4F_dctx* context = nullptr;
+	if (LZ4F_isError(LZ4F_createDecompressionContext(&context, LZ4F_VERSION)))
+	{
+		return 0;
+	}
+
+	LZ4F_frameInfo_t frameInfo{};
+	size_t consumed = size;
+	size_t result = LZ4F_getFrameInfo(context, &frameInfo, data, &consumed);
+	LZ4F_freeDecompressionContext(context);
+
+	if (LZ4F_isError(result) || frameInfo.contentSize > SIZE_MAX)
+	{
+		return 0;
+	}
+	return (size_t)frameInfo.contentSize;
+}
+
+// output must hold exactly GetContentSize bytes
+inline bool Decompress(const uint8_t* data, size_t size, uint8_t* output, size_t outputSize)
+{
+	LZ4F_dctx* context = nullptr;
+	if (LZ4F_isError(LZ4F_createDecompressionContext(&context, LZ4F_VERSION)))
+	{
+		return false;
+	}
+
+	// The output never moves, blocks decode in place without going through the context's buffer
+	LZ4F_decompressOptions_t options{};
+	options.stableDst = 1;
+
+	size_t position = 0;
+	size_t written = 0;
+	size_t hint = 1;
+	while (hint != 0 && !LZ4F_isError(hint))
+	{
+		size_t sourceSize = size - position;
+		size_t destinationSize = outputSize - written;
+		hint = LZ4F_decompress(context, output + written, &destinationSize, data + position, &sourceSize, &options);
+		position += sourceSize;
+		written += destinationSize;
+
+		if (!sourceSize && !destinationSize)
+		{
+			break;
+		}
+	}
+
+	LZ4F_freeDecompressionContext(context);
+	return hint == 0 && written == outputSize;
+}
+
+// Decompresses only the first outputSize bytes, enough for the headers. Stops after the block
+// holding them, so the rest of the frame is never touched. Returns the bytes written.
+inline size_t DecompressPrefix(const uint8_t* data, size_t size, uint8_t* output, size_t outputSize)
+{
+	LZ4F_dctx* context = nullptr;
+	if (LZ4F_isError(LZ4F_createDecompressionContext(&context, LZ4F_VERSION)))
+	{
+		return 0;
+	}
+
+	size_t position = 0;
+	size_t written = 0;
+	size_t hint = 1;
+	while (written < outputSize && hint != 0 && !LZ4F_isError(hint))
+	{
+		size_t sourceSize = size - position;
+		size_t destinationSize = outputSize - written;
+		hint = LZ4F_decompress(context, output + written, &destinationSize, data + position, &sourceSize, nullptr);
+		position += sourceSize;
+		written += destinationSize;
+
+		if (!sourceSize && !destinationSize)
+		{
+			break;
+		}
+	}
+
+	LZ4F_freeDecompressionContext(context);
+	return LZ4F_isError(hint) ? 0 : written;
+}
+
+// level is an lz4hc level, 0 for the fast compressor
+inline bool Compress(const uint8_t* data, size_t size, std::vector<uint8_t>& output, int level = LZ4HC_CLEVEL_DEFAULT)
+{
+	LZ4F_preferences_t preferences{};
+	preferences.frameInfo.blockSizeID = LZ4F_max4MB;
+	preferences.frameInfo.blockMode = LZ4F_blockIndependent;
+	preferences.frameInfo.contentSize = size;
+	preferences.frameInfo.contentChecksumFlag = LZ4F_contentChecksumEnabled;
+	preferences.compressionLevel = level;
+
+	output.resize(LZ4F_compressFrameBound(size, &preferences));
+	size_t compressed = LZ4F_compressFrame(output.data(), output.size(), data, size, &preferences);
+	if (LZ4F_isError(compressed))
+	{
+		return false;
+	}
+
+	output.resize(compressed);
+	return true;
+}
+
+} // namespace DDSLz4
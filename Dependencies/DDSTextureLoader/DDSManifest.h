@@ -0,0 +1,439 @@
+#pragma once
+
+// Dimensions, format and resource size of every DDS texture under a set of directories, learned from
+// their headers alone so memory can be planned before any pixel data is read. Sizes come from the
+// same layout rules the loaders use, summed over every subresource. Results are cached on disk and
+// only files whose size or write time changed are read again.
+//
+//   DDSManifest manifest;
+//   manifest.Load(L"cache\\textures.manifest");
+//   manifest.Scan({ L"mods\\Foo\\disk", L"mods\\Bar\\disk" });
+//   manifest.Save(L"cache\\textures.manifest");
+//   uint64_t bytes = manifest.GetTotalSize();	// GetInvalidCount() files aren't part of it
+//
+// Paths are kept and cached in their native form, so names outside the ANSI code page survive.
+// Requires Dependencies\oneTBB\include and Dependencies\xxHash in the include path. Defining
+// DDS_LOADER_LZ4 also lists .dds.lz4 containers with their decompressed layout, only their first
+// block is decoded, which needs Dependencies\lz4\include in the include path.
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <cwctype>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <oneapi/tbb/enumerable_thread_specific.h>
+#include <oneapi/tbb/parallel_for.h>
+#include <oneapi/tbb/parallel_for_each.h>
+
+#define XXH_INLINE_ALL
+#include <xxhash.h>
+
+#include "../MappedFile.h"
+#include "DDSLayout.h"
+#ifdef DDS_LOADER_LZ4
+#include "DDSLz4.h"
+#endif
+
+class DDSManifest
+{
+public:
+	enum Flags : uint32_t
+	{
+		Flags_Valid = 1,		// Parsed, the layout fields are meaningful
+		Flags_Cube = 2,
+		Flags_Volume = 4,
+		Flags_Packed = 8,		// .dds.lz4 container
+	};
+
+	struct Entry
+	{
+		std::filesystem::path path;
+		uint64_t fileSize{};
+		int64_t time{};
+		uint32_t flags{};
+		uint32_t width{};
+		uint32_t height{};
+		uint32_t depth{};
+		uint32_t mipCount{};
+		uint32_t arraySize{};				// Cube faces included
+		uint32_t format{};					// DXGI format with a DX10 header, else the FourCC, else 0
+		DDSLayout::Compression compression{};
+		uint32_t bitsPerPixel{};
+		uint64_t resourceSize{};			// Bytes of every subresource
+	};
+
+	// Previous results, returns false if the cache is missing or corrupted
+	bool Load(std::filesystem::path const& cache)
+	{
+		m_entries.clear();
+		m_index.clear();
+
+		MappedFile file(cache);
+		if (!file || file.GetSize() < sizeof(Header))
+		{
+			return false;
+		}
+
+		Header header;
+		memcpy(&header, file.GetData(), sizeof(Header));
+		if (header.magic != c_magic || header.version != c_version || header.payloadSize != file.GetSize() - sizeof(Header) ||
+			XXH3_64bits(file.GetData() + sizeof(Header), (size_t)header.payloadSize) != header.payloadHash)
+		{
+			return false;
+		}
+
+		Reader reader{ file.GetData() + sizeof(Header), file.GetData() + file.GetSize() };
+		std::vector<Entry> entries(reader.Read<uint32_t>());
+		for (Entry& entry : entries)
+		{
+			entry.path = reader.ReadPath();
+			entry.fileSize = reader.Read<uint64_t>();
+			entry.time = reader.Read<int64_t>();
+			entry.flags = reader.Read<uint32_t>();
+			entry.width = reader.Read<uint32_t>();
+			entry.height = reader.Read<uint32_t>();
+			entry.depth = reader.Read<uint32_t>();
+			entry.mipCount = reader.Read<uint32_t>();
+			entry.arraySize = reader.Read<uint32_t>();
+			entry.format = reader.Read<uint32_t>();
+			entry.compression = (DDSLayout::Compression)reader.Read<uint32_t>();
+			entry.bitsPerPixel = reader.Read<uint32_t>();
+			entry.resourceSize = reader.Read<uint64_t>();
+			if (!reader.valid)
+			{
+				break;
+			}
+		}
+
+		if (!reader.valid || reader.current != reader.end)
+		{
+			return false;
+		}
+
+		m_entries = std::move(entries);
+		Reindex();
+		return true;
+	}
+
+	// Written next to the target and renamed over it, so a concurrent reader never maps a partial file
+	bool Save(std::filesystem::path const& cache) const
+	{
+		std::string payload;
+		Write(payload, (uint32_t)m_entries.size());
+		for (Entry const& entry : m_entries)
+		{
+			WritePath(payload, entry.path);
+			Write(payload, entry.fileSize);
+			Write(payload, entry.time);
+			Write(payload, entry.flags);
+			Write(payload, entry.width);
+			Write(payload, entry.height);
+			Write(payload, entry.depth);
+			Write(payload, entry.mipCount);
+			Write(payload, entry.arraySize);
+			Write(payload, entry.format);
+			Write(payload, (uint32_t)entry.compression);
+			Write(payload, entry.bitsPerPixel);
+			Write(payload, entry.resourceSize);
+		}
+
+		Header header{ c_magic, c_version, payload.size(), XXH3_64bits(payload.data(), payload.size()) };
+
+		std::filesystem::path temporary = cache;
+		temporary += "." + std::to_string(XXH3_64bits_withSeed(&header, sizeof(header),
+			std::hash<std::thread::id>()(std::this_thread::get_id()) ^ (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count())) + ".tmp";
+
+		{
+			std::ofstream stream(temporary, std::ios::binary | std::ios::trunc);
+			stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			stream.write(payload.data(), (std::streamsize)payload.size());
+			if (!stream)
+			{
+				stream.close();
+				std::error_code ec;
+				std::filesystem::remove(temporary, ec);
+				return false;
+			}
+		}
+
+		std::error_code ec;
+		std::filesystem::rename(temporary, cache, ec);
+		if (ec)
+		{
+			std::filesystem::remove(temporary, ec);
+			return false;
+		}
+
+		return true;
+	}
+
+	// Walks the directories in parallel and replaces the entries with every .dds and .dds.lz4 found.
+	// Entries loaded from the cache are kept for files with the same size and write time.
+	// Returns the number of files whose headers had to be read.
+	size_t Scan(std::vector<std::filesystem::path> const& directories)
+	{
+		tbb::enumerable_thread_specific<std::vector<Entry>> locals;
+		tbb::parallel_for_each(directories.begin(), directories.end(), [&locals](std::filesystem::path const& directory, tbb::feeder<std::filesystem::path>& feeder)
+		{
+			std::vector<Entry>& local = locals.local();
+
+			std::error_code ec;
+			for (std::filesystem::directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec))
+			{
+				std::filesystem::directory_entry const& item = *it;
+				if (item.is_directory(ec))
+				{
+					feeder.add(item.path());
+					continue;
+				}
+
+#ifdef DDS_LOADER_LZ4
+				bool packed = HasExtension(item.path(), ".dds.lz4");
+#else
+				bool packed = false;
+#endif
+				if (!packed && !HasExtension(item.path(), ".dds"))
+				{
+					continue;
+				}
+
+				Entry entry;
+				entry.path = item.path().lexically_normal();
+				entry.fileSize = item.file_size(ec);
+				entry.time = (int64_t)item.last_write_time(ec).time_since_epoch().count();
+				entry.flags = packed ? (uint32_t)Flags_Packed : 0;
+				if (!ec)
+				{
+					local.push_back(std::move(entry));
+				}
+			}
+		});
+
+		std::vector<Entry> entries;
+		for (std::vector<Entry>& local : locals)
+		{
+			std::move(local.begin(), local.end(), std::back_inserter(entries));
+		}
+
+		// Reuse what the cache already knows, the rest gets its headers read
+		std::vector<size_t> changed;
+		for (size_t i = 0; i < entries.size(); i++)
+		{
+			Entry const* known = Find(entries[i].path);
+			if (known && known->fileSize == entries[i].fileSize && known->time == entries[i].time)
+			{
+				entries[i] = *known;
+			}
+			else
+			{
+				changed.push_back(i);
+			}
+		}
+
+		tbb::parallel_for(size_t(0), changed.size(), [&](size_t i)
+		{
+			ReadHeaders(entries[changed[i]]);
+		});
+
+		std::sort(entries.begin(), entries.end(), [](Entry const& a, Entry const& b) { return a.path < b.path; });
+		m_entries = std::move(entries);
+		Reindex();
+		return changed.size();
+	}
+
+	Entry const* Find(std::filesystem::path const& path) const
+	{
+		auto it = m_index.find(GetKey(path.lexically_normal()));
+		return it != m_index.end() ? &m_entries[it->second] : nullptr;
+	}
+
+	std::vector<Entry> const& GetEntries() const
+	{
+		return m_entries;
+	}
+
+	// Resource bytes of every valid entry, see GetInvalidCount for the files left out
+	uint64_t GetTotalSize() const
+	{
+		uint64_t total = 0;
+		for (Entry const& entry : m_entries)
+		{
+			total += entry.resourceSize;
+		}
+		return total;
+	}
+
+	// Entries whose headers couldn't be read or parsed, they have no size or layout
+	size_t GetInvalidCount() const
+	{
+		return (size_t)std::count_if(m_entries.begin(), m_entries.end(), [](Entry const& entry) { return !(entry.flags & Flags_Valid); });
+	}
+
+private:
+	static constexpr uint32_t c_magic = 0x4D534444; // "DDSM"
+	static constexpr uint32_t c_version = 2;
+
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t payloadSize;
+		uint64_t payloadHash;
+	};
+
+	struct Reader
+	{
+		const uint8_t* current;
+		const uint8_t* end;
+		bool valid{ true };
+
+		template<typename T>
+		T Read()
+		{
+			T value{};
+			if (!valid || (size_t)(end - current) < sizeof(T))
+			{
+				valid = false;
+				return value;
+			}
+
+			memcpy(&value, current, sizeof(T));
+			current += sizeof(T);
+			return value;
+		}
+
+		std::filesystem::path ReadPath()
+		{
+			uint32_t length = Read<uint32_t>();
+			size_t bytes = (size_t)length * sizeof(std::filesystem::path::value_type);
+			if (!valid || (size_t)(end - current) < bytes)
+			{
+				valid = false;
+				return {};
+			}
+
+			std::filesystem::path::string_type value(length, 0);
+			memcpy(value.data(), current, bytes);
+			current += bytes;
+			return value;
+		}
+	};
+
+	std::vector<Entry> m_entries;
+	std::unordered_map<uint64_t, size_t> m_index;	// Hash of the lowercased native path
+
+	template<typename T>
+	static void Write(std::string& payload, T value)
+	{
+		payload.append(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	// Native code units, UTF-16 on Windows
+	static void WritePath(std::string& payload, std::filesystem::path const& path)
+	{
+		std::filesystem::path::string_type const& value = path.native();
+		Write(payload, (uint32_t)value.size());
+		payload.append(reinterpret_cast<const char*>(value.data()), value.size() * sizeof(std::filesystem::path::value_type));
+	}
+
+	static char ToLower(char c)
+	{
+		return (char)std::tolower((unsigned char)c);
+	}
+
+	static wchar_t ToLower(wchar_t c)
+	{
+		return (wchar_t)std::towlower(c);
+	}
+
+	static uint64_t GetKey(std::filesystem::path const& path)
+	{
+		std::filesystem::path::string_type key = path.native();
+		for (std::filesystem::path::value_type& c : key)
+		{
+			c = ToLower(c);
+		}
+		return XXH3_64bits(key.data(), key.size() * sizeof(std::filesystem::path::value_type));
+	}
+
+	static bool HasExtension(std::filesystem::path const& path, std::string_view extension)
+	{
+		std::filesystem::path::string_type const& name = path.native();
+		if (name.size() < extension.size())
+		{
+			return false;
+		}
+
+		for (size_t i = 0; i < extension.size(); i++)
+		{
+			if (ToLower(name[name.size() - extension.size() + i]) != (std::filesystem::path::value_type)extension[i])
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void Reindex()
+	{
+		m_index.clear();
+		m_index.reserve(m_entries.size());
+		for (size_t i = 0; i < m_entries.size(); i++)
+		{
+			m_index.emplace(GetKey(m_entries[i].path), i);
+		}
+	}
+
+	// Fills in the layout fields from the magic and headers, leaves the entry invalid on failure
+	static void ReadHeaders(Entry& entry)
+	{
+		uint8_t headers[sizeof(uint32_t) + sizeof(DDSLayout::Header) + sizeof(DDSLayout::HeaderDXT10)];
+		size_t size = 0;
+		uint64_t fileSize = entry.fileSize;
+
+#ifdef DDS_LOADER_LZ4
+		if (entry.flags & Flags_Packed)
+		{
+			// Mapped, so only the pages of the first block are read
+			MappedFile file(entry.path);
+			fileSize = file ? DDSLz4::GetContentSize(file.GetData(), file.GetSize()) : 0;
+			size = fileSize ? DDSLz4::DecompressPrefix(file.GetData(), file.GetSize(), headers, sizeof(headers)) : 0;
+		}
+		else
+#endif
+		{
+			std::ifstream stream(entry.path, std::ios::binary);
+			stream.read(reinterpret_cast<char*>(headers), sizeof(headers));
+			size = (size_t)stream.gcount();
+		}
+
+		DDSLayout layout;
+		if (!size || !layout.Parse(headers, size, fileSize))
+		{
+			return;
+		}
+
+		entry.flags |= Flags_Valid | (layout.isCube ? (uint32_t)Flags_Cube : 0) | (layout.isVolume ? (uint32_t)Flags_Volume : 0);
+		entry.width = layout.width;
+		entry.height = layout.height;
+		entry.depth = layout.depth;
+		entry.mipCount = layout.mipCount;
+		entry.arraySize = layout.arraySize;
+		entry.format = layout.hasDXT10 ? layout.dxt10.dxgiFormat : (layout.header.ddspf.flags & DDSLayout::c_fourCCFlag) ? layout.header.ddspf.fourCC : 0;
+		entry.compression = layout.compression;
+		entry.bitsPerPixel = layout.bitsPerPixel;
+		entry.resourceSize = layout.dataSize;
+	}
+};
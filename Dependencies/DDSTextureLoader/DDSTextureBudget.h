@@ -0,0 +1,301 @@
+#pragma once
+
+// Keeps the texture memory of DDS files under a byte budget, which in the 32-bit D3D9 build is what
+// stands between mods and running out of address space. Each texture is accounted with the size
+// of its subresources as laid out by DDSLayout and remembers the last frame it was used in.
+// When the budget is exceeded, EndFrame releases the least recently used textures that weren't
+// used this frame and that nothing else references, a device binding included. An evicted
+// texture is loaded again the next time it's used.
+//
+//   DDSTextureBudget<IDirect3DBaseTexture9> budget([&](const uint8_t* data, size_t size)
+//   {
+//       IDirect3DBaseTexture9* texture = nullptr;
+//       DirectX::CreateDDSTextureFromMemoryEx(device, data, size, 0, D3DPOOL_MANAGED, false, &texture);
+//       return texture;
+//   }, 512 * 1024 * 1024);
+//
+//   auto texture = budget.Load(L"mods\\Foo\\bar.dds");
+//   device->SetTexture(0, texture->Get());	// Every frame it's drawn with
+//   budget.EndFrame();
+//
+// Handles must not outlive the budget. Get and EndFrame belong on the render thread, counters can
+// be read from anywhere. Defining DDS_LOADER_LZ4 adds .dds.lz4 containers, which needs
+// Dependencies\lz4\include in the include path and liblz4_static.lib linked.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+
+#include "../MappedFile.h"
+#include "DDSLayout.h"
+#ifdef DDS_LOADER_LZ4
+#include "DDSLz4.h"
+#endif
+
+template<typename TTexture>
+class DDSTextureBudget
+{
+public:
+	// Returns nullptr if the resource couldn't be created
+	using CreateCallback = std::function<TTexture*(const uint8_t* data, size_t size)>;
+
+	struct Counters
+	{
+		uint64_t budgetBytes;
+		uint64_t residentBytes;
+		uint64_t peakBytes;
+		size_t textureCount;		// Handles alive
+		size_t residentCount;
+		uint64_t loadCount;			// Reloads after an eviction included
+		uint64_t reloadCount;
+		uint64_t evictionCount;
+		uint64_t frame;
+	};
+
+	class Handle
+	{
+	public:
+		~Handle()
+		{
+			m_owner.Remove(*this);
+		}
+
+		Handle(Handle const&) = delete;
+		Handle& operator=(Handle const&) = delete;
+
+		// Marks the texture used this frame and loads it again if it was evicted, nullptr if that fails.
+		// Not AddRef'd, the texture stays valid at least until the next EndFrame.
+		TTexture* Get()
+		{
+			return m_owner.Use(*this);
+		}
+
+		std::filesystem::path const& GetPath() const
+		{
+			return m_path;
+		}
+
+	private:
+		friend class DDSTextureBudget;
+
+		Handle(DDSTextureBudget& owner, std::filesystem::path path) : m_owner(owner), m_path(std::move(path))
+		{
+		}
+
+		DDSTextureBudget& m_owner;
+		std::filesystem::path m_path;
+		TTexture* m_texture{};
+		uint64_t m_size{};
+		uint64_t m_lastFrame{};
+		bool m_loaded{};			// Loaded at least once, later loads are reloads
+		typename std::list<Handle*>::iterator m_position;	// In the LRU list while resident
+	};
+
+	using HandlePtr = std::shared_ptr<Handle>;
+
+	DDSTextureBudget(CreateCallback create, uint64_t budgetBytes) : m_create(std::move(create)), m_budgetBytes(budgetBytes)
+	{
+	}
+
+	~DDSTextureBudget()
+	{
+		std::lock_guard lock(m_mutex);
+		for (Handle* handle : m_lru)
+		{
+			handle->m_texture->Release();
+			handle->m_texture = nullptr;
+		}
+		m_lru.clear();
+	}
+
+	DDSTextureBudget(DDSTextureBudget const&) = delete;
+	DDSTextureBudget& operator=(DDSTextureBudget const&) = delete;
+
+	// Loads right away, evicting older textures if this one doesn't fit. nullptr if it can't be loaded.
+	HandlePtr Load(std::filesystem::path path)
+	{
+		HandlePtr handle(new Handle(*this, std::move(path)));
+		m_textureCount.fetch_add(1, std::memory_order_relaxed);
+		return handle->Get() ? handle : nullptr;
+	}
+
+	// Evicts down to the budget and starts the next frame. Returns the number of textures released.
+	size_t EndFrame()
+	{
+		std::lock_guard lock(m_mutex);
+		size_t evicted = Evict(0);
+		m_frame.fetch_add(1, std::memory_order_relaxed);
+		return evicted;
+	}
+
+	void SetBudget(uint64_t budgetBytes)
+	{
+		m_budgetBytes = budgetBytes;
+	}
+
+	Counters GetCounters() const
+	{
+		return
+		{
+			m_budgetBytes.load(std::memory_order_relaxed),
+			m_residentBytes.load(std::memory_order_relaxed),
+			m_peakBytes.load(std::memory_order_relaxed),
+			m_textureCount.load(std::memory_order_relaxed),
+			m_residentCount.load(std::memory_order_relaxed),
+			m_loadCount.load(std::memory_order_relaxed),
+			m_reloadCount.load(std::memory_order_relaxed),
+			m_evictionCount.load(std::memory_order_relaxed),
+			m_frame.load(std::memory_order_relaxed),
+		};
+	}
+
+private:
+	CreateCallback m_create;
+	std::mutex m_mutex;
+	std::list<Handle*> m_lru;		// Resident textures, most recently used first
+
+	std::atomic<uint64_t> m_budgetBytes{};
+	std::atomic<uint64_t> m_residentBytes{};
+	std::atomic<uint64_t> m_peakBytes{};
+	std::atomic<size_t> m_textureCount{};
+	std::atomic<size_t> m_residentCount{};
+	std::atomic<uint64_t> m_loadCount{};
+	std::atomic<uint64_t> m_reloadCount{};
+	std::atomic<uint64_t> m_evictionCount{};
+	std::atomic<uint64_t> m_frame{ 1 };
+
+	TTexture* Use(Handle& handle)
+	{
+		std::lock_guard lock(m_mutex);
+		handle.m_lastFrame = m_frame.load(std::memory_order_relaxed);
+
+		if (handle.m_texture)
+		{
+			m_lru.splice(m_lru.begin(), m_lru, handle.m_position);
+			return handle.m_texture;
+		}
+
+		uint64_t size = 0;
+		TTexture* texture = Create(handle.m_path, size);
+		if (!texture)
+		{
+			return nullptr;
+		}
+
+		// Make room before the new texture counts, it isn't evictable this frame anyway
+		Evict(size);
+
+		handle.m_texture = texture;
+		handle.m_size = size;
+		m_lru.push_front(&handle);
+		handle.m_position = m_lru.begin();
+
+		uint64_t resident = m_residentBytes.fetch_add(size, std::memory_order_relaxed) + size;
+		if (resident > m_peakBytes.load(std::memory_order_relaxed))
+		{
+			m_peakBytes.store(resident, std::memory_order_relaxed);
+		}
+		m_residentCount.fetch_add(1, std::memory_order_relaxed);
+		m_loadCount.fetch_add(1, std::memory_order_relaxed);
+		if (handle.m_loaded)
+		{
+			m_reloadCount.fetch_add(1, std::memory_order_relaxed);
+		}
+		handle.m_loaded = true;
+
+		return texture;
+	}
+
+	void Remove(Handle& handle)
+	{
+		std::lock_guard lock(m_mutex);
+		if (handle.m_texture)
+		{
+			Release(handle);
+		}
+		m_textureCount.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	void Release(Handle& handle)
+	{
+		handle.m_texture->Release();
+		handle.m_texture = nullptr;
+		m_lru.erase(handle.m_position);
+		m_residentBytes.fetch_sub(handle.m_size, std::memory_order_relaxed);
+		m_residentCount.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	// Releases from the least recently used end until incoming more bytes would fit the budget
+	size_t Evict(uint64_t incoming)
+	{
+		uint64_t budget = m_budgetBytes.load(std::memory_order_relaxed);
+		uint64_t frame = m_frame.load(std::memory_order_relaxed);
+
+		size_t evicted = 0;
+		for (auto it = m_lru.end(); it != m_lru.begin() && m_residentBytes.load(std::memory_order_relaxed) + incoming > budget;)
+		{
+			Handle& handle = **--it;
+
+			// Everything further up was used this frame too
+			if (handle.m_lastFrame == frame)
+			{
+				break;
+			}
+
+			// Still referenced elsewhere, bound to the device for instance, releasing ours frees nothing
+			handle.m_texture->AddRef();
+			if (handle.m_texture->Release() > 1)
+			{
+				continue;
+			}
+
+			auto next = std::next(it);
+			Release(handle);
+			it = next;
+			evicted++;
+		}
+
+		m_evictionCount.fetch_add(evicted, std::memory_order_relaxed);
+		return evicted;
+	}
+
+	TTexture* Create(std::filesystem::path const& path, uint64_t& size)
+	{
+		MappedFile file;
+		if (!file.Open(path))
+		{
+			return nullptr;
+		}
+
+		const uint8_t* data = file.GetData();
+		size_t dataSize = file.GetSize();
+
+#ifdef DDS_LOADER_LZ4
+		std::unique_ptr<uint8_t[]> unpacked;
+		if (DDSLz4::IsFrame(data, dataSize))
+		{
+			size_t unpackedSize = DDSLz4::GetContentSize(data, dataSize);
+			unpacked.reset(unpackedSize ? new (std::nothrow) uint8_t[unpackedSize] : nullptr);
+			if (!unpacked || !DDSLz4::Decompress(data, dataSize, unpacked.get(), unpackedSize))
+			{
+				return nullptr;
+			}
+
+			file.Close();
+			data = unpacked.get();
+			dataSize = unpackedSize;
+		}
+#endif
+
+		DDSLayout layout;
+		size = layout.Parse(data, dataSize) ? layout.dataSize : dataSize;
+		return m_create(data, dataSize);
+	}
+};
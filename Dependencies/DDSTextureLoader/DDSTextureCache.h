@@ -0,0 +1,243 @@
+#pragma once
+
+// Shares one texture between byte-identical DDS files, as mods shipping the same UI or replacement
+// packs tend to have. Resources are keyed by the XXH3 hash of the file contents. Each path remembers
+// the size, write time and hash it was last seen with, so loading an unchanged path again costs a
+// stat and no read. A different path with the same contents is hashed once and then gets the
+// existing texture.
+//
+//   DDSTextureCache<IDirect3DBaseTexture9> cache([&](const uint8_t* data, size_t size)
+//   {
+//       IDirect3DBaseTexture9* texture = nullptr;
+//       DirectX::CreateDDSTextureFromMemoryEx(device, data, size, 0, D3DPOOL_MANAGED, false, &texture);
+//       return texture;
+//   });
+//
+//   IDirect3DBaseTexture9* texture = cache.Load(L"mods\\Foo\\bar.dds");	// AddRef'd, Release when done
+//
+// The cache holds a reference of its own to every texture, Trim releases the ones nobody else holds
+// anymore. Create one cache per set of creation parameters, the callback decides them.
+// Thread safe, but the callback runs under the cache's lock.
+//
+// Requires Dependencies\xxHash in the include path. Defining DDS_LOADER_LZ4 adds .dds.lz4 containers,
+// hashed as stored and decompressed only when a texture is created, which needs
+// Dependencies\lz4\include in the include path and liblz4_static.lib linked.
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+
+#define XXH_INLINE_ALL
+#include <xxhash.h>
+
+#include "../MappedFile.h"
+#ifdef DDS_LOADER_LZ4
+#include "DDSLz4.h"
+#endif
+
+template<typename TTexture>
+class DDSTextureCache
+{
+public:
+	// Returns nullptr if the resource couldn't be created
+	using CreateCallback = std::function<TTexture*(const uint8_t* data, size_t size)>;
+
+	explicit DDSTextureCache(CreateCallback create) : m_create(std::move(create))
+	{
+	}
+
+	~DDSTextureCache()
+	{
+		Clear();
+	}
+
+	DDSTextureCache(DDSTextureCache const&) = delete;
+	DDSTextureCache& operator=(DDSTextureCache const&) = delete;
+
+	// Returns an AddRef'd texture, nullptr if the file is missing or invalid
+	TTexture* Load(std::filesystem::path const& path)
+	{
+		std::error_code ec;
+		uint64_t size = std::filesystem::file_size(path, ec);
+		std::filesystem::file_time_type lastWriteTime = std::filesystem::last_write_time(path, ec);
+		if (ec)
+		{
+			return nullptr;
+		}
+
+		std::lock_guard lock(m_mutex);
+
+		// Unchanged path whose contents are still loaded, no need to read it
+		std::wstring key = GetKey(path);
+		auto known = m_paths.find(key);
+		if (known != m_paths.end() && known->second.size == size && known->second.lastWriteTime == lastWriteTime)
+		{
+			if (TTexture* texture = Find(known->second.hash, size))
+			{
+				m_hitCount++;
+				return texture;
+			}
+		}
+
+		MappedFile file;
+		if (!file.Open(path) || file.GetSize() != size)
+		{
+			return nullptr;
+		}
+
+		uint64_t hash = XXH3_64bits(file.GetData(), file.GetSize());
+		m_paths[key] = { size, lastWriteTime, hash };
+
+		if (TTexture* texture = Find(hash, size))
+		{
+			m_hitCount++;
+			return texture;
+		}
+
+		m_missCount++;
+		TTexture* texture = Create(file);
+		if (!texture)
+		{
+			return nullptr;
+		}
+
+		// A 64-bit hash shared by two different sizes isn't worth evicting the first one for
+		auto inserted = m_textures.try_emplace(hash, Entry{ texture, size });
+		if (inserted.second)
+		{
+			texture->AddRef();
+		}
+		return texture;
+	}
+
+	// Releases textures only the cache still references. Returns how many were released.
+	size_t Trim()
+	{
+		std::lock_guard lock(m_mutex);
+
+		size_t released = 0;
+		for (auto it = m_textures.begin(); it != m_textures.end();)
+		{
+			TTexture* texture = it->second.texture;
+			texture->AddRef();
+			if (texture->Release() == 1)
+			{
+				texture->Release();
+				it = m_textures.erase(it);
+				released++;
+			}
+			else
+			{
+				++it;
+			}
+		}
+		return released;
+	}
+
+	// Drops every reference the cache holds, textures still in use elsewhere stay alive
+	void Clear()
+	{
+		std::lock_guard lock(m_mutex);
+
+		for (auto& entry : m_textures)
+		{
+			entry.second.texture->Release();
+		}
+		m_textures.clear();
+		m_paths.clear();
+	}
+
+	// Distinct textures held
+	size_t GetCount() const
+	{
+		std::lock_guard lock(m_mutex);
+		return m_textures.size();
+	}
+
+	// Loads served by a texture that was already created, from the same path or another one
+	size_t GetHitCount() const
+	{
+		std::lock_guard lock(m_mutex);
+		return m_hitCount;
+	}
+
+	size_t GetMissCount() const
+	{
+		std::lock_guard lock(m_mutex);
+		return m_missCount;
+	}
+
+private:
+	struct Entry
+	{
+		TTexture* texture;
+		uint64_t size;		// File size, checked on top of the hash
+	};
+
+	struct PathEntry
+	{
+		uint64_t size;
+		std::filesystem::file_time_type lastWriteTime;
+		uint64_t hash;
+	};
+
+	CreateCallback m_create;
+	mutable std::mutex m_mutex;
+	std::unordered_map<uint64_t, Entry> m_textures;
+	std::unordered_map<std::wstring, PathEntry> m_paths;
+	size_t m_hitCount{};
+	size_t m_missCount{};
+
+	// Game paths are case-insensitive, mods spell them any way they like
+	static std::wstring GetKey(std::filesystem::path const& path)
+	{
+		std::wstring key = path.lexically_normal().wstring();
+		for (wchar_t& c : key)
+		{
+			if (c >= L'A' && c <= L'Z')
+			{
+				c += L'a' - L'A';
+			}
+		}
+		return key;
+	}
+
+	TTexture* Find(uint64_t hash, uint64_t size)
+	{
+		auto it = m_textures.find(hash);
+		if (it == m_textures.end() || it->second.size != size)
+		{
+			return nullptr;
+		}
+
+		it->second.texture->AddRef();
+		return it->second.texture;
+	}
+
+	TTexture* Create(MappedFile const& file)
+	{
+#ifdef DDS_LOADER_LZ4
+		if (DDSLz4::IsFrame(file.GetData(), file.GetSize()))
+		{
+			size_t size = DDSLz4::GetContentSize(file.GetData(), file.GetSize());
+			std::unique_ptr<uint8_t[]> data(size ? new (std::nothrow) uint8_t[size] : nullptr);
+			if (!data || !DDSLz4::Decompress(file.GetData(), file.GetSize(), data.get(), size))
+			{
+				return nullptr;
+			}
+
+			return m_create(data.get(), size);
+		}
+#endif
+
+		return m_create(file.GetData(), file.GetSize());
+	}
+};
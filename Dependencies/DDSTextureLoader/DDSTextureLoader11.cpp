@@ -14,12 +14,29 @@
 // http://go.microsoft.com/fwlink/?LinkId=248929
 //--------------------------------------------------------------------------------------
 
+// Optional features, each compiled in only when its macro is defined so consumers that don't use
+// them don't need the dependency:
+//   DDS_LOADER_MAPPED_FILE   Map files instead of reading them into a heap copy
+//   DDS_LOADER_LZ4           Load lz4-framed .dds.lz4 containers, needs Dependencies\lz4
+//   DDS_LOADER_CPU_MIPS      Build missing mip chains for 32-bit color textures on the CPU, needs oneTBB
+
 #include "DDSTextureLoader11.h"
 
 #include <algorithm>
 #include <cassert>
 #include <memory>
 #include <new>
+#include <vector>
+
+#ifdef DDS_LOADER_MAPPED_FILE
+#include "../MappedFile.h"
+#endif
+#ifdef DDS_LOADER_LZ4
+#include "DDSLz4.h"
+#endif
+#ifdef DDS_LOADER_CPU_MIPS
+#include "MipGenerator.h"
+#endif
 
 #ifdef _MSC_VER
 // Off by default warnings
@@ -209,10 +226,30 @@ namespace
     }
 
 
+    //--------------------------------------------------------------------------------------
+    // Owns the file contents header and bitData point into until the resource is created
+    //--------------------------------------------------------------------------------------
+    struct DDSFileData
+    {
+#ifdef DDS_LOADER_MAPPED_FILE
+        MappedFile mapping;
+#endif
+        std::unique_ptr<uint8_t[]> buffer;      // The file read into memory, or the unpacked .dds.lz4
+
+        void Reset() noexcept
+        {
+#ifdef DDS_LOADER_MAPPED_FILE
+            mapping.Close();
+#endif
+            buffer.reset();
+        }
+    };
+
+
     //--------------------------------------------------------------------------------------
     HRESULT LoadTextureDataFromFile(
         _In_z_ const wchar_t* fileName,
-        std::unique_ptr<uint8_t[]>& ddsData,
+        DDSFileData& ddsData,
         const DDS_HEADER** header,
         const uint8_t** bitData,
         size_t* bitSize) noexcept
@@ -224,6 +261,18 @@ namespace
 
         *bitSize = 0;
 
+#ifdef DDS_LOADER_MAPPED_FILE
+        // Map the file instead of reading it into a heap copy, header and bitData point into the
+        // view and stay valid until ddsData is closed once the resource is created
+        if (!ddsData.mapping.Open(fileName))
+        {
+            HRESULT hr = HRESULT_FROM_WIN32(GetLastError());
+            return FAILED(hr) ? hr : E_FAIL;
+        }
+
+        const uint8_t* data = ddsData.mapping.GetData();
+        size_t dataSize = ddsData.mapping.GetSize();
+#else
         // open the file
 #if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
         ScopedHandle hFile(safe_handle(CreateFile2(fileName,
@@ -266,8 +315,8 @@ namespace
         }
 
         // create enough space for the file data
-        ddsData.reset(new (std::nothrow) uint8_t[fileInfo.EndOfFile.LowPart]);
-        if (!ddsData)
+        ddsData.buffer.reset(new (std::nothrow) uint8_t[fileInfo.EndOfFile.LowPart]);
+        if (!ddsData.buffer)
         {
             return E_OUTOFMEMORY;
         }
@@ -275,63 +324,64 @@ namespace
         // read the data in
         DWORD bytesRead = 0;
         if (!ReadFile(hFile.get(),
-            ddsData.get(),
+            ddsData.buffer.get(),
             fileInfo.EndOfFile.LowPart,
             &bytesRead,
             nullptr
         ))
         {
-            ddsData.reset();
+            ddsData.Reset();
             return HRESULT_FROM_WIN32(GetLastError());
         }
 
         if (bytesRead < fileInfo.EndOfFile.LowPart)
         {
-            ddsData.reset();
-            return E_FAIL;
-        }
-
-        // DDS files always start with the same magic number ("DDS ")
-        auto dwMagicNumber = *reinterpret_cast<const uint32_t*>(ddsData.get());
-        if (dwMagicNumber != DDS_MAGIC)
-        {
-            ddsData.reset();
+            ddsData.Reset();
             return E_FAIL;
         }
 
-        auto hdr = reinterpret_cast<const DDS_HEADER*>(ddsData.get() + sizeof(uint32_t));
+        const uint8_t* data = ddsData.buffer.get();
+        size_t dataSize = fileInfo.EndOfFile.LowPart;
+#endif
 
-        // Verify header to validate DDS file
-        if (hdr->size != sizeof(DDS_HEADER) ||
-            hdr->ddspf.size != sizeof(DDS_PIXELFORMAT))
+#ifdef DDS_LOADER_LZ4
+        // .dds.lz4, decompressed straight into the buffer the texture is created from
+        if (DDSLz4::IsFrame(data, dataSize))
         {
-            ddsData.reset();
-            return E_FAIL;
-        }
+            size_t unpackedSize = DDSLz4::GetContentSize(data, dataSize);
+            if (!unpackedSize)
+            {
+                ddsData.Reset();
+                return E_FAIL;
+            }
 
-        // Check for DX10 extension
-        bool bDXT10Header = false;
-        if ((hdr->ddspf.flags & DDS_FOURCC) &&
-            (MAKEFOURCC('D', 'X', '1', '0') == hdr->ddspf.fourCC))
-        {
-            // Must be long enough for both headers and magic value
-            if (fileInfo.EndOfFile.LowPart < (sizeof(uint32_t) + sizeof(DDS_HEADER) + sizeof(DDS_HEADER_DXT10)))
+            std::unique_ptr<uint8_t[]> unpackedData(new (std::nothrow) uint8_t[unpackedSize]);
+            if (!unpackedData)
+            {
+                ddsData.Reset();
+                return E_OUTOFMEMORY;
+            }
+
+            bool unpacked = DDSLz4::Decompress(data, dataSize, unpackedData.get(), unpackedSize);
+            ddsData.Reset();
+            if (!unpacked)
             {
-                ddsData.reset();
                 return E_FAIL;
             }
 
-            bDXT10Header = true;
+            ddsData.buffer = std::move(unpackedData);
+            data = ddsData.buffer.get();
+            dataSize = unpackedSize;
         }
+#endif
 
-        // setup the pointers in the process request
-        *header = hdr;
-        auto offset = sizeof(uint32_t) + sizeof(DDS_HEADER)
-            + (bDXT10Header ? sizeof(DDS_HEADER_DXT10) : 0);
-        *bitData = ddsData.get() + offset;
-        *bitSize = fileInfo.EndOfFile.LowPart - offset;
+        HRESULT hr = LoadTextureDataFromMemory(data, dataSize, header, bitData, bitSize);
+        if (FAILED(hr))
+        {
+            ddsData.Reset();
+        }
 
-        return S_OK;
+        return hr;
     }
 
 
@@ -1267,6 +1317,60 @@ namespace
         return hr;
     }
 
+#ifdef DDS_LOADER_CPU_MIPS
+    //--------------------------------------------------------------------------------------
+    // Full mip chains for 32-bit color textures shipped without mips, built on the CPU when
+    // the device can't generate them. sRGB formats are filtered in linear space.
+    //--------------------------------------------------------------------------------------
+    bool IsMipGeneratable(_In_ DXGI_FORMAT format) noexcept
+    {
+        switch (format)
+        {
+        case DXGI_FORMAT_R8G8B8A8_UNORM:
+        case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+        case DXGI_FORMAT_B8G8R8A8_UNORM:
+        case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+        case DXGI_FORMAT_B8G8R8X8_UNORM:
+        case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+            return true;
+
+        default:
+            return false;
+        }
+    }
+
+    HRESULT GenerateMipChain(
+        _In_ UINT width,
+        _In_ UINT height,
+        _In_ UINT arraySize,
+        _In_ DXGI_FORMAT format,
+        _In_ bool forceSRGB,
+        _In_reads_bytes_(bitSize) const uint8_t* bitData,
+        _In_ size_t bitSize,
+        std::vector<uint8_t>& mipData) noexcept
+    {
+        if (static_cast<uint64_t>(width) * height * 4 * arraySize > bitSize)
+            return HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
+
+        bool srgb = forceSRGB
+            || format == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB
+            || format == DXGI_FORMAT_B8G8R8A8_UNORM_SRGB
+            || format == DXGI_FORMAT_B8G8R8X8_UNORM_SRGB;
+
+        try
+        {
+            MipGenerator::GenerateChain(bitData, width, height, arraySize, srgb, mipData);
+        }
+        catch (...)
+        {
+            return E_OUTOFMEMORY;
+        }
+
+        return S_OK;
+    }
+#endif
+
+
     //--------------------------------------------------------------------------------------
     HRESULT CreateTextureFromDDS(
         _In_ ID3D11Device* d3dDevice,
@@ -1468,6 +1572,22 @@ namespace
             }
         }
 
+#ifdef DDS_LOADER_CPU_MIPS
+        // Without driver support the chain is built on the CPU and created like any other mipped texture
+        std::vector<uint8_t> mipData;
+        if (mipCount == 1 && d3dContext && textureView && !autogen
+            && resDim == D3D11_RESOURCE_DIMENSION_TEXTURE2D && IsMipGeneratable(format))
+        {
+            hr = GenerateMipChain(width, height, arraySize, format, forceSRGB, bitData, bitSize, mipData);
+            if (FAILED(hr))
+                return hr;
+
+            bitData = mipData.data();
+            bitSize = mipData.size();
+            mipCount = MipGenerator::GetMipCount(width, height);
+        }
+#endif
+
         if (autogen)
         {
             // Create texture with auto-generated mipmaps
@@ -1967,7 +2087,7 @@ HRESULT DirectX::CreateDDSTextureFromFileEx(
     const uint8_t* bitData = nullptr;
     size_t bitSize = 0;
 
-    std::unique_ptr<uint8_t[]> ddsData;
+    DDSFileData ddsData;
     HRESULT hr = LoadTextureDataFromFile(fileName,
         ddsData,
         &header,
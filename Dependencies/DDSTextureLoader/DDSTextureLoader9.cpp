@@ -15,6 +15,13 @@
 //--------------------------------------------------------------------------------------
 
 // This file has been modified to add support for ATI1/ATI2.
+//
+// Optional features, each compiled in only when its macro is defined so consumers that don't use
+// them don't need the dependency:
+//   DDS_LOADER_MAPPED_FILE   Map files instead of reading them into a heap copy
+//   DDS_LOADER_LZ4           Load lz4-framed .dds.lz4 containers, needs Dependencies\lz4
+//   DDS_LOADER_BC_DECODE     Decode block compressed formats the device can't sample
+//   DDS_LOADER_CPU_MIPS      Build missing mip chains for 32-bit color textures on the CPU
 
 #include "DDSTextureLoader9.h"
 
@@ -24,9 +31,24 @@
 #include <cassert>
 #include <cstring>
 #include <memory>
+#include <new>
+#include <vector>
 
 #include <wrl/client.h>
 
+#ifdef DDS_LOADER_MAPPED_FILE
+#include "../MappedFile.h"
+#endif
+#ifdef DDS_LOADER_LZ4
+#include "DDSLz4.h"
+#endif
+#ifdef DDS_LOADER_BC_DECODE
+#include "BCDecoder.h"
+#endif
+#ifdef DDS_LOADER_CPU_MIPS
+#include "MipGenerator.h"
+#endif
+
 #ifdef __clang__
 #pragma clang diagnostic ignored "-Wcovered-switch-default"
 #pragma clang diagnostic ignored "-Wswitch-enum"
@@ -182,10 +204,30 @@ namespace
     }
 
 
+    //--------------------------------------------------------------------------------------
+    // Owns the file contents header and bitData point into until the resource is created
+    //--------------------------------------------------------------------------------------
+    struct DDSFileData
+    {
+#ifdef DDS_LOADER_MAPPED_FILE
+        MappedFile mapping;
+#endif
+        std::unique_ptr<uint8_t[]> buffer;      // The file read into memory, or the unpacked .dds.lz4
+
+        void Reset() noexcept
+        {
+#ifdef DDS_LOADER_MAPPED_FILE
+            mapping.Close();
+#endif
+            buffer.reset();
+        }
+    };
+
+
     //--------------------------------------------------------------------------------------
     HRESULT LoadTextureDataFromFile(
         _In_z_ const wchar_t* fileName,
-        std::unique_ptr<uint8_t[]>& ddsData,
+        DDSFileData& ddsData,
         const DDS_HEADER** header,
         const uint8_t** bitData,
         size_t* bitSize) noexcept
@@ -197,6 +239,18 @@ namespace
 
         *bitSize = 0;
 
+#ifdef DDS_LOADER_MAPPED_FILE
+        // Map the file instead of reading it into a heap copy, header and bitData point into the
+        // view and stay valid until ddsData is closed once the resource is created
+        if (!ddsData.mapping.Open(fileName))
+        {
+            HRESULT hr = HRESULT_FROM_WIN32(GetLastError());
+            return FAILED(hr) ? hr : E_FAIL;
+        }
+
+        const uint8_t* data = ddsData.mapping.GetData();
+        size_t dataSize = ddsData.mapping.GetSize();
+#else
         // open the file
 #if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
         ScopedHandle hFile(safe_handle(CreateFile2(fileName,
@@ -239,8 +293,8 @@ namespace
         }
 
         // create enough space for the file data
-        ddsData.reset(new (std::nothrow) uint8_t[fileInfo.EndOfFile.LowPart]);
-        if (!ddsData)
+        ddsData.buffer.reset(new (std::nothrow) uint8_t[fileInfo.EndOfFile.LowPart]);
+        if (!ddsData.buffer)
         {
             return E_OUTOFMEMORY;
         }
@@ -248,56 +302,64 @@ namespace
         // read the data in
         DWORD bytesRead = 0;
         if (!ReadFile(hFile.get(),
-            ddsData.get(),
+            ddsData.buffer.get(),
             fileInfo.EndOfFile.LowPart,
             &bytesRead,
             nullptr
         ))
         {
-            ddsData.reset();
+            ddsData.Reset();
             return HRESULT_FROM_WIN32(GetLastError());
         }
 
         if (bytesRead < fileInfo.EndOfFile.LowPart)
         {
-            ddsData.reset();
+            ddsData.Reset();
             return E_FAIL;
         }
 
-        // DDS files always start with the same magic number ("DDS ")
-        auto dwMagicNumber = *reinterpret_cast<const uint32_t*>(ddsData.get());
-        if (dwMagicNumber != DDS_MAGIC)
+        const uint8_t* data = ddsData.buffer.get();
+        size_t dataSize = fileInfo.EndOfFile.LowPart;
+#endif
+
+#ifdef DDS_LOADER_LZ4
+        // .dds.lz4, decompressed straight into the buffer the texture is created from
+        if (DDSLz4::IsFrame(data, dataSize))
         {
-            ddsData.reset();
-            return E_FAIL;
-        }
+            size_t unpackedSize = DDSLz4::GetContentSize(data, dataSize);
+            if (!unpackedSize)
+            {
+                ddsData.Reset();
+                return E_FAIL;
+            }
 
-        auto hdr = reinterpret_cast<const DDS_HEADER*>(ddsData.get() + sizeof(uint32_t));
+            std::unique_ptr<uint8_t[]> unpackedData(new (std::nothrow) uint8_t[unpackedSize]);
+            if (!unpackedData)
+            {
+                ddsData.Reset();
+                return E_OUTOFMEMORY;
+            }
 
-        // Verify header to validate DDS file
-        if (hdr->size != sizeof(DDS_HEADER) ||
-            hdr->ddspf.size != sizeof(DDS_PIXELFORMAT))
-        {
-            ddsData.reset();
-            return E_FAIL;
+            bool unpacked = DDSLz4::Decompress(data, dataSize, unpackedData.get(), unpackedSize);
+            ddsData.Reset();
+            if (!unpacked)
+            {
+                return E_FAIL;
+            }
+
+            ddsData.buffer = std::move(unpackedData);
+            data = ddsData.buffer.get();
+            dataSize = unpackedSize;
         }
+#endif
 
-        // Check for DX10 extension
-        if ((hdr->ddspf.flags & DDS_FOURCC) &&
-            (MAKEFOURCC('D', 'X', '1', '0') == hdr->ddspf.fourCC))
+        HRESULT hr = LoadTextureDataFromMemory(data, dataSize, header, bitData, bitSize);
+        if (FAILED(hr))
         {
-            // We don't support the new DX10 header for Direct3D 9
-            ddsData.reset();
-            return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+            ddsData.Reset();
         }
 
-        // setup the pointers in the process request
-        *header = hdr;
-        auto offset = sizeof(uint32_t) + sizeof(DDS_HEADER);
-        *bitData = ddsData.get() + offset;
-        *bitSize = fileInfo.EndOfFile.LowPart - offset;
-
-        return S_OK;
+        return hr;
     }
 
 
@@ -772,6 +834,167 @@ namespace
     #undef ISBITMASK
 
 
+    //--------------------------------------------------------------------------------------
+    // ATI2 has red & green channels swapped in D3D9, so the halves of every block are swapped
+    // while copying. The source stays untouched, it may be a read-only mapping of the file.
+    //--------------------------------------------------------------------------------------
+    void CopyRow(
+        _Out_writes_bytes_(destSize) uint8_t* dest,
+        _In_ size_t destSize,
+        _In_reads_bytes_(rowBytes) const uint8_t* src,
+        _In_ size_t rowBytes,
+        _In_ D3DFORMAT fmt) noexcept
+    {
+        if (fmt != D3DFMT_ATI2)
+        {
+            memcpy_s(dest, destSize, src, rowBytes);
+            return;
+        }
+
+        for (size_t i = 0; i + 16 <= rowBytes && i + 16 <= destSize; i += 16)
+        {
+            memcpy(dest + i, src + i + 8, 8);
+            memcpy(dest + i + 8, src + i, 8);
+        }
+    }
+
+
+#ifdef DDS_LOADER_BC_DECODE
+    //--------------------------------------------------------------------------------------
+    // CPU decoding of block compressed formats the device doesn't support, BC4/BC5 on
+    // most D3D9 drivers that don't expose ATI1/ATI2
+    //--------------------------------------------------------------------------------------
+    bool IsBlockCompressed(D3DFORMAT fmt) noexcept
+    {
+        switch (fmt)
+        {
+        case D3DFMT_DXT1:
+        case D3DFMT_DXT2:
+        case D3DFMT_DXT3:
+        case D3DFMT_DXT4:
+        case D3DFMT_DXT5:
+        case D3DFMT_ATI1:
+        case D3DFMT_ATI2:
+            return true;
+
+        default:
+            return false;
+        }
+    }
+
+    D3DRESOURCETYPE GetResourceType(_In_ const DDS_HEADER* header) noexcept
+    {
+        if (header->flags & DDS_HEADER_FLAGS_VOLUME)
+            return D3DRTYPE_VOLUMETEXTURE;
+
+        if (header->caps2 & DDS_CUBEMAP)
+            return D3DRTYPE_CUBETEXTURE;
+
+        return D3DRTYPE_TEXTURE;
+    }
+
+    bool IsFormatSupported(
+        _In_ LPDIRECT3DDEVICE9 device,
+        _In_ D3DRESOURCETYPE type,
+        _In_ DWORD usage,
+        _In_ D3DFORMAT fmt) noexcept
+    {
+        ComPtr<IDirect3D9> d3d;
+        D3DDEVICE_CREATION_PARAMETERS params = {};
+        D3DDISPLAYMODE mode = {};
+        if (FAILED(device->GetDirect3D(d3d.GetAddressOf()))
+            || FAILED(device->GetCreationParameters(&params))
+            || FAILED(d3d->GetAdapterDisplayMode(params.AdapterOrdinal, &mode)))
+        {
+            // Leave it to resource creation
+            return true;
+        }
+
+        return SUCCEEDED(d3d->CheckDeviceFormat(params.AdapterOrdinal, params.DeviceType, mode.Format, usage, type, fmt));
+    }
+
+    // BC1-BC3 and BC5 become A8R8G8B8, BC4 becomes L8. The header always directly precedes
+    // bitData in memory, so the whole file can be laid out again from it.
+    HRESULT DecodeBlockCompressed(
+        _In_ const DDS_HEADER* header,
+        _In_reads_bytes_(bitSize) const uint8_t* bitData,
+        _In_ size_t bitSize,
+        _Out_ DDS_HEADER& decodedHeader,
+        std::vector<uint8_t>& decodedData) noexcept
+    {
+        auto fileData = reinterpret_cast<const uint8_t*>(header) - sizeof(uint32_t);
+
+        DDSLayout layout;
+        if (!layout.Parse(fileData, static_cast<size_t>(bitData + bitSize - fileData)))
+            return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+
+        try
+        {
+            if (!BCDecoder::Decode(layout, fileData, decodedData))
+                return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+        }
+        catch (...)
+        {
+            return E_OUTOFMEMORY;
+        }
+
+        uint32_t bytes = BCDecoder::GetOutputBytes(layout.compression);
+        decodedHeader = *header;
+        decodedHeader.pitchOrLinearSize = layout.width * bytes;
+        decodedHeader.ddspf = bytes == 1
+            ? DDS_PIXELFORMAT{ sizeof(DDS_PIXELFORMAT), DDS_LUMINANCE, 8, 0xff, 0, 0, 0 }
+            : DDS_PIXELFORMAT{ sizeof(DDS_PIXELFORMAT), DDS_RGB, 32, 0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000 };
+
+        return S_OK;
+    }
+#endif
+
+
+#ifdef DDS_LOADER_CPU_MIPS
+    //--------------------------------------------------------------------------------------
+    // Full mip chains for 32-bit color textures shipped without mips, built on the CPU rather
+    // than relying on driver autogen. D3D9 formats don't say whether data is sRGB, so the
+    // chain is filtered like autogen would, without conversion.
+    //--------------------------------------------------------------------------------------
+    bool IsMipGeneratable(D3DFORMAT fmt) noexcept
+    {
+        switch (fmt)
+        {
+        case D3DFMT_A8R8G8B8:
+        case D3DFMT_X8R8G8B8:
+        case D3DFMT_A8B8G8R8:
+        case D3DFMT_X8B8G8R8:
+            return true;
+
+        default:
+            return false;
+        }
+    }
+
+    HRESULT GenerateMipChain(
+        _In_ UINT width,
+        _In_ UINT height,
+        _In_reads_bytes_(bitSize) const uint8_t* bitData,
+        _In_ size_t bitSize,
+        std::vector<uint8_t>& mipData) noexcept
+    {
+        if (static_cast<uint64_t>(width) * height * 4 > bitSize)
+            return HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
+
+        try
+        {
+            MipGenerator::GenerateChain(bitData, width, height, 1, false, mipData);
+        }
+        catch (...)
+        {
+            return E_OUTOFMEMORY;
+        }
+
+        return S_OK;
+    }
+#endif
+
+
     //--------------------------------------------------------------------------------------
     HRESULT CreateTextureFromDDS(
         _In_ LPDIRECT3DDEVICE9 device,
@@ -809,6 +1032,21 @@ namespace
             return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
         }
 
+#ifdef DDS_LOADER_BC_DECODE
+        // Block compressed formats the device can't sample are decoded on the CPU instead
+        if (IsBlockCompressed(fmt) && !IsFormatSupported(device, GetResourceType(header), usage, fmt))
+        {
+            DDS_HEADER decodedHeader = {};
+            std::vector<uint8_t> decodedData;
+            hr = DecodeBlockCompressed(header, bitData, bitSize, decodedHeader, decodedData);
+            if (FAILED(hr))
+                return hr;
+
+            return CreateTextureFromDDS(device, &decodedHeader, decodedData.data(), decodedData.size(),
+                usage, pool, texture, generateMipsIfMissing);
+        }
+#endif
+
         // Mipmaps smaller than 4x4 won't have enough space allocated for ATI1/ATI2 textures,
         // so mipmap count is going to be clamped to avoid memory corruptions.
         if (fmt == D3DFMT_ATI1 || fmt == D3DFMT_ATI2)
@@ -834,25 +1072,6 @@ namespace
             }
         }
 
-        // ATI2 has red & green channels swapped in D3D9.
-        // Data is going to be swizzled to overcome this behavior.
-        if (fmt == D3DFMT_ATI2)
-        {
-            UINT64* pBits = (UINT64*)bitData;
-            UINT64* pBitsEnd = (UINT64*)(bitData + bitSize);
-
-            while (pBits < pBitsEnd)
-            {
-                UINT64 Red = pBits[0];
-                UINT64 Green = pBits[1];
-
-                pBits[0] = Green;
-                pBits[1] = Red;
-
-                pBits += 2;
-            }
-        }
-
         if (header->flags & DDS_HEADER_FLAGS_VOLUME)
         {
             UINT iDepth = header->depth;
@@ -923,7 +1142,7 @@ namespace
                         // Copy stride line by line
                         for (size_t h = 0; h < NumRows; h++)
                         {
-                            memcpy_s(dptr, static_cast<size_t>(LockedBox.RowPitch), sptr, RowBytes);
+                            CopyRow(dptr, static_cast<size_t>(LockedBox.RowPitch), sptr, RowBytes, fmt);
                             dptr += LockedBox.RowPitch;
                             sptr += RowBytes;
                         }
@@ -1031,7 +1250,7 @@ namespace
                         // Copy stride line by line
                         for (size_t r = 0; r < NumRows; r++)
                         {
-                            memcpy_s(pDestBits, static_cast<size_t>(LockedRect.Pitch), pSrcBits, RowBytes);
+                            CopyRow(pDestBits, static_cast<size_t>(LockedRect.Pitch), pSrcBits, RowBytes, fmt);
                             pDestBits += LockedRect.Pitch;
                             pSrcBits += RowBytes;
                         }
@@ -1065,6 +1284,22 @@ namespace
                 return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
             }
 
+#ifdef DDS_LOADER_CPU_MIPS
+            // 32-bit color formats get their chain from the CPU, the rest is left to driver autogen
+            std::vector<uint8_t> mipData;
+            if (generateMipsIfMissing && iMipCount == 1 && IsMipGeneratable(fmt))
+            {
+                hr = GenerateMipChain(iWidth, iHeight, bitData, bitSize, mipData);
+                if (FAILED(hr))
+                    return hr;
+
+                bitData = mipData.data();
+                bitSize = mipData.size();
+                iMipCount = MipGenerator::GetMipCount(iWidth, iHeight);
+                generateMipsIfMissing = false;
+            }
+#endif
+
             // Create the texture (let the runtime do the validation)
             if (generateMipsIfMissing)
                 usage |= D3DUSAGE_AUTOGENMIPMAP;
@@ -1123,7 +1358,7 @@ namespace
                     // Copy stride line by line
                     for (UINT h = 0; h < NumRows; h++)
                     {
-                        memcpy_s(pDestBits, static_cast<size_t>(LockedRect.Pitch), pSrcBits, RowBytes);
+                        CopyRow(pDestBits, static_cast<size_t>(LockedRect.Pitch), pSrcBits, RowBytes, fmt);
                         pDestBits += LockedRect.Pitch;
                         pSrcBits += RowBytes;
                     }
@@ -1432,7 +1667,7 @@ HRESULT DirectX::CreateDDSTextureFromFileEx(
     const uint8_t* bitData = nullptr;
     size_t bitSize = 0;
 
-    std::unique_ptr<uint8_t[]> ddsData;
+    DDSFileData ddsData;
     HRESULT hr = LoadTextureDataFromFile(fileName,
         ddsData,
         &header,
@@ -0,0 +1,381 @@
+#pragma once
+
+// Asynchronous DDS loading for textures requested from the render thread.
+// Load returns a handle right away, oneTBB workers map the file, fault it in and validate and
+// lay it out with DDSLayout. Update, called once per frame from the render thread, creates the
+// D3D resources of ready files until the frame's byte budget is spent, so a burst of requests is
+// spread over several frames instead of stalling one. Until then a handle hands out the placeholder.
+//
+//   DDSTextureStreamer<IDirect3DBaseTexture9> streamer([&](const uint8_t* data, size_t size)
+//   {
+//       IDirect3DBaseTexture9* texture = nullptr;
+//       DirectX::CreateDDSTextureFromMemory(device, data, size, &texture);
+//       return texture;
+//   }, placeholder);
+//
+//   auto handle = streamer.Load(L"mods\\Foo\\bar.dds");
+//   ...
+//   streamer.Update(8 * 1024 * 1024);	// Every frame
+//   device->SetTexture(0, handle->GetTexture());
+//
+// With a preview size, Load first reads only the mip tail starting at the largest mip that fits it,
+// which is at the end of every mip chain, and creates a small texture from that. The full texture
+// replaces it once the whole file is in. Volume textures and files without mips load in one step.
+//
+// TTexture is a COM interface, handles Release their texture. Dropping every reference to a handle
+// before it's ready cancels its upload. Requires Dependencies\oneTBB\include in the include path.
+// Defining DDS_LOADER_LZ4 adds .dds.lz4 containers, loaded in one step and decompressed by the
+// workers, which needs Dependencies\lz4\include in the include path and liblz4_static.lib linked.
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <new>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <oneapi/tbb/concurrent_queue.h>
+#include <oneapi/tbb/task_arena.h>
+#include <oneapi/tbb/task_group.h>
+
+#include "../MappedFile.h"
+#include "DDSLayout.h"
+#ifdef DDS_LOADER_LZ4
+#include "DDSLz4.h"
+#endif
+
+template<typename TTexture>
+class DDSTextureStreamer
+{
+public:
+	// Runs on the render thread, returns nullptr if the resource couldn't be created
+	using CreateCallback = std::function<TTexture*(const uint8_t* data, size_t size)>;
+
+	enum class State
+	{
+		Pending,
+		Preview,	// Low resolution mip tail, the full texture is still loading
+		Ready,
+		Failed,
+	};
+
+	class Handle
+	{
+	public:
+		explicit Handle(TTexture* placeholder) : m_placeholder(placeholder)
+		{
+		}
+
+		~Handle()
+		{
+			if (m_texture)
+			{
+				m_texture->Release();
+			}
+		}
+
+		Handle(Handle const&) = delete;
+		Handle& operator=(Handle const&) = delete;
+
+		// The placeholder until a preview or the texture is ready. Call from the render thread,
+		// a preview is released there when the full texture replaces it.
+		TTexture* GetTexture() const
+		{
+			State state = m_state.load(std::memory_order_acquire);
+			return state != State::Pending && m_texture ? m_texture : m_placeholder;
+		}
+
+		State GetState() const
+		{
+			return m_state.load(std::memory_order_acquire);
+		}
+
+	private:
+		friend class DDSTextureStreamer;
+
+		TTexture* m_placeholder;
+		TTexture* m_texture{};
+		std::atomic<State> m_state{ State::Pending };
+
+		void Complete(TTexture* texture, bool preview)
+		{
+			if (preview && (!texture || m_state.load(std::memory_order_relaxed) != State::Pending))
+			{
+				if (texture)
+				{
+					texture->Release();
+				}
+				return;
+			}
+
+			// A failed full load keeps showing the preview
+			TTexture* previous = texture ? m_texture : nullptr;
+			if (texture)
+			{
+				m_texture = texture;
+			}
+			m_state.store(!texture ? State::Failed : preview ? State::Preview : State::Ready, std::memory_order_release);
+
+			if (previous)
+			{
+				previous->Release();
+			}
+		}
+	};
+
+	using HandlePtr = std::shared_ptr<Handle>;
+
+	// The placeholder isn't owned, it has to outlive the streamer and its handles
+	explicit DDSTextureStreamer(CreateCallback create, TTexture* placeholder = nullptr)
+		: m_create(std::move(create)), m_placeholder(placeholder)
+	{
+	}
+
+	~DDSTextureStreamer()
+	{
+		m_arena.execute([&] { m_tasks.wait(); });
+	}
+
+	DDSTextureStreamer(DDSTextureStreamer const&) = delete;
+	DDSTextureStreamer& operator=(DDSTextureStreamer const&) = delete;
+
+	// previewSize is the largest width or height of the preview, 0 loads in one step
+	HandlePtr Load(std::filesystem::path path, uint32_t previewSize = 0)
+	{
+		HandlePtr handle = std::make_shared<Handle>(m_placeholder);
+		m_pending.fetch_add(1, std::memory_order_relaxed);
+
+		// The job holds the only reference besides the caller's, so Update can tell when the caller let go
+		Job* pending = new Job{ handle, {}, {}, 0, std::move(path) };
+		// Enqueued rather than run: enqueued work gets a worker even on a single core machine,
+		// where run() would wait for someone to call wait()
+		m_arena.enqueue(m_tasks.defer([this, pending, previewSize]
+		{
+			std::unique_ptr<Job> job(pending);
+			if (previewSize)
+			{
+				auto preview = std::make_unique<Job>();
+				if (ReadPreview(job->path, previewSize, preview->buffer))
+				{
+					preview->handle = job->handle;
+					preview->uploadSize = preview->buffer.size();
+					preview->preview = true;
+					m_pending.fetch_add(1, std::memory_order_relaxed);
+					m_ready.push(std::move(preview));
+				}
+			}
+
+			// Failures go through the queue as well, handles are only ever completed by Update
+			try
+			{
+				job->failed = !job->file.Open(job->path) || !Prepare(*job);
+			}
+			catch (std::bad_alloc const&)
+			{
+				// A container claiming a content size nothing can hold
+				job->failed = true;
+			}
+
+			if (job->failed)
+			{
+				job->file.Close();
+				job->buffer = {};
+			}
+			m_ready.push(std::move(job));
+		}));
+
+		return handle;
+	}
+
+	// Render thread only. Creates resources until budgetBytes of texture data went to the device,
+	// at least one per call so a texture larger than the budget still makes progress.
+	// Returns the number of resources created.
+	size_t Update(size_t budgetBytes)
+	{
+		size_t created = 0;
+		size_t spent = 0;
+
+		std::unique_ptr<Job> job;
+		while ((created == 0 || spent < budgetBytes) && m_ready.try_pop(job))
+		{
+			m_pending.fetch_sub(1, std::memory_order_relaxed);
+
+			// Nobody is waiting for this one anymore
+			if (job->handle.use_count() == 1)
+			{
+				continue;
+			}
+
+			// A preview that the full texture already overtook isn't worth creating
+			if (job->preview && job->handle->GetState() != State::Pending)
+			{
+				continue;
+			}
+
+			if (job->failed)
+			{
+				job->handle->Complete(nullptr, false);
+				continue;
+			}
+
+			const uint8_t* data = !job->buffer.empty() ? job->buffer.data() : job->file.GetData();
+			size_t size = !job->buffer.empty() ? job->buffer.size() : job->file.GetSize();
+			job->handle->Complete(m_create(data, size), job->preview);
+			spent += (size_t)job->uploadSize;
+			created++;
+		}
+
+		return created;
+	}
+
+	// Requested but not created yet
+	size_t GetPendingCount() const
+	{
+		return m_pending.load(std::memory_order_relaxed);
+	}
+
+private:
+	struct Job
+	{
+		HandlePtr handle;
+		MappedFile file;
+		std::vector<uint8_t> buffer;	// A preview's reduced DDS or a decompressed container
+		uint64_t uploadSize{};
+		std::filesystem::path path;
+		bool preview{};
+		bool failed{};
+	};
+
+	CreateCallback m_create;
+	TTexture* m_placeholder;
+	tbb::task_arena m_arena;
+	tbb::task_group m_tasks;
+	tbb::concurrent_queue<std::unique_ptr<Job>> m_ready;
+	std::atomic<size_t> m_pending{};
+
+	static bool Prepare(Job& job)
+	{
+		DDSLayout layout;
+		const uint8_t* data = job.file.GetData();
+		size_t size = job.file.GetSize();
+
+#ifdef DDS_LOADER_LZ4
+		if (DDSLz4::IsFrame(data, size))
+		{
+			size_t unpackedSize = DDSLz4::GetContentSize(data, size);
+			if (!unpackedSize)
+			{
+				return false;
+			}
+
+			job.buffer.resize(unpackedSize);
+			bool unpacked = DDSLz4::Decompress(data, size, job.buffer.data(), unpackedSize);
+			job.file.Close();
+			if (!unpacked)
+			{
+				return false;
+			}
+
+			data = job.buffer.data();
+			size = job.buffer.size();
+		}
+#endif
+
+		// Formats DDSLayout doesn't cover are still left to the loader, they only need a valid magic
+		uint32_t magic = 0;
+		memcpy(&magic, data, std::min<size_t>(size, sizeof(magic)));
+		if (magic != DDSLayout::c_magic)
+		{
+			return false;
+		}
+
+		job.uploadSize = layout.Parse(data, size) ? layout.dataSize : size;
+
+		// Fault the mapping in here, so the render thread never waits on the disk
+		volatile uint8_t touch = 0;
+		for (size_t offset = 0; offset < size; offset += 4096)
+		{
+			touch = data[offset];
+		}
+		(void)touch;
+
+		return true;
+	}
+
+	// Builds a DDS holding only the mips from the largest one fitting previewSize on, read with
+	// one seek per array item. Fails if the file has no such mip or doesn't need a preview.
+	static bool ReadPreview(std::filesystem::path const& path, uint32_t previewSize, std::vector<uint8_t>& output)
+	{
+		std::ifstream stream(path, std::ios::binary);
+		std::error_code ec;
+		uint64_t fileSize = std::filesystem::file_size(path, ec);
+		if (!stream || ec)
+		{
+			return false;
+		}
+
+		uint8_t headers[sizeof(uint32_t) + sizeof(DDSLayout::Header) + sizeof(DDSLayout::HeaderDXT10)];
+		stream.read(reinterpret_cast<char*>(headers), sizeof(headers));
+
+		DDSLayout layout;
+		if (!layout.Parse(headers, (size_t)stream.gcount(), fileSize) || layout.isVolume || std::max<uint32_t>(layout.width, layout.height) <= previewSize)
+		{
+			return false;
+		}
+
+		// Block compressed top levels have to be whole blocks for D3D9
+		uint32_t first = 1;
+		for (; first < layout.mipCount; first++)
+		{
+			DDSLayout::Subresource const& mip = layout.GetSubresource(0, first);
+			if (std::max<uint32_t>(mip.width, mip.height) <= previewSize && (!layout.GetBlockBytes() || (mip.width % 4 == 0 && mip.height % 4 == 0)))
+			{
+				break;
+			}
+		}
+
+		if (first >= layout.mipCount)
+		{
+			return false;
+		}
+
+		DDSLayout::Subresource const& top = layout.GetSubresource(0, first);
+		DDSLayout::Header header = layout.header;
+		header.width = top.width;
+		header.height = top.height;
+		header.mipMapCount = layout.mipCount - first;
+		header.pitchOrLinearSize = layout.GetBlockBytes() ? (uint32_t)top.size : top.rowPitch;
+
+		uint64_t tailSize = 0;
+		for (uint32_t mip = first; mip < layout.mipCount; mip++)
+		{
+			tailSize += layout.GetSubresource(0, mip).size;
+		}
+
+		output.resize(layout.dataOffset + (size_t)(tailSize * layout.arraySize));
+		memcpy(output.data(), headers, layout.dataOffset);
+		memcpy(output.data() + sizeof(uint32_t), &header, sizeof(header));
+
+		uint8_t* destination = output.data() + layout.dataOffset;
+		for (uint32_t item = 0; item < layout.arraySize; item++)
+		{
+			stream.clear();
+			stream.seekg((std::streamoff)layout.GetSubresource(item, first).offset);
+			stream.read(reinterpret_cast<char*>(destination), (std::streamsize)tailSize);
+			if (!stream)
+			{
+				return false;
+			}
+			destination += tailSize;
+		}
+
+		return true;
+	}
+};
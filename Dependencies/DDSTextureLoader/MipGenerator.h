@@ -0,0 +1,205 @@
+#pragma once
+
+// CPU mip chain generation for 32-bit RGBA/BGRA textures shipped without mips.
+// Each level is a 2x2 box filter of the one above, odd trailing rows and columns are clamped.
+// Linear data is averaged with SSE2 where available. sRGB data is converted to 16-bit linear
+// through a table, averaged there and converted back, alpha (the fourth byte) is always linear.
+// Rows of every level are split over oneTBB workers.
+//
+// Requires Dependencies\oneTBB\include in the include path.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIP_GENERATOR_SSE2
+#include <emmintrin.h>
+#endif
+
+#include <oneapi/tbb/blocked_range.h>
+#include <oneapi/tbb/parallel_for.h>
+
+namespace MipGenerator
+{
+
+// Levels of a full chain down to 1x1
+inline uint32_t GetMipCount(uint32_t width, uint32_t height)
+{
+	uint32_t count = 1;
+	for (uint32_t extent = std::max<uint32_t>(width, height); extent > 1; extent >>= 1)
+	{
+		count++;
+	}
+	return count;
+}
+
+// Bytes of a full chain of one item
+inline size_t GetChainSize(uint32_t width, uint32_t height)
+{
+	size_t size = 0;
+	for (uint32_t mip = GetMipCount(width, height); mip > 0; mip--)
+	{
+		size += (size_t)width * height * 4;
+		width = std::max<uint32_t>(width >> 1, 1);
+		height = std::max<uint32_t>(height >> 1, 1);
+	}
+	return size;
+}
+
+namespace Detail
+{
+
+struct SRGBTables
+{
+	uint16_t toLinear[256];
+	uint8_t fromLinear[65536];
+
+	SRGBTables()
+	{
+		for (uint32_t i = 0; i < 256; i++)
+		{
+			double value = i / 255.0;
+			value = value <= 0.04045 ? value / 12.92 : std::pow((value + 0.055) / 1.055, 2.4);
+			toLinear[i] = (uint16_t)std::lround(value * 65535.0);
+		}
+
+		for (uint32_t i = 0; i < 65536; i++)
+		{
+			double value = i / 65535.0;
+			value = value <= 0.0031308 ? value * 12.92 : 1.055 * std::pow(value, 1.0 / 2.4) - 0.055;
+			fromLinear[i] = (uint8_t)std::lround(std::clamp(value, 0.0, 1.0) * 255.0);
+		}
+	}
+
+	static SRGBTables const& Get()
+	{
+		static const SRGBTables tables;
+		return tables;
+	}
+};
+
+// Averages a 2x2 footprint per destination pixel of one row. source0 and source1 are the two
+// source rows, identical when the source height is odd and this is its last row.
+inline void DownsampleRowLinear(const uint8_t* source0, const uint8_t* source1, uint32_t sourceWidth, uint8_t* destination, uint32_t width)
+{
+	uint32_t x = 0;
+
+#ifdef MIP_GENERATOR_SSE2
+	// Four destination pixels per iteration while both source columns exist
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i rounding = _mm_set1_epi16(2);
+	for (; x + 4 <= width && x * 2 + 8 <= sourceWidth; x += 4)
+	{
+		__m128i result[2];
+		for (uint32_t half = 0; half < 2; half++)
+		{
+			__m128i row0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source0 + (x + half * 2) * 8));
+			__m128i row1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source1 + (x + half * 2) * 8));
+
+			// Words of pixels 0-1 and 2-3, both rows summed
+			__m128i low = _mm_add_epi16(_mm_unpacklo_epi8(row0, zero), _mm_unpacklo_epi8(row1, zero));
+			__m128i high = _mm_add_epi16(_mm_unpackhi_epi8(row0, zero), _mm_unpackhi_epi8(row1, zero));
+
+			// Horizontal pairs land in the low four words
+			__m128i pair0 = _mm_add_epi16(low, _mm_srli_si128(low, 8));
+			__m128i pair1 = _mm_add_epi16(high, _mm_srli_si128(high, 8));
+			result[half] = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(pair0, pair1), rounding), 2);
+		}
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + x * 4), _mm_packus_epi16(result[0], result[1]));
+	}
+#endif
+
+	for (; x < width; x++)
+	{
+		uint32_t x0 = std::min<uint32_t>(x * 2, sourceWidth - 1) * 4;
+		uint32_t x1 = std::min<uint32_t>(x * 2 + 1, sourceWidth - 1) * 4;
+		for (uint32_t channel = 0; channel < 4; channel++)
+		{
+			uint32_t sum = source0[x0 + channel] + source0[x1 + channel] + source1[x0 + channel] + source1[x1 + channel];
+			destination[x * 4 + channel] = (uint8_t)((sum + 2) >> 2);
+		}
+	}
+}
+
+inline void DownsampleRowSRGB(const uint8_t* source0, const uint8_t* source1, uint32_t sourceWidth, uint8_t* destination, uint32_t width)
+{
+	SRGBTables const& tables = SRGBTables::Get();
+
+	for (uint32_t x = 0; x < width; x++)
+	{
+		uint32_t x0 = std::min<uint32_t>(x * 2, sourceWidth - 1) * 4;
+		uint32_t x1 = std::min<uint32_t>(x * 2 + 1, sourceWidth - 1) * 4;
+		for (uint32_t channel = 0; channel < 3; channel++)
+		{
+			uint32_t sum = tables.toLinear[source0[x0 + channel]] + tables.toLinear[source0[x1 + channel]] +
+				tables.toLinear[source1[x0 + channel]] + tables.toLinear[source1[x1 + channel]];
+			destination[x * 4 + channel] = tables.fromLinear[(sum + 2) >> 2];
+		}
+
+		uint32_t alpha = source0[x0 + 3] + source0[x1 + 3] + source1[x0 + 3] + source1[x1 + 3];
+		destination[x * 4 + 3] = (uint8_t)((alpha + 2) >> 2);
+	}
+}
+
+} // namespace Detail
+
+// Builds the level below a width x height level of tightly packed 4 byte pixels
+inline void Downsample(const uint8_t* source, uint32_t width, uint32_t height, uint8_t* destination, bool srgb)
+{
+	uint32_t destinationWidth = std::max<uint32_t>(width >> 1, 1);
+	uint32_t destinationHeight = std::max<uint32_t>(height >> 1, 1);
+	size_t sourcePitch = (size_t)width * 4;
+	size_t destinationPitch = (size_t)destinationWidth * 4;
+
+	tbb::parallel_for(tbb::blocked_range<uint32_t>(0, destinationHeight, 32), [&](tbb::blocked_range<uint32_t> const& range)
+	{
+		for (uint32_t y = range.begin(); y < range.end(); y++)
+		{
+			const uint8_t* row0 = source + std::min<uint32_t>(y * 2, height - 1) * sourcePitch;
+			const uint8_t* row1 = source + std::min<uint32_t>(y * 2 + 1, height - 1) * sourcePitch;
+			uint8_t* row = destination + y * destinationPitch;
+
+			if (srgb)
+			{
+				Detail::DownsampleRowSRGB(row0, row1, width, row, destinationWidth);
+			}
+			else
+			{
+				Detail::DownsampleRowLinear(row0, row1, width, row, destinationWidth);
+			}
+		}
+	});
+}
+
+// Builds full chains for arraySize consecutive width x height top levels. output receives every
+// item's top level followed by its smaller mips, tightly packed in DDS order.
+inline void GenerateChain(const uint8_t* data, uint32_t width, uint32_t height, uint32_t arraySize, bool srgb, std::vector<uint8_t>& output)
+{
+	size_t topSize = (size_t)width * height * 4;
+	size_t chainSize = GetChainSize(width, height);
+	output.resize(chainSize * arraySize);
+
+	tbb::parallel_for(0u, arraySize, [&](uint32_t item)
+	{
+		uint8_t* level = output.data() + chainSize * item;
+		memcpy(level, data + topSize * item, topSize);
+
+		uint32_t w = width, h = height;
+		for (uint32_t mip = 1; mip < GetMipCount(width, height); mip++)
+		{
+			uint8_t* next = level + (size_t)w * h * 4;
+			Downsample(level, w, h, next, srgb);
+
+			level = next;
+			w = std::max<uint32_t>(w >> 1, 1);
+			h = std::max<uint32_t>(h >> 1, 1);
+		}
+	});
+}
+
+} // namespace MipGenerator
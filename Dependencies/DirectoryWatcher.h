@@ -0,0 +1,516 @@
+#pragma once
+
+// Recursive directory watcher that reports coalesced add/remove/modify events.
+// Uses ReadDirectoryChangesW on Windows and inotify elsewhere.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Win32.h"
+
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace Common
+{
+
+enum class FileChangeType
+{
+	Added,
+	Removed,
+	Modified,
+	Overflow,	// Events were lost, subscribers have to rescan everything they track
+};
+
+struct FileChange
+{
+	FileChangeType type;
+	std::filesystem::path path;
+};
+
+class DirectoryWatcher
+{
+public:
+	using Callback = std::function<void(std::vector<FileChange> const&)>;
+
+	// Changes are delivered once nothing new happened for coalesceWindow,
+	// so copying a mod folder produces one batch instead of thousands.
+	explicit DirectoryWatcher(std::chrono::milliseconds coalesceWindow = std::chrono::milliseconds(100))
+		: m_coalesceWindow(coalesceWindow)
+	{
+#ifdef _WIN32
+		m_wakeEvent = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+#else
+		m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		m_wakeEvent = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#endif
+	}
+
+	~DirectoryWatcher()
+	{
+		m_running = false;
+		Wake();
+		if (m_thread.joinable())
+		{
+			m_thread.join();
+		}
+
+#ifdef _WIN32
+		for (auto& watch : m_watches)
+		{
+			// Nothing to cancel when the last read couldn't be issued again
+			if (watch->pending)
+			{
+				DWORD bytes = 0;
+				CancelIoEx(watch->directory, &watch->overlapped);
+				GetOverlappedResult(watch->directory, &watch->overlapped, &bytes, TRUE);
+			}
+			CloseHandle(watch->overlapped.hEvent);
+			CloseHandle(watch->directory);
+		}
+		CloseHandle(m_wakeEvent);
+#else
+		close(m_inotify);
+		close(m_wakeEvent);
+#endif
+	}
+
+	DirectoryWatcher(DirectoryWatcher const&) = delete;
+	DirectoryWatcher& operator=(DirectoryWatcher const&) = delete;
+
+	// Watch a directory and everything below it
+	bool Watch(std::filesystem::path const& directory)
+	{
+		std::error_code ec;
+		std::filesystem::path root = std::filesystem::absolute(directory, ec).lexically_normal();
+		if (ec || !std::filesystem::is_directory(root, ec))
+		{
+			return false;
+		}
+
+		{
+			std::lock_guard lock(m_watchMutex);
+#ifdef _WIN32
+			if (m_watches.size() >= MAXIMUM_WAIT_OBJECTS - 1)
+			{
+				return false;
+			}
+
+			auto watch = std::make_unique<Watch_t>();
+			watch->root = root;
+			watch->directory = CreateFileW(root.c_str(), FILE_LIST_DIRECTORY,
+				FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+				FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+
+			if (watch->directory == INVALID_HANDLE_VALUE)
+			{
+				return false;
+			}
+
+			watch->overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+			if (!IssueRead(*watch))
+			{
+				CloseHandle(watch->overlapped.hEvent);
+				CloseHandle(watch->directory);
+				return false;
+			}
+
+			m_watches.push_back(std::move(watch));
+#else
+			if (m_inotify < 0 || !AddWatchRecursive(root))
+			{
+				return false;
+			}
+#endif
+		}
+
+		if (!m_thread.joinable())
+		{
+			m_running = true;
+			m_thread = std::thread(&DirectoryWatcher::Run, this);
+		}
+		else
+		{
+			Wake();
+		}
+
+		return true;
+	}
+
+	// Callbacks run on the watcher thread
+	size_t Subscribe(Callback callback)
+	{
+		std::lock_guard lock(m_subscriberMutex);
+		m_subscribers.emplace_back(++m_nextSubscriberId, std::move(callback));
+		return m_nextSubscriberId;
+	}
+
+	void Unsubscribe(size_t id)
+	{
+		std::lock_guard lock(m_subscriberMutex);
+		for (auto it = m_subscribers.begin(); it != m_subscribers.end(); ++it)
+		{
+			if (it->first == id)
+			{
+				m_subscribers.erase(it);
+				break;
+			}
+		}
+	}
+
+	// Incremented after every delivered batch, cheap way for pollers to tell if anything changed
+	uint64_t GetGeneration() const
+	{
+		return m_generation.load(std::memory_order_acquire);
+	}
+
+private:
+	struct Pending
+	{
+		FileChangeType type;
+		size_t order;
+	};
+
+	std::chrono::milliseconds m_coalesceWindow;
+	std::atomic<bool> m_running{ false };
+	std::atomic<uint64_t> m_generation{ 0 };
+	std::thread m_thread;
+
+	std::mutex m_watchMutex;
+	std::mutex m_subscriberMutex;
+	std::vector<std::pair<size_t, Callback>> m_subscribers;
+	size_t m_nextSubscriberId{ 0 };
+
+	std::unordered_map<std::string, Pending> m_pending;
+	std::chrono::steady_clock::time_point m_lastEvent{};
+	bool m_overflow{ false };
+
+#ifdef _WIN32
+	struct Watch_t
+	{
+		std::filesystem::path root;
+		HANDLE directory{ INVALID_HANDLE_VALUE };
+		OVERLAPPED overlapped{};
+		bool pending{};		// A read is outstanding and owns buffer
+		alignas(DWORD) uint8_t buffer[64 * 1024];
+	};
+
+	HANDLE m_wakeEvent{};
+	std::vector<std::unique_ptr<Watch_t>> m_watches;
+
+	static bool IssueRead(Watch_t& watch)
+	{
+		watch.pending = ReadDirectoryChangesW(watch.directory, watch.buffer, sizeof(watch.buffer), TRUE,
+			FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE,
+			nullptr, &watch.overlapped, nullptr) != FALSE;
+		return watch.pending;
+	}
+
+	void Wake()
+	{
+		SetEvent(m_wakeEvent);
+	}
+
+	void Poll(int timeout)
+	{
+		std::vector<HANDLE> handles{ m_wakeEvent };
+		std::vector<Watch_t*> watches;
+		{
+			std::lock_guard lock(m_watchMutex);
+			for (auto& watch : m_watches)
+			{
+				handles.push_back(watch->overlapped.hEvent);
+				watches.push_back(watch.get());
+			}
+		}
+
+		DWORD result = WaitForMultipleObjects((DWORD)handles.size(), handles.data(), FALSE, timeout < 0 ? INFINITE : (DWORD)timeout);
+		if (result <= WAIT_OBJECT_0 || result >= WAIT_OBJECT_0 + handles.size())
+		{
+			return;
+		}
+
+		Watch_t& watch = *watches[result - WAIT_OBJECT_0 - 1];
+		DWORD bytes = 0;
+		bool success = GetOverlappedResult(watch.directory, &watch.overlapped, &bytes, FALSE) != FALSE;
+		ResetEvent(watch.overlapped.hEvent);
+		watch.pending = false;
+
+		if (!success || bytes == 0)
+		{
+			// Buffer overflowed, the kernel dropped the details
+			m_overflow = true;
+			m_lastEvent = std::chrono::steady_clock::now();
+		}
+		else
+		{
+			size_t offset = 0;
+			for (;;)
+			{
+				auto info = reinterpret_cast<FILE_NOTIFY_INFORMATION const*>(watch.buffer + offset);
+				std::filesystem::path path = watch.root / std::wstring(info->FileName, info->FileNameLength / sizeof(WCHAR));
+
+				switch (info->Action)
+				{
+				case FILE_ACTION_ADDED:
+				case FILE_ACTION_RENAMED_NEW_NAME:
+					Record(path, FileChangeType::Added);
+					break;
+
+				case FILE_ACTION_REMOVED:
+				case FILE_ACTION_RENAMED_OLD_NAME:
+					Record(path, FileChangeType::Removed);
+					break;
+
+				default:
+					Record(path, FileChangeType::Modified);
+					break;
+				}
+
+				if (!info->NextEntryOffset)
+				{
+					break;
+				}
+				offset += info->NextEntryOffset;
+			}
+		}
+
+		// The watched directory itself is gone, nothing it reports can be trusted any more
+		if (!IssueRead(watch))
+		{
+			m_overflow = true;
+			m_lastEvent = std::chrono::steady_clock::now();
+		}
+	}
+#else
+	int m_inotify{ -1 };
+	int m_wakeEvent{ -1 };
+	std::unordered_map<int, std::filesystem::path> m_watchDescriptors;
+
+	// inotify isn't recursive, every subdirectory needs its own watch
+	bool AddWatchRecursive(std::filesystem::path const& root)
+	{
+		const uint32_t mask = IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF;
+
+		int wd = inotify_add_watch(m_inotify, root.c_str(), mask);
+		if (wd < 0)
+		{
+			return false;
+		}
+		m_watchDescriptors[wd] = root;
+
+		std::error_code ec;
+		for (std::filesystem::recursive_directory_iterator it(root, ec), end; !ec && it != end; it.increment(ec))
+		{
+			if (it->is_directory(ec))
+			{
+				wd = inotify_add_watch(m_inotify, it->path().c_str(), mask);
+				if (wd >= 0)
+				{
+					m_watchDescriptors[wd] = it->path();
+				}
+			}
+		}
+
+		return true;
+	}
+
+	// A directory moved out of the tree keeps its watches, they would report changes under its old path
+	void RemoveWatchRecursive(std::filesystem::path const& root)
+	{
+		for (auto it = m_watchDescriptors.begin(); it != m_watchDescriptors.end();)
+		{
+			auto mismatch = std::mismatch(root.begin(), root.end(), it->second.begin(), it->second.end());
+			if (mismatch.first == root.end())
+			{
+				inotify_rm_watch(m_inotify, it->first);
+				it = m_watchDescriptors.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+	}
+
+	void Wake()
+	{
+		uint64_t value = 1;
+		(void)!write(m_wakeEvent, &value, sizeof(value));
+	}
+
+	void Poll(int timeout)
+	{
+		pollfd fds[2] = { { m_wakeEvent, POLLIN, 0 }, { m_inotify, POLLIN, 0 } };
+		if (poll(fds, 2, timeout) <= 0)
+		{
+			return;
+		}
+
+		if (fds[0].revents & POLLIN)
+		{
+			uint64_t value;
+			(void)!read(m_wakeEvent, &value, sizeof(value));
+		}
+
+		if (!(fds[1].revents & POLLIN))
+		{
+			return;
+		}
+
+		alignas(inotify_event) char buffer[64 * 1024];
+		ssize_t length;
+		while ((length = read(m_inotify, buffer, sizeof(buffer))) > 0)
+		{
+			std::lock_guard lock(m_watchMutex);
+			for (char* ptr = buffer; ptr < buffer + length; )
+			{
+				auto event = reinterpret_cast<inotify_event const*>(ptr);
+				ptr += sizeof(inotify_event) + event->len;
+
+				if (event->mask & IN_Q_OVERFLOW)
+				{
+					m_overflow = true;
+					m_lastEvent = std::chrono::steady_clock::now();
+					continue;
+				}
+
+				auto it = m_watchDescriptors.find(event->wd);
+				if (it == m_watchDescriptors.end())
+				{
+					continue;
+				}
+
+				if (event->mask & (IN_DELETE_SELF | IN_IGNORED))
+				{
+					if (event->mask & IN_IGNORED)
+					{
+						m_watchDescriptors.erase(it);
+					}
+					continue;
+				}
+
+				std::filesystem::path path = event->len ? it->second / event->name : it->second;
+				if (event->mask & (IN_CREATE | IN_MOVED_TO))
+				{
+					if (event->mask & IN_ISDIR)
+					{
+						AddWatchRecursive(path);
+					}
+					Record(path, FileChangeType::Added);
+				}
+				else if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+				{
+					// Moves within the tree are added back under the new path by IN_MOVED_TO
+					if ((event->mask & (IN_MOVED_FROM | IN_ISDIR)) == (IN_MOVED_FROM | IN_ISDIR))
+					{
+						RemoveWatchRecursive(path);
+					}
+					Record(path, FileChangeType::Removed);
+				}
+				else
+				{
+					Record(path, FileChangeType::Modified);
+				}
+			}
+		}
+	}
+#endif
+
+	// Merge a new event into whatever is still pending for the same path
+	void Record(std::filesystem::path const& path, FileChangeType type)
+	{
+		m_lastEvent = std::chrono::steady_clock::now();
+
+		auto [it, inserted] = m_pending.try_emplace(path.string(), Pending{ type, m_pending.size() });
+		if (inserted)
+		{
+			return;
+		}
+
+		FileChangeType& pending = it->second.type;
+		if (pending == FileChangeType::Added && type == FileChangeType::Removed)
+		{
+			m_pending.erase(it);	// Temporary file, never existed as far as subscribers are concerned
+		}
+		else if (pending == FileChangeType::Removed && type == FileChangeType::Added)
+		{
+			pending = FileChangeType::Modified;	// Replaced by a save-as-rename
+		}
+		else if (pending != FileChangeType::Added)
+		{
+			pending = type;
+		}
+	}
+
+	void Flush()
+	{
+		std::vector<FileChange> changes;
+		if (m_overflow)
+		{
+			changes.push_back({ FileChangeType::Overflow, {} });
+		}
+		else
+		{
+			std::vector<std::pair<size_t, FileChange>> ordered;
+			ordered.reserve(m_pending.size());
+			for (auto& [path, pending] : m_pending)
+			{
+				ordered.push_back({ pending.order, { pending.type, path } });
+			}
+			std::sort(ordered.begin(), ordered.end(), [](auto const& a, auto const& b) { return a.first < b.first; });
+
+			changes.reserve(ordered.size());
+			for (auto& [order, change] : ordered)
+			{
+				changes.push_back(std::move(change));
+			}
+		}
+
+		m_pending.clear();
+		m_overflow = false;
+
+		if (!changes.empty())
+		{
+			std::lock_guard lock(m_subscriberMutex);
+			for (auto& [id, callback] : m_subscribers)
+			{
+				callback(changes);
+			}
+		}
+
+		m_generation.fetch_add(1, std::memory_order_release);
+	}
+
+	void Run()
+	{
+		while (m_running)
+		{
+			bool hasPending = m_overflow || !m_pending.empty();
+			Poll(hasPending ? (int)m_coalesceWindow.count() : -1);
+
+			if ((m_overflow || !m_pending.empty()) && std::chrono::steady_clock::now() - m_lastEvent >= m_coalesceWindow)
+			{
+				Flush();
+			}
+		}
+	}
+};
+
+} // namespace Common
@@ -0,0 +1,338 @@
+#pragma once
+
+// Existence and metadata cache for IsFileExist / FileExists style probes.
+// The first probe under a directory enumerates it once and records every entry, later probes of any
+// path in that directory are a hash lookup. Keys are XXH3 hashes of the normalized absolute path.
+// Directories under a root registered with AddWatchedDirectory are trusted until ApplyChanges
+// reports a change in them. Any other directory has its write time checked at most once per
+// revalidation interval and is enumerated again when it moved, so a burst of probes costs one stat.
+// InvalidateDirectory and Invalidate drop listings immediately, Invalidate also bumps the generation.
+//
+// Without a watcher, files added or removed outside the loader can take up to one interval to show.
+// Directory write times don't change when a file is rewritten in place, so the size and write time
+// of such a file can lag until Invalidate.
+// Requires Dependencies\xxHash in the include path.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#define XXH_INLINE_ALL
+#include <xxhash.h>
+
+#include "DirectoryWatcher.h"
+
+namespace Common
+{
+
+struct FileMetadata
+{
+	bool exists{};
+	bool isDirectory{};
+	uint64_t size{};
+	std::filesystem::file_time_type lastWriteTime{};
+};
+
+class FileExistenceCache
+{
+public:
+	// A zero interval checks unwatched directories on every probe
+	explicit FileExistenceCache(std::chrono::milliseconds revalidateInterval = std::chrono::milliseconds(1000))
+		: m_revalidateInterval(revalidateInterval)
+	{
+	}
+
+	bool Exists(std::filesystem::path const& path)
+	{
+		return GetMetadata(path).exists;
+	}
+
+	FileMetadata GetMetadata(std::filesystem::path const& path)
+	{
+		// Callers mostly pass absolute, normal paths, those are split in place without building new ones
+		std::filesystem::path normalized;
+		std::filesystem::path const* source = &path;
+		if (!IsNormal(path))
+		{
+			normalized = Normalize(path);
+			if (!normalized.has_relative_path())
+			{
+				// Drive roots have no parent to enumerate
+				return Query(path);
+			}
+			source = &normalized;
+		}
+
+		NativeView native = source->native();
+		size_t separator = native.rfind(c_separator);
+		NativeView directory = native.substr(0, native.find(c_separator) == separator ? separator + 1 : separator);
+		uint64_t directoryHash = Hash(directory);
+		uint64_t nameHash = Hash(native.substr(separator + 1));
+
+		auto now = std::chrono::steady_clock::now();
+		std::shared_ptr<Directory> current;
+		{
+			std::shared_lock lock(m_mutex);
+			auto it = m_directories.find(directoryHash);
+			if (it != m_directories.end())
+			{
+				if (it->second->watched || IsFresh(*it->second, now))
+				{
+					return Find(*it->second, nameHash);
+				}
+				current = it->second;
+			}
+		}
+
+		// Entries were added, removed or renamed only if the directory's write time moved
+		std::filesystem::path directoryPath(directory);
+		std::error_code ec;
+		std::filesystem::file_time_type time = std::filesystem::last_write_time(directoryPath, ec);
+		if (current && current->exists == !ec && (ec || time == current->lastWriteTime))
+		{
+			current->checkedAt.store(now.time_since_epoch().count(), std::memory_order_relaxed);
+			return Find(*current, nameHash);
+		}
+
+		std::shared_ptr<Directory> enumerated = Enumerate(directoryPath);
+		enumerated->checkedAt.store(now.time_since_epoch().count(), std::memory_order_relaxed);
+
+		std::unique_lock lock(m_mutex);
+		enumerated->watched = IsWatched(directoryPath);
+		m_directories[directoryHash] = enumerated;
+		return Find(*enumerated, nameHash);
+	}
+
+	void Invalidate()
+	{
+		std::unique_lock lock(m_mutex);
+		m_directories.clear();
+		m_generation++;
+	}
+
+	// The directory is enumerated again on its next probe
+	void InvalidateDirectory(std::filesystem::path const& directory)
+	{
+		std::filesystem::path normalized = Normalize(directory);
+		std::unique_lock lock(m_mutex);
+		m_directories.erase(Hash(normalized.native()));
+	}
+
+	// Counts Invalidate calls, callers caching results of their own can compare it
+	uint64_t GetGeneration() const
+	{
+		std::shared_lock lock(m_mutex);
+		return m_generation;
+	}
+
+	// Call for every directory a DirectoryWatcher feeding ApplyChanges watches
+	void AddWatchedDirectory(std::filesystem::path const& directory)
+	{
+		std::unique_lock lock(m_mutex);
+		m_watchedDirectories.push_back(Normalize(directory));
+		m_directories.clear();
+	}
+
+	void ApplyChanges(std::vector<FileChange> const& changes)
+	{
+		std::unique_lock lock(m_mutex);
+		for (FileChange const& change : changes)
+		{
+			if (change.type == FileChangeType::Overflow)
+			{
+				m_directories.clear();
+				m_generation++;
+				return;
+			}
+
+			std::filesystem::path normalized = Normalize(change.path);
+			m_directories.erase(Hash(normalized.parent_path().native()));
+
+			// A removed or replaced directory takes its own listing with it
+			m_directories.erase(Hash(normalized.native()));
+		}
+	}
+
+private:
+	using NativeView = std::basic_string_view<std::filesystem::path::value_type>;
+	static constexpr std::filesystem::path::value_type c_separator = std::filesystem::path::preferred_separator;
+
+	struct IdentityHash
+	{
+		size_t operator()(uint64_t value) const { return (size_t)value; }
+	};
+
+	struct Directory
+	{
+		bool exists{};
+		bool watched{};
+		std::atomic<std::chrono::steady_clock::rep> checkedAt{};	// Steady clock ticks of the last write time check
+		std::filesystem::file_time_type lastWriteTime{};
+		std::unordered_map<uint64_t, FileMetadata, IdentityHash> entries;
+	};
+
+	mutable std::shared_mutex m_mutex;
+	std::unordered_map<uint64_t, std::shared_ptr<Directory>, IdentityHash> m_directories;
+	std::vector<std::filesystem::path> m_watchedDirectories;
+	uint64_t m_generation{};
+	std::chrono::milliseconds m_revalidateInterval;
+
+	// Paths are case-insensitive on Windows, ASCII folding is enough for game and mod paths
+	template<typename TString>
+	static uint64_t Hash(TString const& value)
+	{
+		using Char = typename TString::value_type;
+
+		Char buffer[260];
+		std::basic_string<Char> large;
+		Char* lower = buffer;
+		if (value.size() > sizeof(buffer) / sizeof(Char))
+		{
+			large.resize(value.size());
+			lower = large.data();
+		}
+
+		for (size_t i = 0; i < value.size(); i++)
+		{
+			Char c = value[i];
+			lower[i] = c >= 'A' && c <= 'Z' ? (Char)(c - 'A' + 'a') : c;
+		}
+		return XXH3_64bits(lower, value.size() * sizeof(Char));
+	}
+
+	static std::filesystem::path Normalize(std::filesystem::path const& path)
+	{
+		std::error_code ec;
+		std::filesystem::path normalized = std::filesystem::absolute(path, ec).lexically_normal();
+		if (!normalized.has_filename() && normalized.has_relative_path())
+		{
+			normalized = normalized.parent_path();
+		}
+		return normalized;
+	}
+
+	bool IsWatched(std::filesystem::path const& directory) const
+	{
+		for (std::filesystem::path const& root : m_watchedDirectories)
+		{
+			auto mismatch = std::mismatch(root.begin(), root.end(), directory.begin(), directory.end());
+			if (mismatch.first == root.end())
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Whether Normalize would return the path unchanged: absolute, preferred separators only, no empty,
+	// "." or ".." components and no trailing separator
+	static bool IsNormal(std::filesystem::path const& path)
+	{
+		NativeView native = path.native();
+		if (native.empty() || !path.is_absolute())
+		{
+			return false;
+		}
+
+		size_t start = 0;
+		for (size_t i = 0; i <= native.size(); i++)
+		{
+			if (i < native.size() && native[i] != '/' && native[i] != c_separator)
+			{
+				continue;
+			}
+
+			// Only a POSIX root starts with an empty component
+			NativeView component = native.substr(start, i - start);
+			if ((component.empty() && start != 0) || (component.size() == 1 && component[0] == '.') ||
+				(component.size() == 2 && component[0] == '.' && component[1] == '.'))
+			{
+				return false;
+			}
+
+			if (i < native.size() && native[i] != c_separator)
+			{
+				return false;
+			}
+			start = i + 1;
+		}
+
+		return true;
+	}
+
+	bool IsFresh(Directory const& directory, std::chrono::steady_clock::time_point now) const
+	{
+		std::chrono::steady_clock::duration checkedAt(directory.checkedAt.load(std::memory_order_relaxed));
+		return now - std::chrono::steady_clock::time_point(checkedAt) < m_revalidateInterval;
+	}
+
+	static FileMetadata Find(Directory const& directory, uint64_t nameHash)
+	{
+		auto it = directory.entries.find(nameHash);
+		return it != directory.entries.end() ? it->second : FileMetadata{};
+	}
+
+	static FileMetadata Query(std::filesystem::path const& path)
+	{
+		std::error_code ec;
+		std::filesystem::directory_entry entry(path, ec);
+		if (ec || !entry.exists(ec))
+		{
+			return {};
+		}
+
+		return MakeMetadata(entry);
+	}
+
+	// Directory iteration already carries size and times on Windows, this costs no extra calls there
+	static FileMetadata MakeMetadata(std::filesystem::directory_entry const& entry)
+	{
+		std::error_code ec;
+		FileMetadata metadata{ true, entry.is_directory(ec) };
+		if (!metadata.isDirectory)
+		{
+			uintmax_t size = entry.file_size(ec);
+			metadata.size = ec ? 0 : (uint64_t)size;
+		}
+		metadata.lastWriteTime = entry.last_write_time(ec);
+		return metadata;
+	}
+
+	static std::shared_ptr<Directory> Enumerate(std::filesystem::path const& path)
+	{
+		auto directory = std::make_shared<Directory>();
+
+		std::error_code ec;
+		directory->lastWriteTime = std::filesystem::last_write_time(path, ec);
+		directory->exists = !ec;
+		if (!directory->exists)
+		{
+			return directory;
+		}
+
+		for (std::filesystem::directory_iterator it(path, ec), end; !ec && it != end; it.increment(ec))
+		{
+			directory->entries.emplace(Hash(it->path().filename().native()), MakeMetadata(*it));
+		}
+
+		return directory;
+	}
+};
+
+inline FileExistenceCache& GetFileExistenceCache()
+{
+	static FileExistenceCache cache;
+	return cache;
+}
+
+} // namespace Common
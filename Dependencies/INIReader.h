@@ -325,6 +325,10 @@ public:
     // about the parsing.
     INIReader(FILE *file);
 
+    // Construct INIReader from values and sections previously returned by
+    // Values() and Sections(), without parsing anything.
+    INIReader(std::map<std::string, std::string> values, std::set<std::string> sections);
+
     // Return the result of ini_parse(), i.e., 0 on success, line number of
     // first error on parse error, or -1 on file open error.
     int ParseError() const;
@@ -332,6 +336,9 @@ public:
     // Return the list of sections found in ini file
     const std::set<std::string>& Sections() const;
 
+    // Return every value found in ini file, keyed by lowercase "section=name"
+    const std::map<std::string, std::string>& Values() const;
+
     // Get a string value from INI file, returning default_value if not found.
     std::string Get(std::string section, std::string name,
                     std::string default_value) const;
@@ -373,6 +380,7 @@ protected:
 #include <algorithm>
 #include <cctype>
 #include <cstdlib>
+#include <utility>
 
 inline INIReader::INIReader(std::string filename)
 {
@@ -384,6 +392,11 @@ inline INIReader::INIReader(FILE *file)
     _error = ini_parse_file(file, ValueHandler, this);
 }
 
+inline INIReader::INIReader(std::map<std::string, std::string> values, std::set<std::string> sections)
+    : _error(0), _values(std::move(values)), _sections(std::move(sections))
+{
+}
+
 inline int INIReader::ParseError() const
 {
     return _error;
@@ -394,6 +407,11 @@ inline const std::set<std::string>& INIReader::Sections() const
     return _sections;
 }
 
+inline const std::map<std::string, std::string>& INIReader::Values() const
+{
+    return _values;
+}
+
 inline std::string INIReader::Get(std::string section, std::string name, std::string default_value) const
 {
     std::string key = MakeKey(section, name);
@@ -0,0 +1,452 @@
+#pragma once
+
+// Asynchronous fan-out for LogEvent_t handlers.
+// Write only copies the message into a bounded lock-free ring (multiple producers, one consumer),
+// a background thread hands it to every handler, so slow handlers (formatting, disk, console)
+// no longer run on the thread that logged. When the ring is full the message is dropped and counted,
+// handlers are told how many were lost once there is room again.
+//
+// The format string and every %s / %ls argument are copied at Write time since the caller's buffers
+// may be gone by the time handlers run. Other arguments are forwarded as raw words like ModLoader::WriteLog does.
+// Messages that don't fit a ring cell move their copy to the heap instead of being cut short, and a
+// call with more arguments than can be tracked goes to the handlers synchronously.
+//
+// Loader side, WriteLog forwards to Write and AddLogger to AddHandler.
+// Mod side, registering Dispatch through ML_MSG_ADD_LOG_HANDLER with obj pointing at an AsyncLog
+// moves the mod's own handlers off the game thread:
+//
+//   static AsyncLog* log = new AsyncLog();
+//   log->AddHandler(nullptr, WriteToFile);
+//   AddLogHandlerMessage_t message{ log, AsyncLog::Dispatch };
+//   API->SendMessageToLoader(ML_MSG_ADD_LOG_HANDLER, &message);
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <cwchar>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "ModLoader.h"
+
+class AsyncLog
+{
+public:
+	static constexpr size_t c_inlineArguments = 8;	// p1, p2 and 6 words from parray fit a ring cell
+	static constexpr size_t c_inlineTextSize = 256;	// Format string and copied string arguments
+	static constexpr size_t c_maxArguments = 64;	// One bit each in Entry::stringMask
+
+	// capacity is rounded up to a power of two
+	explicit AsyncLog(size_t capacity = 4096)
+	{
+		size_t size = 2;
+		while (size < capacity)
+		{
+			size <<= 1;
+		}
+
+		m_mask = size - 1;
+		m_cells.reset(new Cell[size]);
+		for (size_t i = 0; i < size; i++)
+		{
+			m_cells[i].sequence.store(i, std::memory_order_relaxed);
+		}
+
+		m_handlers = std::make_shared<const HandlerList>();
+		m_thread = std::thread(&AsyncLog::Run, this);
+	}
+
+	// Dispatches whatever is still queued before returning.
+	// Don't let this run from DllMain, joining the thread there deadlocks on the loader lock.
+	~AsyncLog()
+	{
+		{
+			std::lock_guard lock(m_wakeMutex);
+			m_stop = true;
+		}
+		m_wake.notify_one();
+		m_thread.join();
+	}
+
+	AsyncLog(AsyncLog const&) = delete;
+	AsyncLog& operator=(AsyncLog const&) = delete;
+
+	// Handler lists are replaced, never modified in place, so the consumer keeps iterating
+	// the list it already loaded while registration happens on other threads.
+	void AddHandler(void* obj, LogEvent_t* handler)
+	{
+		std::lock_guard lock(m_handlersMutex);
+		auto handlers = std::make_shared<HandlerList>(*std::atomic_load(&m_handlers));
+		handlers->emplace_back(obj, handler);
+		std::atomic_store(&m_handlers, std::shared_ptr<const HandlerList>(std::move(handlers)));
+	}
+
+	void RemoveHandler(void* obj, LogEvent_t* handler)
+	{
+		std::lock_guard lock(m_handlersMutex);
+		auto handlers = std::make_shared<HandlerList>(*std::atomic_load(&m_handlers));
+		handlers->erase(std::remove(handlers->begin(), handlers->end(), std::make_pair(obj, handler)), handlers->end());
+		std::atomic_store(&m_handlers, std::shared_ptr<const HandlerList>(std::move(handlers)));
+	}
+
+	// Lock-free, returns false if the ring was full and the message got dropped
+	bool Write(int level, int category, const char* message, size_t p1, size_t p2, size_t* parray)
+	{
+		Layout layout = Measure(message, p1, p2, parray);
+		if (layout.argumentCount > c_maxArguments)
+		{
+			Deliver(*std::atomic_load(&m_handlers), level, category, message, p1, p2, parray);
+			return true;
+		}
+
+		size_t position = m_enqueue.load(std::memory_order_relaxed);
+		Cell* cell;
+		for (;;)
+		{
+			cell = &m_cells[position & m_mask];
+			size_t sequence = cell->sequence.load(std::memory_order_acquire);
+			intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+			if (difference == 0)
+			{
+				if (m_enqueue.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				{
+					break;
+				}
+			}
+			else if (difference < 0)
+			{
+				m_dropped.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+			else
+			{
+				position = m_enqueue.load(std::memory_order_relaxed);
+			}
+		}
+
+		Capture(cell->entry, layout, level, category, message, p1, p2, parray);
+		cell->sequence.store(position + 1, std::memory_order_release);
+
+		// Only pay for a notify when the consumer went to sleep. Paired with the fence in Run, either
+		// this sees the flag or the consumer sees the cell before it waits.
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (m_sleeping.load(std::memory_order_relaxed))
+		{
+			// Passing through the mutex keeps the notify from landing before the consumer waits
+			{
+				std::lock_guard lock(m_wakeMutex);
+			}
+			m_wake.notify_one();
+		}
+
+		return true;
+	}
+
+	// Blocks until everything written before this call went through the handlers
+	void Flush()
+	{
+		size_t target = m_enqueue.load(std::memory_order_acquire);
+		m_wake.notify_one();
+
+		std::unique_lock lock(m_wakeMutex);
+		m_flushed.wait(lock, [&] { return m_dispatched.load(std::memory_order_acquire) >= target || m_stop; });
+	}
+
+	uint64_t GetDropCount() const
+	{
+		return m_dropped.load(std::memory_order_relaxed);
+	}
+
+	// LogEvent_t adapter, obj is the AsyncLog
+	static void ML_API Dispatch(void* obj, int level, int category, const char* message, size_t p1, size_t p2, size_t* parray)
+	{
+		static_cast<AsyncLog*>(obj)->Write(level, category, message, p1, p2, parray);
+	}
+
+private:
+	using HandlerList = std::vector<std::pair<void*, LogEvent_t*>>;
+
+	struct Entry
+	{
+		int level;
+		int category;
+		uint32_t argumentCount;
+		uint64_t stringMask;					// Bit i set when argument i is an offset into the text
+		size_t arguments[c_inlineArguments];
+		char text[c_inlineTextSize];			// Format string first, then copied strings
+		std::unique_ptr<uint8_t[]> spill;		// Arguments then text when they don't fit the above
+
+		size_t* GetArguments()
+		{
+			return spill ? reinterpret_cast<size_t*>(spill.get()) : arguments;
+		}
+
+		char* GetText()
+		{
+			return spill ? reinterpret_cast<char*>(spill.get() + argumentCount * sizeof(size_t)) : text;
+		}
+	};
+
+	struct Layout
+	{
+		size_t argumentCount;
+		size_t textSize;
+	};
+
+	struct Cell
+	{
+		std::atomic<size_t> sequence;
+		Entry entry;
+	};
+
+	std::unique_ptr<Cell[]> m_cells;
+	size_t m_mask{};
+	alignas(64) std::atomic<size_t> m_enqueue{ 0 };
+	alignas(64) size_t m_dequeue{ 0 };			// Consumer thread only
+	std::atomic<size_t> m_dispatched{ 0 };
+	std::atomic<uint64_t> m_dropped{ 0 };
+	uint64_t m_reportedDrops{ 0 };				// Consumer thread only
+
+	std::mutex m_handlersMutex;
+	std::shared_ptr<const HandlerList> m_handlers;
+
+	std::mutex m_wakeMutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_flushed;
+	std::atomic<bool> m_sleeping{ false };
+	bool m_stop{ false };
+	std::thread m_thread;
+
+	// Walks printf conversions and calls argument(index, value, isString, isWide) for every word the call consumes
+	template<typename TFunction>
+	static void ForEachArgument(const char* message, size_t p1, size_t p2, size_t* parray, TFunction&& argument)
+	{
+		size_t index = 0;
+		auto nextArgument = [&](bool isString, bool isWide)
+		{
+			// Words past p2 only exist when the caller passed parray
+			if (index >= 2 && !parray)
+			{
+				return;
+			}
+
+			size_t value = index == 0 ? p1 : index == 1 ? p2 : parray[index - 2];
+			argument(index++, value, isString, isWide);
+		};
+
+		for (const char* c = message; *c; c++)
+		{
+			if (*c != '%')
+			{
+				continue;
+			}
+
+			if (*++c == '%')
+			{
+				continue;
+			}
+
+			bool isWide = false;
+			for (; *c && strchr("-+ #0123456789.*hlLzjtqIw", *c); c++)
+			{
+				if (*c == '*')
+				{
+					nextArgument(false, false);
+				}
+				else if (*c == 'l' || *c == 'w')
+				{
+					isWide = true;
+				}
+			}
+
+			if (!*c)
+			{
+				break;
+			}
+
+			nextArgument(*c == 's' || *c == 'S', *c == 'S' || (*c == 's' && isWide));
+		}
+	}
+
+	static size_t GetTextLength(size_t value, bool isWide)
+	{
+		return isWide ? wcslen(reinterpret_cast<const wchar_t*>(value)) : strlen(reinterpret_cast<const char*>(value));
+	}
+
+	// Strings are aligned to their character size and null terminated
+	static size_t AppendText(size_t offset, size_t length, size_t characterSize)
+	{
+		offset = (offset + characterSize - 1) & ~(characterSize - 1);
+		return offset + (length + 1) * characterSize;
+	}
+
+	static Layout Measure(const char* message, size_t p1, size_t p2, size_t* parray)
+	{
+		Layout layout{ 0, 1 };
+		if (!message)
+		{
+			return layout;
+		}
+
+		layout.textSize = strlen(message) + 1;
+		ForEachArgument(message, p1, p2, parray, [&](size_t, size_t value, bool isString, bool isWide)
+		{
+			layout.argumentCount++;
+			if (isString && value)
+			{
+				size_t characterSize = isWide ? sizeof(wchar_t) : 1;
+				layout.textSize = AppendText(layout.textSize, GetTextLength(value, isWide), characterSize);
+			}
+		});
+		return layout;
+	}
+
+	static void Capture(Entry& entry, Layout const& layout, int level, int category, const char* message, size_t p1, size_t p2, size_t* parray)
+	{
+		entry.level = level;
+		entry.category = category;
+		entry.argumentCount = (uint32_t)layout.argumentCount;
+		entry.stringMask = 0;
+		entry.spill.reset();
+
+		if (layout.argumentCount > c_inlineArguments || layout.textSize > c_inlineTextSize)
+		{
+			entry.spill.reset(new uint8_t[layout.argumentCount * sizeof(size_t) + layout.textSize]);
+		}
+
+		size_t* arguments = entry.GetArguments();
+		char* text = entry.GetText();
+		if (!message)
+		{
+			text[0] = '\0';
+			return;
+		}
+
+		size_t used = strlen(message) + 1;
+		memcpy(text, message, used);
+
+		ForEachArgument(message, p1, p2, parray, [&](size_t index, size_t value, bool isString, bool isWide)
+		{
+			if (isString && value)
+			{
+				size_t characterSize = isWide ? sizeof(wchar_t) : 1;
+				size_t length = GetTextLength(value, isWide);
+				size_t offset = (used + characterSize - 1) & ~(characterSize - 1);
+				memcpy(text + offset, reinterpret_cast<const void*>(value), (length + 1) * characterSize);
+
+				used = AppendText(used, length, characterSize);
+				value = offset;
+				entry.stringMask |= 1ull << index;
+			}
+
+			arguments[index] = value;
+		});
+	}
+
+	bool HasPending() const
+	{
+		return m_cells[m_dequeue & m_mask].sequence.load(std::memory_order_acquire) == m_dequeue + 1;
+	}
+
+	bool TryDequeue(Entry& entry)
+	{
+		Cell& cell = m_cells[m_dequeue & m_mask];
+		if (cell.sequence.load(std::memory_order_acquire) != m_dequeue + 1)
+		{
+			return false;
+		}
+
+		entry = std::move(cell.entry);
+		cell.sequence.store(m_dequeue + m_mask + 1, std::memory_order_release);
+		m_dequeue++;
+		return true;
+	}
+
+	static void Deliver(HandlerList const& handlers, int level, int category, const char* message, size_t p1, size_t p2, size_t* parray)
+	{
+		for (auto const& [obj, handler] : handlers)
+		{
+			handler(obj, level, category, message, p1, p2, parray);
+		}
+	}
+
+	static void Deliver(HandlerList const& handlers, Entry& entry)
+	{
+		// String offsets become pointers again, in place since the entry is delivered only once
+		size_t* arguments = entry.GetArguments();
+		char* text = entry.GetText();
+		for (uint32_t i = 0; i < entry.argumentCount; i++)
+		{
+			if (entry.stringMask & (1ull << i))
+			{
+				arguments[i] = reinterpret_cast<size_t>(text + arguments[i]);
+			}
+		}
+
+		// Handlers may read p1 and p2 even when the format consumed fewer words
+		size_t padded[2]{};
+		memcpy(padded, arguments, std::min<size_t>(entry.argumentCount, 2) * sizeof(size_t));
+		Deliver(handlers, entry.level, entry.category, text, padded[0], padded[1], entry.argumentCount > 2 ? arguments + 2 : nullptr);
+		entry.spill.reset();
+	}
+
+	void ReportDrops(HandlerList const& handlers)
+	{
+		uint64_t dropped = m_dropped.load(std::memory_order_relaxed);
+		if (dropped == m_reportedDrops)
+		{
+			return;
+		}
+
+		Deliver(handlers, ML_LOG_LEVEL_WARNING, ML_LOG_CATEGORY_GENERAL, "[AsyncLog] Log queue full, %zu messages dropped\n", (size_t)(dropped - m_reportedDrops), 0, nullptr);
+		m_reportedDrops = dropped;
+	}
+
+	void Run()
+	{
+		Entry entry;
+		for (;;)
+		{
+			std::shared_ptr<const HandlerList> handlers = std::atomic_load(&m_handlers);
+
+			bool any = false;
+			while (TryDequeue(entry))
+			{
+				Deliver(*handlers, entry);
+				m_dispatched.fetch_add(1, std::memory_order_release);
+				any = true;
+			}
+
+			if (any)
+			{
+				ReportDrops(*handlers);
+
+				// Passing through the mutex orders this notify after a Flush that is about to wait
+				{
+					std::lock_guard lock(m_wakeMutex);
+				}
+				m_flushed.notify_all();
+				continue;
+			}
+
+			std::unique_lock lock(m_wakeMutex);
+			if (m_stop)
+			{
+				m_flushed.notify_all();
+				return;
+			}
+
+			// Producers only notify while m_sleeping is set. The fence pairs with the one in Write, so a
+			// message written while the flag went up is either seen here or followed by a notify.
+			m_sleeping.store(true, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			m_wake.wait(lock, [&] { return m_stop || HasPending(); });
+			m_sleeping.store(false, std::memory_order_relaxed);
+		}
+	}
+};
@@ -0,0 +1,167 @@
+#pragma once
+
+// Single hook site for criFsLoader_Load/GetStatus/Stop (ForcesModLoader.h addresses), shared by
+// CriLoadTelemetry and CriReadAhead so each CRI load is detoured and resolved through
+// criFsBinder_Find once, however many of them are installed.
+//
+// Observers see every load as it is issued and how it ended. Servers may fill the caller's buffer
+// instead of CRI, the first one that does wins and the loader then reports COMPLETE from
+// criFsLoader_GetStatus until it is reused or stopped. Served loads still reach the observers.
+//
+// Register during Init, before the game starts loading. Requires Helpers.h and Detours, like any
+// other hook. Include it from one translation unit only.
+
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+#include "ForcesModLoader.h"
+
+namespace CriLoadHooks
+{
+
+struct Load
+{
+	CriFsLoaderHn loader;
+	CriFsBinderHn binder;
+	const CriChar8* path;
+	CriSint64 offset;
+	CriSint64 loadSize;
+	void* buffer;
+	CriSint64 bufferSize;
+	const CriFsBinderFileInfo* file;	// nullptr if criFsBinder_Find didn't resolve the path, only valid during the call
+};
+
+enum class LoadEnd
+{
+	Complete,
+	Error,
+	Stopped,
+};
+
+typedef void LoadObserver(Load const& load);
+typedef void LoadEndObserver(CriFsLoaderHn loader, LoadEnd end);
+typedef bool LoadServer(Load const& load);		// True if the buffer was filled
+
+inline std::vector<LoadObserver*> g_loadObservers;
+inline std::vector<LoadEndObserver*> g_endObservers;
+inline std::vector<LoadServer*> g_servers;
+inline std::mutex g_servedMutex;
+inline std::unordered_set<CriFsLoaderHn> g_served;
+
+inline bool IsServed(CriFsLoaderHn loader)
+{
+	std::lock_guard lock(g_servedMutex);
+	return g_served.count(loader) != 0;
+}
+
+inline void SetServed(CriFsLoaderHn loader, bool served)
+{
+	std::lock_guard lock(g_servedMutex);
+	if (served)
+	{
+		g_served.insert(loader);
+	}
+	else
+	{
+		g_served.erase(loader);
+	}
+}
+
+inline void NotifyEnd(CriFsLoaderHn loader, LoadEnd end)
+{
+	for (LoadEndObserver* observer : g_endObservers)
+	{
+		observer(loader, end);
+	}
+}
+
+HOOK(__int64, __fastcall, CriFsLoaderLoadShared, criFsLoader_Load, CriFsLoaderHn loader, CriFsBinderHn binder, const CriChar8* path, CriSint64 offset, CriSint64 load_size, void* buffer, CriSint64 buffer_size)
+{
+	SetServed(loader, false);
+
+	CriFsBinderFileInfo info{};
+	CriBool exist = false;
+	bool found = binder && path && criFsBinder_Find(binder, path, &info, &exist) == 0 && exist;
+
+	Load load{ loader, binder, path, offset, load_size, buffer, buffer_size, found ? &info : nullptr };
+	for (LoadObserver* observer : g_loadObservers)
+	{
+		observer(load);
+	}
+
+	for (LoadServer* server : g_servers)
+	{
+		if (server(load))
+		{
+			SetServed(loader, true);
+			return 0;
+		}
+	}
+
+	return originalCriFsLoaderLoadShared(loader, binder, path, offset, load_size, buffer, buffer_size);
+}
+
+HOOK(__int64, __fastcall, CriFsLoaderGetStatusShared, criFsLoader_GetStatus, CriFsLoaderHn loader, CriFsLoaderStatus* status)
+{
+	if (status && IsServed(loader))
+	{
+		*status = CRIFSLOADER_STATUS_COMPLETE;
+		NotifyEnd(loader, LoadEnd::Complete);
+		return 0;
+	}
+
+	__int64 result = originalCriFsLoaderGetStatusShared(loader, status);
+	if (status && *status == CRIFSLOADER_STATUS_COMPLETE)
+	{
+		NotifyEnd(loader, LoadEnd::Complete);
+	}
+	else if (status && *status == CRIFSLOADER_STATUS_ERROR)
+	{
+		NotifyEnd(loader, LoadEnd::Error);
+	}
+
+	return result;
+}
+
+HOOK(__int64, __fastcall, CriFsLoaderStopShared, criFsLoader_Stop, CriFsLoaderHn loader)
+{
+	NotifyEnd(loader, LoadEnd::Stopped);
+	SetServed(loader, false);
+	return originalCriFsLoaderStopShared(loader);
+}
+
+// Hooks are installed with the first registration
+inline void Install()
+{
+	static bool installed = false;
+	if (installed)
+	{
+		return;
+	}
+
+	INSTALL_HOOK(CriFsLoaderLoadShared);
+	INSTALL_HOOK(CriFsLoaderGetStatusShared);
+	INSTALL_HOOK(CriFsLoaderStopShared);
+	installed = true;
+}
+
+inline void AddLoadObserver(LoadObserver* observer)
+{
+	g_loadObservers.push_back(observer);
+	Install();
+}
+
+inline void AddLoadEndObserver(LoadEndObserver* observer)
+{
+	g_endObservers.push_back(observer);
+	Install();
+}
+
+inline void AddServer(LoadServer* server)
+{
+	g_servers.push_back(server);
+	Install();
+}
+
+} // namespace CriLoadHooks
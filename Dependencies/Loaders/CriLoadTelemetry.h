@@ -0,0 +1,138 @@
+#pragma once
+
+// Times every CRI file load of the game into a CriLoadTrace, through the CriLoadHooks hook site.
+// Each load records the file criFsBinder_Find resolved its path to, and completes the first time
+// criFsLoader_GetStatus reports COMPLETE or ERROR, or on criFsLoader_Stop. Loads served by
+// CriReadAhead are recorded too.
+// Loads are grouped by stage, set it when a loading screen starts to get per-stage histograms.
+//
+//   CriLoadTelemetry::Install("cri_loads.bin");
+//   CriLoadTelemetry::SetStage("w1r03");
+//   ...
+//   CriLoadTelemetry::GetTrace().FormatHistograms();	// Log under ML_LOG_CATEGORY_CRIWARE
+//
+// Requires Helpers.h and Detours, like any other hook. Include it from one translation unit only.
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "CriLoadHooks.h"
+#include "CriLoadTrace.h"
+
+namespace CriLoadTelemetry
+{
+
+struct PendingLoad
+{
+	std::string path;
+	CriTrace::TraceLoadRecord record;
+};
+
+inline CriTrace::TraceWriter g_trace;
+inline std::mutex g_pendingMutex;
+inline std::unordered_map<CriFsLoaderHn, PendingLoad> g_pending;
+
+inline CriTrace::TraceWriter& GetTrace()
+{
+	return g_trace;
+}
+
+inline void SetStage(const char* stage)
+{
+	g_trace.SetStage(stage);
+}
+
+// Binder ids of mod directories, so their loads can be told apart from packed ones
+inline void MarkModBinder(CriFsBindId id)
+{
+	g_trace.MarkModBinder(id);
+}
+
+inline void CompleteLoad(CriFsLoaderHn loader, CriTrace::LoadStatus status)
+{
+	uint64_t now = g_trace.Now();
+
+	PendingLoad load;
+	{
+		std::lock_guard lock(g_pendingMutex);
+		auto it = g_pending.find(loader);
+		if (it == g_pending.end())
+		{
+			return;
+		}
+
+		load = std::move(it->second);
+		g_pending.erase(it);
+	}
+
+	load.record.completeTime = now;
+	load.record.status = (uint32_t)status;
+	g_trace.Write(load.path, load.record);
+}
+
+inline void OnLoad(CriLoadHooks::Load const& load)
+{
+	PendingLoad pending{ load.path ? load.path : "" };
+	CriTrace::TraceLoadRecord& record = pending.record;
+	record = {};
+	record.offset = load.offset;
+	record.loadSize = load.loadSize;
+
+	if (load.file)
+	{
+		record.flags |= CriTrace::LoadFlags_Found;
+		record.binderId = load.file->binderid;
+		record.fileOffset = load.file->offset;
+		record.readSize = load.file->read_size;
+		record.extractSize = load.file->extract_size;
+
+		if (g_trace.IsModBinder(load.file->binderid))
+		{
+			record.flags |= CriTrace::LoadFlags_ModBinder;
+		}
+	}
+
+	record.issueTime = g_trace.Now();
+
+	// A loader runs one load at a time, a new one replaces whatever was never polled to completion
+	std::lock_guard lock(g_pendingMutex);
+	g_pending[load.loader] = std::move(pending);
+}
+
+inline void OnLoadEnd(CriFsLoaderHn loader, CriLoadHooks::LoadEnd end)
+{
+	switch (end)
+	{
+	case CriLoadHooks::LoadEnd::Complete:
+		CompleteLoad(loader, CriTrace::LoadStatus::Complete);
+		break;
+	case CriLoadHooks::LoadEnd::Error:
+		CompleteLoad(loader, CriTrace::LoadStatus::Error);
+		break;
+	case CriLoadHooks::LoadEnd::Stopped:
+		CompleteLoad(loader, CriTrace::LoadStatus::Stopped);
+		break;
+	}
+}
+
+// tracePath may be null to only collect histograms
+inline void Install(const char* tracePath)
+{
+	static bool installed = false;
+	if (installed)
+	{
+		return;
+	}
+
+	if (tracePath)
+	{
+		g_trace.Open(tracePath);
+	}
+
+	CriLoadHooks::AddLoadObserver(OnLoad);
+	CriLoadHooks::AddLoadEndObserver(OnLoadEnd);
+	installed = true;
+}
+
+} // namespace CriLoadTelemetry
@@ -0,0 +1,359 @@
+#pragma once
+
+// Binary trace of CRI file loads and per-stage latency histograms.
+// One record per criFsLoader_Load, from issue to CRIFSLOADER_STATUS_COMPLETE (or error / stop),
+// carrying the CriFsBinderFileInfo the path resolved to. Paths and stage names are interned and
+// written once. The format is plain little-endian structs so tools can read it on any platform:
+//
+//   TraceHeader
+//   { uint8_t tag; payload }...
+//     TraceTag::String		uint32_t id, uint32_t length, char[length]
+//     TraceTag::Load		TraceLoadRecord
+//
+// Writing is buffered, a record costs a mutex and a memcpy.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace CriTrace
+{
+
+constexpr uint32_t c_magic = 0x54495243; // "CRIT"
+constexpr uint32_t c_version = 1;
+constexpr size_t c_histogramBuckets = 32;	// Bucket i counts loads taking [2^i, 2^(i+1)) microseconds
+
+enum class TraceTag : uint8_t
+{
+	String = 1,
+	Load = 2,
+};
+
+enum class LoadStatus : uint32_t
+{
+	Complete,
+	Error,
+	Stopped,
+};
+
+enum LoadFlags : uint32_t
+{
+	LoadFlags_None = 0,
+	LoadFlags_Found = 1 << 0,		// criFsBinder_Find resolved the path, file info fields are valid
+	LoadFlags_ModBinder = 1 << 1,	// Resolved through a binder registered with MarkModBinder
+};
+
+#pragma pack(push, 1)
+struct TraceHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t startTime;			// System clock, nanoseconds since the epoch
+};
+
+struct TraceLoadRecord
+{
+	uint64_t issueTime;			// Nanoseconds since the trace started
+	uint64_t completeTime;
+	uint32_t pathId;
+	uint32_t stageId;
+	uint32_t binderId;			// CriFsBinderFileInfo::binderid
+	uint32_t flags;				// LoadFlags
+	uint32_t status;			// LoadStatus
+	int64_t offset;				// Requested offset within the file
+	int64_t loadSize;			// Requested size
+	int64_t fileOffset;			// CriFsBinderFileInfo::offset, position within the bound archive or file
+	int64_t readSize;			// CriFsBinderFileInfo::read_size
+	int64_t extractSize;		// CriFsBinderFileInfo::extract_size
+};
+#pragma pack(pop)
+
+struct Histogram
+{
+	uint64_t buckets[c_histogramBuckets]{};
+	uint64_t count{};
+	uint64_t totalMicroseconds{};
+	uint64_t maxMicroseconds{};
+
+	void Add(uint64_t microseconds)
+	{
+		size_t bucket = 0;
+		while (bucket + 1 < c_histogramBuckets && (microseconds >> (bucket + 1)))
+		{
+			bucket++;
+		}
+
+		buckets[bucket]++;
+		count++;
+		totalMicroseconds += microseconds;
+		maxMicroseconds = std::max<uint64_t>(maxMicroseconds, microseconds);
+	}
+
+	// Upper bound of the bucket holding the given percentile
+	uint64_t GetPercentileMicroseconds(double percentile) const
+	{
+		uint64_t target = (uint64_t)(count * percentile / 100.0);
+		uint64_t seen = 0;
+		for (size_t i = 0; i < c_histogramBuckets; i++)
+		{
+			seen += buckets[i];
+			if (seen > target)
+			{
+				return (uint64_t)2 << i;
+			}
+		}
+		return maxMicroseconds;
+	}
+};
+
+class TraceWriter
+{
+public:
+	~TraceWriter()
+	{
+		Close();
+	}
+
+	bool Open(const char* path)
+	{
+		std::lock_guard lock(m_mutex);
+		if (m_file)
+		{
+			return true;
+		}
+
+		m_file = fopen(path, "wb");
+		if (!m_file)
+		{
+			return false;
+		}
+
+		m_buffer.reserve(c_bufferSize);
+		m_start = std::chrono::steady_clock::now();
+
+		TraceHeader header{ c_magic, c_version, (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count() };
+		Append(&header, sizeof(header));
+
+		// Stages set and loads recorded before opening were interned without a file to go to
+		std::vector<std::pair<uint32_t, std::string_view>> strings;
+		strings.reserve(m_strings.size());
+		for (auto const& [value, id] : m_strings)
+		{
+			strings.emplace_back(id, value);
+		}
+
+		std::sort(strings.begin(), strings.end());
+		for (auto const& [id, value] : strings)
+		{
+			AppendString(id, value);
+		}
+
+		return true;
+	}
+
+	void Close()
+	{
+		std::lock_guard lock(m_mutex);
+		if (!m_file)
+		{
+			return;
+		}
+
+		FlushBuffer();
+		fclose(m_file);
+		m_file = nullptr;
+	}
+
+	void Flush()
+	{
+		std::lock_guard lock(m_mutex);
+		if (m_file)
+		{
+			FlushBuffer();
+			fflush(m_file);
+		}
+	}
+
+	uint64_t Now() const
+	{
+		return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start).count();
+	}
+
+	void SetStage(std::string_view stage)
+	{
+		std::lock_guard lock(m_mutex);
+		m_stageId = Intern(stage);
+		m_stageNames.try_emplace(m_stageId, stage);
+	}
+
+	void MarkModBinder(uint32_t binderId)
+	{
+		std::lock_guard lock(m_mutex);
+		m_modBinders.insert(binderId);
+	}
+
+	bool IsModBinder(uint32_t binderId) const
+	{
+		std::lock_guard lock(m_mutex);
+		return m_modBinders.count(binderId) != 0;
+	}
+
+	// record.pathId and record.stageId are filled in here
+	void Write(std::string_view path, TraceLoadRecord record)
+	{
+		std::lock_guard lock(m_mutex);
+		record.pathId = Intern(path);
+		record.stageId = m_stageId;
+
+		uint64_t microseconds = (record.completeTime - record.issueTime) / 1000;
+		m_histograms[record.stageId].Add(microseconds);
+
+		if (m_file)
+		{
+			TraceTag tag = TraceTag::Load;
+			Append(&tag, sizeof(tag));
+			Append(&record, sizeof(record));
+		}
+	}
+
+	// Per stage summary of everything recorded so far
+	std::string FormatHistograms() const
+	{
+		std::lock_guard lock(m_mutex);
+		std::string report;
+		char line[256];
+		for (auto const& [stageId, histogram] : m_histograms)
+		{
+			auto name = m_stageNames.find(stageId);
+			snprintf(line, sizeof(line), "[CriLoadTrace] %s: %llu loads, mean %.2f ms, p50 < %.2f ms, p95 < %.2f ms, max %.2f ms\n",
+				name != m_stageNames.end() ? name->second.c_str() : "(no stage)", (unsigned long long)histogram.count,
+				histogram.count ? histogram.totalMicroseconds / 1000.0 / histogram.count : 0.0,
+				histogram.GetPercentileMicroseconds(50) / 1000.0, histogram.GetPercentileMicroseconds(95) / 1000.0, histogram.maxMicroseconds / 1000.0);
+			report += line;
+		}
+		return report;
+	}
+
+private:
+	static constexpr size_t c_bufferSize = 64 * 1024;
+
+	mutable std::mutex m_mutex;
+	FILE* m_file{};
+	std::vector<uint8_t> m_buffer;
+	std::chrono::steady_clock::time_point m_start{ std::chrono::steady_clock::now() };
+	std::unordered_map<std::string, uint32_t> m_strings;
+	std::unordered_map<uint32_t, std::string> m_stageNames;
+	std::unordered_map<uint32_t, Histogram> m_histograms;
+	std::unordered_set<uint32_t> m_modBinders;
+	uint32_t m_stageId{ UINT32_MAX };
+
+	void Append(const void* data, size_t size)
+	{
+		if (m_buffer.size() + size > c_bufferSize)
+		{
+			FlushBuffer();
+		}
+
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		m_buffer.insert(m_buffer.end(), bytes, bytes + size);
+	}
+
+	void FlushBuffer()
+	{
+		if (!m_buffer.empty())
+		{
+			fwrite(m_buffer.data(), 1, m_buffer.size(), m_file);
+			m_buffer.clear();
+		}
+	}
+
+	uint32_t Intern(std::string_view value)
+	{
+		auto [it, inserted] = m_strings.try_emplace(std::string(value), (uint32_t)m_strings.size());
+		if (inserted && m_file)
+		{
+			AppendString(it->second, value);
+		}
+		return it->second;
+	}
+
+	void AppendString(uint32_t id, std::string_view value)
+	{
+		TraceTag tag = TraceTag::String;
+		uint32_t length = (uint32_t)value.size();
+		Append(&tag, sizeof(tag));
+		Append(&id, sizeof(id));
+		Append(&length, sizeof(length));
+		Append(value.data(), value.size());
+	}
+};
+
+// Reads a whole trace, for offline tools
+struct Trace
+{
+	TraceHeader header{};
+	std::unordered_map<uint32_t, std::string> strings;
+	std::vector<TraceLoadRecord> loads;
+
+	bool Read(const char* path)
+	{
+		FILE* file = fopen(path, "rb");
+		if (!file)
+		{
+			return false;
+		}
+
+		bool success = fread(&header, sizeof(header), 1, file) == 1 && header.magic == c_magic && header.version == c_version;
+		while (success)
+		{
+			TraceTag tag;
+			if (fread(&tag, sizeof(tag), 1, file) != 1)
+			{
+				break;
+			}
+
+			if (tag == TraceTag::String)
+			{
+				uint32_t id, length;
+				success = fread(&id, sizeof(id), 1, file) == 1 && fread(&length, sizeof(length), 1, file) == 1;
+				std::string value(success ? length : 0, '\0');
+				success = success && (length == 0 || fread(value.data(), length, 1, file) == 1);
+				strings[id] = std::move(value);
+			}
+			else if (tag == TraceTag::Load)
+			{
+				TraceLoadRecord record;
+				success = fread(&record, sizeof(record), 1, file) == 1;
+				if (success)
+				{
+					loads.push_back(record);
+				}
+			}
+			else
+			{
+				success = false;
+			}
+		}
+
+		fclose(file);
+		return success;
+	}
+
+	std::string const& GetString(uint32_t id) const
+	{
+		static const std::string empty;
+		auto it = strings.find(id);
+		return it != strings.end() ? it->second : empty;
+	}
+};
+
+} // namespace CriTrace
@@ -0,0 +1,71 @@
+#pragma once
+
+// Serves criFsLoader_Load from a ReadAheadCache, through the CriLoadHooks hook site.
+// Only loads bound to a loose file on disk are learned and prefetched: criFsBinder_Find reports
+// an absolute path for those and the data is stored uncompressed. Packed loads are decompressed
+// by CRI and always go through the loader. A load served from the cache never starts the loader.
+//
+//   CriReadAhead::Install("mods\\ReadAhead");
+//   CriReadAhead::BeginStage("w1r03");	// Loading screen starts
+//   CriReadAhead::EndStage();			// Loading screen ends
+//
+// Requires Helpers.h and Detours, like any other hook. Include it from one translation unit only.
+
+#include <algorithm>
+#include <memory>
+
+#include "CriLoadHooks.h"
+#include "ReadAheadCache.h"
+
+namespace CriReadAhead
+{
+
+inline std::unique_ptr<ReadAheadCache> g_cache;
+
+inline void BeginStage(const char* stage)
+{
+	if (g_cache)
+	{
+		g_cache->BeginStage(stage);
+	}
+}
+
+inline void EndStage()
+{
+	if (g_cache)
+	{
+		g_cache->EndStage();
+	}
+}
+
+inline bool IsLooseFile(const char* path)
+{
+	return path && (path[0] == '\\' || path[0] == '/' || (path[0] && path[1] == ':'));
+}
+
+inline bool Serve(CriLoadHooks::Load const& load)
+{
+	const CriFsBinderFileInfo* info = load.file;
+	if (!info || load.offset < 0 || info->read_size != info->extract_size || !IsLooseFile(info->path) || load.offset >= info->read_size)
+	{
+		return false;
+	}
+
+	CriSint64 size = std::min<CriSint64>(load.loadSize, info->read_size - load.offset);
+	return size > 0 && load.bufferSize >= size && g_cache->Take(info->path, (uint64_t)(info->offset + load.offset), (uint64_t)size, load.buffer, (size_t)load.bufferSize);
+}
+
+// directory holds the learned per-stage sequences
+inline void Install(const char* directory, size_t budget = ReadAheadCache::c_defaultBudget)
+{
+	if (g_cache)
+	{
+		return;
+	}
+
+	g_cache = std::make_unique<ReadAheadCache>(directory, budget);
+
+	CriLoadHooks::AddServer(Serve);
+}
+
+} // namespace CriReadAhead
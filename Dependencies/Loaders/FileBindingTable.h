@@ -0,0 +1,432 @@
+#pragma once
+
+// Immutable lookup over BindFile / BindDirectory(Ex) bindings.
+// Bindings are collected during Init, then compiled once: paths are lowercased and separator
+// normalized, the winner of every conflict is decided by priority up front, and directory
+// bindings are expanded into per-file entries from what's on disk. Resolving a game path that
+// existed at compile time is then a single hash probe without allocating.
+//
+// Paths without an entry go through a directory trie whose nodes list every directory binding
+// covering them, best first. Each is tried in turn and the first that holds the file on disk wins,
+// so files created after compiling are still found and a directory lacking the file falls through
+// to the next one. Misses cost one stat per covering directory.
+//
+// Compile(false) skips the expansion. Every lookup then walks the trie, and directories ranked
+// above an exact file binding are checked on disk first.
+//
+// Higher priority wins. On equal priority a file binding beats a directory, a deeper directory
+// beats its ancestors, and otherwise the binding added first wins.
+// Requires Dependencies\xxHash in the include path.
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#define XXH_INLINE_ALL
+#include <xxhash.h>
+
+class FileBindingTable
+{
+public:
+	class Builder
+	{
+	public:
+		// path is the game path, destination the file on disk
+		void BindFile(std::string_view path, std::string_view destination, int priority)
+		{
+			m_files.push_back({ Normalize(path), std::string(destination), priority });
+		}
+
+		void BindDirectory(std::string_view path, std::string_view destination, int priority)
+		{
+			m_directories.push_back({ Normalize(path), std::string(destination), priority });
+		}
+
+		std::shared_ptr<const FileBindingTable> Compile(bool expandDirectories = true) const
+		{
+			std::shared_ptr<FileBindingTable> table(new FileBindingTable());
+			table->m_expanded = expandDirectories;
+
+			for (Binding const& binding : m_files)
+			{
+				table->AddFile(binding.path, binding.destination, binding.priority);
+			}
+
+			for (uint32_t i = 0; i < m_directories.size(); i++)
+			{
+				table->AddDirectory(m_directories[i].path, m_directories[i].destination, m_directories[i].priority, i);
+			}
+
+			if (expandDirectories)
+			{
+				// Expanded entries keep the first of equal priorities, so deeper directories go first
+				std::vector<Directory const*> order;
+				for (std::unique_ptr<Directory> const& directory : table->m_directories)
+				{
+					order.push_back(directory.get());
+				}
+				std::stable_sort(order.begin(), order.end(), [](Directory const* a, Directory const* b) { return a->depth > b->depth; });
+
+				for (Directory const* directory : order)
+				{
+					std::error_code ec;
+					for (std::filesystem::recursive_directory_iterator it(directory->destination, ec), end; !ec && it != end; it.increment(ec))
+					{
+						if (it->is_directory(ec))
+						{
+							continue;
+						}
+
+						std::string relative = it->path().lexically_relative(directory->destination).string();
+						std::string path = directory->path.empty() ? Normalize(relative) : directory->path + '\\' + Normalize(relative);
+						table->AddFile(path, it->path().string(), directory->priority);
+					}
+				}
+			}
+
+			table->PropagateDirectories(0, {});
+			return table;
+		}
+
+	private:
+		struct Binding
+		{
+			std::string path;
+			std::string destination;
+			int priority;
+		};
+
+		std::vector<Binding> m_files;
+		std::vector<Binding> m_directories;
+	};
+
+	// Destination of an exactly bound or expanded file, nullptr if there's none. Never allocates.
+	const char* FindFile(std::string_view path) const
+	{
+		char buffer[c_bufferSize];
+		const File* file = path.size() > sizeof(buffer) ? Find(Normalize(path)) : Find(std::string_view(buffer, Normalize(path, buffer)));
+		return file ? file->destination.c_str() : nullptr;
+	}
+
+	// Exact or expanded file first, then the directory bindings covering the path that hold it
+	bool Resolve(std::string_view path, std::string& destination) const
+	{
+		char buffer[c_bufferSize];
+		std::string large;
+		std::string_view normalized;
+		if (path.size() > sizeof(buffer))
+		{
+			large = Normalize(path);
+			normalized = large;
+		}
+		else
+		{
+			normalized = std::string_view(buffer, Normalize(path, buffer));
+		}
+
+		const File* file = Find(normalized);
+		if (file && m_expanded)
+		{
+			destination = file->destination;
+			return true;
+		}
+
+		uint32_t node = 0;
+		size_t start = 0;
+		while (start < normalized.size())
+		{
+			size_t separator = normalized.find('\\', start);
+			size_t end = separator == std::string_view::npos ? normalized.size() : separator;
+
+			uint32_t child = FindChild(node, normalized.substr(start, end - start));
+			if (child == c_none)
+			{
+				break;
+			}
+
+			node = child;
+			start = end + 1;
+		}
+
+		for (Directory const* directory : m_nodes[node].bindings)
+		{
+			if (file && directory->priority <= file->priority)
+			{
+				break;
+			}
+
+			// Bindings may come from an ancestor, the remainder is relative to that one
+			destination = directory->destination;
+			std::string_view remainder = normalized.substr(std::min<size_t>(directory->path.size() + (directory->path.empty() ? 0 : 1), normalized.size()));
+			if (!remainder.empty())
+			{
+				destination += c_separator;
+				for (char c : remainder)
+				{
+					destination += c == '\\' ? c_separator : c;
+				}
+			}
+
+			std::error_code ec;
+			if (std::filesystem::exists(destination, ec))
+			{
+				return true;
+			}
+		}
+
+		if (file)
+		{
+			destination = file->destination;
+			return true;
+		}
+
+		return false;
+	}
+
+	size_t GetFileCount() const
+	{
+		return m_files.size();
+	}
+
+	// Lowercase, '\' separators, no duplicate, leading or trailing separators, no leading ".\"
+	static std::string Normalize(std::string_view path)
+	{
+		std::string result(path.size(), '\0');
+		result.resize(Normalize(path, result.data()));
+		return result;
+	}
+
+private:
+	static constexpr uint32_t c_none = UINT32_MAX;
+	static constexpr size_t c_bufferSize = 512;
+	static constexpr char c_separator = (char)std::filesystem::path::preferred_separator;
+
+	struct File
+	{
+		std::string path;
+		std::string destination;
+		int priority;
+		uint32_t next = c_none;		// Next file with the same path hash
+	};
+
+	struct Directory
+	{
+		std::string path;
+		std::string destination;
+		int priority;
+		uint32_t depth;		// Path components
+		uint32_t order;		// Position among the directory bindings
+	};
+
+	struct IdentityHash
+	{
+		size_t operator()(uint64_t value) const { return (size_t)value; }
+	};
+
+	struct Node
+	{
+		std::string name;
+		uint32_t next = c_none;		// Next sibling with the same name hash
+		std::unordered_map<uint64_t, uint32_t, IdentityHash> children;
+		std::vector<const Directory*> bindings;		// This node's and all of its ancestors', best first
+	};
+
+	std::unordered_map<uint64_t, uint32_t, IdentityHash> m_index;
+	std::vector<File> m_files;
+	std::vector<std::unique_ptr<Directory>> m_directories;
+	std::vector<Node> m_nodes{ Node() };
+	bool m_expanded{};
+
+	FileBindingTable() = default;
+
+	// Writes at most path.size() characters to output and returns the length
+	static size_t Normalize(std::string_view path, char* output)
+	{
+		size_t length = 0;
+		size_t i = 0;
+		if (path.size() >= 2 && path[0] == '.' && (path[1] == '\\' || path[1] == '/'))
+		{
+			i = 2;
+		}
+
+		for (; i < path.size(); i++)
+		{
+			char c = path[i];
+			if (c == '/' || c == '\\')
+			{
+				if (length && output[length - 1] != '\\')
+				{
+					output[length++] = '\\';
+				}
+				continue;
+			}
+
+			output[length++] = (char)std::tolower((unsigned char)c);
+		}
+
+		if (length && output[length - 1] == '\\')
+		{
+			length--;
+		}
+
+		return length;
+	}
+
+	static uint64_t Hash(std::string_view value)
+	{
+		return XXH3_64bits(value.data(), value.size());
+	}
+
+	static bool IsBetter(Directory const* a, Directory const* b)
+	{
+		if (a->priority != b->priority)
+		{
+			return a->priority > b->priority;
+		}
+		if (a->depth != b->depth)
+		{
+			return a->depth > b->depth;
+		}
+		return a->order < b->order;
+	}
+
+	const File* Find(std::string_view path) const
+	{
+		auto it = m_index.find(Hash(path));
+		if (it == m_index.end())
+		{
+			return nullptr;
+		}
+
+		for (uint32_t index = it->second; index != c_none; index = m_files[index].next)
+		{
+			if (m_files[index].path == path)
+			{
+				return &m_files[index];
+			}
+		}
+
+		return nullptr;
+	}
+
+	uint32_t FindChild(uint32_t node, std::string_view name) const
+	{
+		auto it = m_nodes[node].children.find(Hash(name));
+		if (it == m_nodes[node].children.end())
+		{
+			return c_none;
+		}
+
+		for (uint32_t child = it->second; child != c_none; child = m_nodes[child].next)
+		{
+			if (m_nodes[child].name == name)
+			{
+				return child;
+			}
+		}
+
+		return c_none;
+	}
+
+	void AddFile(std::string const& path, std::string const& destination, int priority)
+	{
+		auto [it, inserted] = m_index.emplace(Hash(path), (uint32_t)m_files.size());
+		if (inserted)
+		{
+			m_files.push_back({ path, destination, priority });
+			return;
+		}
+
+		// Paths whose hashes collide are chained, never dropped
+		uint32_t index = it->second;
+		while (m_files[index].path != path)
+		{
+			if (m_files[index].next == c_none)
+			{
+				m_files[index].next = (uint32_t)m_files.size();
+				m_files.push_back({ path, destination, priority });
+				return;
+			}
+
+			index = m_files[index].next;
+		}
+
+		File& file = m_files[index];
+		if (priority > file.priority)
+		{
+			file.destination = destination;
+			file.priority = priority;
+		}
+	}
+
+	void AddDirectory(std::string const& path, std::string const& destination, int priority, uint32_t order)
+	{
+		uint32_t node = 0;
+		uint32_t depth = 0;
+		size_t start = 0;
+		while (start < path.size())
+		{
+			size_t separator = path.find('\\', start);
+			size_t end = separator == std::string::npos ? path.size() : separator;
+			std::string_view name = std::string_view(path).substr(start, end - start);
+
+			uint32_t child = FindChild(node, name);
+			if (child == c_none)
+			{
+				child = (uint32_t)m_nodes.size();
+				auto [it, inserted] = m_nodes[node].children.emplace(Hash(name), child);
+				if (!inserted)
+				{
+					// Same name hash as a sibling, chain behind it
+					uint32_t sibling = it->second;
+					while (m_nodes[sibling].next != c_none)
+					{
+						sibling = m_nodes[sibling].next;
+					}
+					m_nodes[sibling].next = child;
+				}
+
+				m_nodes.emplace_back();
+				m_nodes.back().name = name;
+			}
+
+			node = child;
+			depth++;
+			start = end + 1;
+		}
+
+		m_directories.push_back(std::make_unique<Directory>(Directory{ path, destination, priority, depth, order }));
+		m_nodes[node].bindings.push_back(m_directories.back().get());
+	}
+
+	// Gives every node the bindings of its ancestors, so a lookup only needs the deepest matching node
+	void PropagateDirectories(uint32_t node, std::vector<const Directory*> const& inherited)
+	{
+		std::vector<const Directory*>& bindings = m_nodes[node].bindings;
+		bindings.insert(bindings.end(), inherited.begin(), inherited.end());
+		std::sort(bindings.begin(), bindings.end(), IsBetter);
+
+		std::vector<uint32_t> children;
+		for (auto const& [hash, child] : m_nodes[node].children)
+		{
+			for (uint32_t sibling = child; sibling != c_none; sibling = m_nodes[sibling].next)
+			{
+				children.push_back(sibling);
+			}
+		}
+
+		std::vector<const Directory*> current = m_nodes[node].bindings;
+		for (uint32_t child : children)
+		{
+			PropagateDirectories(child, current);
+		}
+	}
+};
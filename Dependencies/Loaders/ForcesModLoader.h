@@ -3,6 +3,12 @@
 #include <fstream>
 #include "MemAccess.h"
 
+// Define FORCES_FILE_EXISTENCE_CACHE to serve FileExists from Common::FileExistenceCache.
+// That pulls in Windows.h and needs Dependencies\xxHash in the include path.
+#ifdef FORCES_FILE_EXISTENCE_CACHE
+#include "../FileExistenceCache.h"
+#endif
+
 // From MemAccess
 // JMP (5 BYTES) (Relative 32-bit address)
 static inline BOOL WriteJump(void *writeaddress, void *funcaddress)
@@ -42,10 +48,15 @@ static inline BOOL WriteCall(void *writeaddress, void *funcaddress)
 
 static bool FileExists(const char *fileName)
 {
+#ifdef FORCES_FILE_EXISTENCE_CACHE
+    Common::FileMetadata metadata = Common::GetFileExistenceCache().GetMetadata(fileName);
+    return metadata.exists && !metadata.isDirectory;
+#else
     std::ifstream infile(fileName);
     bool result = infile.good();
     infile.close();
     return result;
+#endif
 }
 
 static const int ModLoaderVer = 1;
@@ -0,0 +1,222 @@
+#pragma once
+
+// Per-mod frame-time accounting for update handlers and OnFrame exports.
+// The loader registers one slot per mod and wraps each call in Measure, which costs two
+// steady_clock reads (QueryPerformanceCounter on MSVC) and an add. EndFrame turns what every mod
+// spent in the frame, all of its handlers together, into one sample. Statistics cover the last
+// c_windowSize frames a mod ran in and are only computed when queried.
+//
+//   FrameProfiler::Slot* slot = profiler.Register(mod);
+//   ...
+//   profiler.Measure(slot, [&] { handler(&update_info); });
+//   if (profiler.EndFrame())
+//       LOG("%s", profiler.FormatReport().c_str());
+//
+// ModLoaderAPI_t belongs to the loader and stays as it is. The loader exports the statistics as
+// FRAME_PROFILER_EXPORT_NAME instead, defined over its profiler in one translation unit with
+//
+//   FRAME_PROFILER_DEFINE_EXPORT(g_frameProfiler)
+//
+// Mods call GetModFrameStats, which resolves the export from the loader module like
+// GetModLoaderAPI does and returns false if the loader doesn't profile.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ModLoader.h"
+
+#define FRAME_PROFILER_EXPORT_NAME GetModFrameStats
+
+// Rolling per-frame update handler / OnFrame time of one mod
+struct ModFrameStats_t
+{
+	size_t SampleCount;
+	double MeanMilliseconds;
+	double P95Milliseconds;
+	double MaxMilliseconds;
+};
+
+typedef bool ML_API GetModFrameStats_t(const Mod_t* mod, ModFrameStats_t* stats);
+
+class FrameProfiler
+{
+public:
+	static constexpr size_t c_windowSize = 256;
+
+	struct Slot
+	{
+		const Mod_t* mod{};
+		std::atomic<uint64_t> count{ 0 };
+		std::atomic<uint32_t> samples[c_windowSize]{};		// Nanoseconds per frame
+		uint64_t frameNanoseconds{};		// Game thread only, spent so far this frame
+		bool ranThisFrame{};
+	};
+
+	// Returns the slot passed to Measure. Mods owning several handlers share one slot.
+	// Slots never move, so registering more mods while frames are measured is fine.
+	Slot* Register(const Mod_t* mod)
+	{
+		std::lock_guard lock(m_mutex);
+		auto it = m_slots.find(mod);
+		if (it != m_slots.end())
+		{
+			return &m_stats[it->second];
+		}
+
+		m_stats.emplace_back();
+		m_stats.back().mod = mod;
+		m_slots.emplace(mod, m_stats.size() - 1);
+		return &m_stats.back();
+	}
+
+	template<typename TCallback>
+	void Measure(Slot* slot, TCallback&& callback)
+	{
+		auto start = std::chrono::steady_clock::now();
+		callback();
+		auto elapsed = std::chrono::steady_clock::now() - start;
+
+		slot->frameNanoseconds += (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+		slot->ranThisFrame = true;
+	}
+
+	// Call once per frame after every handler ran, on the thread that measured. Records one sample
+	// per mod that ran. Returns true every reportInterval frames, the caller is expected to log
+	// FormatReport() then. 0 disables periodic reports.
+	bool EndFrame()
+	{
+		{
+			std::lock_guard lock(m_mutex);
+			for (Slot& slot : m_stats)
+			{
+				if (!slot.ranThisFrame)
+				{
+					continue;
+				}
+
+				uint64_t count = slot.count.load(std::memory_order_relaxed);
+				slot.samples[count % c_windowSize].store((uint32_t)std::min<uint64_t>(slot.frameNanoseconds, UINT32_MAX), std::memory_order_relaxed);
+				slot.count.store(count + 1, std::memory_order_release);
+				slot.frameNanoseconds = 0;
+				slot.ranThisFrame = false;
+			}
+		}
+
+		uint32_t interval = m_reportInterval.load(std::memory_order_relaxed);
+		return interval && ++m_frame % interval == 0;
+	}
+
+	void SetReportInterval(uint32_t frames)
+	{
+		m_reportInterval.store(frames, std::memory_order_relaxed);
+	}
+
+	// Safe from any thread. Samples written concurrently may mix two frames, which is fine for statistics.
+	bool GetStats(const Mod_t* mod, ModFrameStats_t& result) const
+	{
+		std::lock_guard lock(m_mutex);
+		auto it = m_slots.find(mod);
+		if (it == m_slots.end())
+		{
+			return false;
+		}
+
+		result = Compute(m_stats[it->second]);
+		return true;
+	}
+
+	// One line, slowest mods by mean first
+	std::string FormatReport(size_t maxMods = 5) const
+	{
+		std::vector<std::pair<const Mod_t*, ModFrameStats_t>> stats;
+		{
+			std::lock_guard lock(m_mutex);
+			for (Slot const& slot : m_stats)
+			{
+				ModFrameStats_t result = Compute(slot);
+				if (result.SampleCount)
+				{
+					stats.emplace_back(slot.mod, result);
+				}
+			}
+		}
+
+		std::sort(stats.begin(), stats.end(), [](auto const& a, auto const& b) { return a.second.MeanMilliseconds > b.second.MeanMilliseconds; });
+		stats.resize(std::min<size_t>(stats.size(), maxMods));
+
+		std::string report = "[FrameProfiler] mean/p95/max ms:";
+		for (auto const& [mod, result] : stats)
+		{
+			char buffer[256];
+			snprintf(buffer, sizeof(buffer), " %s %.3f/%.3f/%.3f;", mod && mod->Name ? mod->Name : "?", result.MeanMilliseconds, result.P95Milliseconds, result.MaxMilliseconds);
+			report += buffer;
+		}
+
+		return report;
+	}
+
+private:
+	mutable std::mutex m_mutex;
+	std::deque<Slot> m_stats;
+	std::unordered_map<const Mod_t*, size_t> m_slots;
+	std::atomic<uint32_t> m_reportInterval{ 0 };
+	uint64_t m_frame{ 0 };
+
+	static ModFrameStats_t Compute(Slot const& slot)
+	{
+		ModFrameStats_t result{};
+		size_t count = (size_t)std::min<uint64_t>(slot.count.load(std::memory_order_acquire), c_windowSize);
+		if (!count)
+		{
+			return result;
+		}
+
+		uint32_t samples[c_windowSize];
+		uint64_t sum = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			samples[i] = slot.samples[i].load(std::memory_order_relaxed);
+			sum += samples[i];
+		}
+
+		size_t p95 = std::min<size_t>(count - 1, count * 95 / 100);
+		std::nth_element(samples, samples + p95, samples + count);
+
+		result.SampleCount = count;
+		result.MeanMilliseconds = (double)sum / count / 1e6;
+		result.P95Milliseconds = samples[p95] / 1e6;
+		result.MaxMilliseconds = *std::max_element(samples + p95, samples + count) / 1e6;
+		return result;
+	}
+};
+
+#ifdef WIN32
+#ifdef MODLOADER_IMPLEMENTATION
+extern "C" __declspec(dllexport) bool ML_API FRAME_PROFILER_EXPORT_NAME(const Mod_t* mod, ModFrameStats_t* stats);
+
+#define FRAME_PROFILER_DEFINE_EXPORT(profiler) \
+	extern "C" __declspec(dllexport) bool ML_API FRAME_PROFILER_EXPORT_NAME(const Mod_t* mod, ModFrameStats_t* stats) \
+	{ \
+		return mod && stats && (profiler).GetStats(mod, *stats); \
+	}
+#else
+inline bool FRAME_PROFILER_EXPORT_NAME(const Mod_t* mod, ModFrameStats_t* stats)
+{
+	static GetModFrameStats_t* callback = []
+	{
+		HMODULE loader = GetModLoaderHModule();
+		return loader ? (GetModFrameStats_t*)GetProcAddress(loader, ML_XSTRINGIFY(FRAME_PROFILER_EXPORT_NAME)) : nullptr;
+	}();
+
+	return callback && callback(mod, stats);
+}
+#endif
+#endif
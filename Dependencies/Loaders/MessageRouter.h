@@ -0,0 +1,178 @@
+#pragma once
+
+// Dispatch table for BroadcastMessageImm.
+// Receivers are added in delivery order, then either subscribe to the message ids they handle
+// (MessageRouting::c_subscribe) or keep receiving everything. Build compiles that into one flat array
+// of receivers with a contiguous range per id, so a broadcast is one hash probe plus a walk
+// over exactly the receivers that care. Ids nobody subscribed to go to the catch-all receivers only.
+//
+// Build after Init (and again after a priority change or new subscriptions). Broadcast and
+// IsSubscribed only read the table and must not overlap a rebuild.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+// The subscribe protocol is ours, not part of the loader ABI in ModLoader.h, so its ids live in
+// a range of their own that can't collide with the ML_MSG_* ids.
+namespace MessageRouting
+{
+	constexpr size_t c_idRangeBegin = 0x4D520000;	// 'MR'
+	constexpr size_t c_idRangeEnd = 0x4D530000;
+
+	// Sent with SendMessageImm(c_subscribe, ...) during Init, once per message id the mod handles.
+	// Mods that never subscribe keep receiving every broadcast.
+	constexpr size_t c_subscribe = c_idRangeBegin + 1;
+
+	struct Subscribe_t
+	{
+		const void* mod{};		// ModInfo_t::CurrentMod
+		size_t id{};
+	};
+
+	constexpr bool IsRoutingMessage(size_t id)
+	{
+		return id >= c_idRangeBegin && id < c_idRangeEnd;
+	}
+}
+
+template<typename TReceiver>
+class MessageRouter
+{
+public:
+	void AddReceiver(TReceiver receiver)
+	{
+		m_receivers.push_back({ receiver, {}, false });
+	}
+
+	// Order of receivers changed, e.g. after SetPriority. Receivers keep their subscriptions.
+	template<typename TLess>
+	void SortReceivers(TLess&& less)
+	{
+		std::stable_sort(m_receivers.begin(), m_receivers.end(), [&](Receiver const& a, Receiver const& b) { return less(a.receiver, b.receiver); });
+	}
+
+	// Returns false for receivers that were never added
+	bool Subscribe(TReceiver receiver, size_t id)
+	{
+		for (Receiver& entry : m_receivers)
+		{
+			if (entry.receiver == receiver)
+			{
+				entry.subscribed = true;
+				if (std::find(entry.ids.begin(), entry.ids.end(), id) == entry.ids.end())
+				{
+					entry.ids.push_back(id);
+				}
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	void Build()
+	{
+		std::unordered_map<size_t, std::vector<TReceiver>> routes;
+		std::vector<TReceiver> catchAll;
+
+		// Every id anyone subscribed to gets a route, catch-all receivers are part of each of them
+		for (Receiver const& entry : m_receivers)
+		{
+			for (size_t id : entry.ids)
+			{
+				routes.emplace(id, std::vector<TReceiver>());
+			}
+		}
+
+		// Walking receivers in order keeps every route in delivery order
+		for (Receiver const& entry : m_receivers)
+		{
+			if (!entry.subscribed)
+			{
+				catchAll.push_back(entry.receiver);
+				for (auto& [id, receivers] : routes)
+				{
+					receivers.push_back(entry.receiver);
+				}
+			}
+			else
+			{
+				for (size_t id : entry.ids)
+				{
+					routes[id].push_back(entry.receiver);
+				}
+			}
+		}
+
+		m_table.clear();
+		m_ranges.clear();
+		m_ranges.reserve(routes.size());
+
+		m_catchAll = { 0, (uint32_t)catchAll.size() };
+		m_table.insert(m_table.end(), catchAll.begin(), catchAll.end());
+
+		for (auto const& [id, receivers] : routes)
+		{
+			m_ranges.emplace(id, Range{ (uint32_t)m_table.size(), (uint32_t)receivers.size() });
+			m_table.insert(m_table.end(), receivers.begin(), receivers.end());
+		}
+
+		// Same ranges sorted by receiver, so membership is a binary search instead of a scan
+		m_sorted = m_table;
+		std::sort(m_sorted.begin(), m_sorted.begin() + m_catchAll.count, std::less<TReceiver>());
+		for (auto const& [id, range] : m_ranges)
+		{
+			std::sort(m_sorted.begin() + range.offset, m_sorted.begin() + range.offset + range.count, std::less<TReceiver>());
+		}
+	}
+
+	template<typename TDeliver>
+	void Broadcast(size_t id, TDeliver&& deliver) const
+	{
+		Range range = GetRange(id);
+		const TReceiver* receiver = m_table.data() + range.offset;
+		for (uint32_t i = 0; i < range.count; i++)
+		{
+			deliver(receiver[i]);
+		}
+	}
+
+	// Whether a message would reach this receiver, for SendMessageImm to skip mods that didn't subscribe.
+	// Answers from the built table, one hash probe plus a binary search over that id's receivers.
+	bool IsSubscribed(TReceiver receiver, size_t id) const
+	{
+		Range range = GetRange(id);
+		const TReceiver* begin = m_sorted.data() + range.offset;
+		return std::binary_search(begin, begin + range.count, receiver, std::less<TReceiver>());
+	}
+
+private:
+	struct Receiver
+	{
+		TReceiver receiver;
+		std::vector<size_t> ids;
+		bool subscribed;
+	};
+
+	struct Range
+	{
+		uint32_t offset;
+		uint32_t count;
+	};
+
+	std::vector<Receiver> m_receivers;
+	std::vector<TReceiver> m_table;		// Delivery order
+	std::vector<TReceiver> m_sorted;	// Same ranges as m_table, each sorted
+	std::unordered_map<size_t, Range> m_ranges;
+	Range m_catchAll{};
+
+	Range GetRange(size_t id) const
+	{
+		auto it = m_ranges.find(id);
+		return it != m_ranges.end() ? it->second : m_catchAll;
+	}
+};
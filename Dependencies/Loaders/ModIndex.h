@@ -0,0 +1,214 @@
+#pragma once
+
+// Hash lookups over a ModList_t for every ML_PROPERTY_TYPE_*, answering the same queries as
+// ModLoaderAPI_t::FindMod / FindModEx without a linear scan and string compare per mod.
+// Build it once the mod list is final (e.g. in Init from ModInfo_t::ModList), it is read-only afterwards
+// and safe to query from any thread.
+//
+// FindModEx data per property type:
+//   ML_PROPERTY_TYPE_ID, ML_PROPERTY_TYPE_TITLE	const char*
+//   ML_PROPERTY_TYPE_HMODULE						the HMODULE itself
+//   ML_PROPERTY_TYPE_INDEX							the index itself, cast to a pointer
+//   ML_PROPERTY_TYPE_CALLER						any address inside the calling module
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#include "../Win32.h"
+
+#ifdef _WIN32
+#include <TlHelp32.h>
+#endif
+
+#include "ModLoader.h"
+
+class ModIndex
+{
+public:
+	// Mods keep the order of the list, earlier entries win on duplicate IDs or titles like a front-to-back scan would
+	void Build(ModList_t const& list)
+	{
+		m_mods.assign(list.begin(), list.end());
+		m_ids.clear();
+		m_titles.clear();
+		m_modules.clear();
+		m_ranges.clear();
+
+		m_ids.reserve(m_mods.size());
+		m_titles.reserve(m_mods.size());
+		for (const Mod_t* mod : m_mods)
+		{
+			// Mod_t strings live as long as the mod, views into them are safe
+			if (mod->ID)
+			{
+				m_ids.emplace(mod->ID, mod);
+			}
+
+			if (mod->Name)
+			{
+				m_titles.emplace(mod->Name, mod);
+			}
+		}
+	}
+
+#ifdef _WIN32
+	// Registers a module owned by mod for ML_PROPERTY_TYPE_HMODULE and ML_PROPERTY_TYPE_CALLER
+	void AddModule(const Mod_t* mod, HMODULE module)
+	{
+		if (!module || !m_modules.emplace(reinterpret_cast<uintptr_t>(module), mod).second)
+		{
+			return;
+		}
+
+		auto* dosHeader = reinterpret_cast<const IMAGE_DOS_HEADER*>(module);
+		auto* ntHeaders = reinterpret_cast<const IMAGE_NT_HEADERS*>(reinterpret_cast<const uint8_t*>(module) + dosHeader->e_lfanew);
+
+		Range range{ reinterpret_cast<uintptr_t>(module), reinterpret_cast<uintptr_t>(module) + ntHeaders->OptionalHeader.SizeOfImage, mod };
+		m_ranges.insert(std::upper_bound(m_ranges.begin(), m_ranges.end(), range.begin, [](uintptr_t address, Range const& r) { return address < r.begin; }), range);
+	}
+
+	// Assigns every loaded module to the mod whose folder contains it, the deepest folder wins if mods nest.
+	// Modules loaded later (LoadExternalModule, delay loads) need another call or AddModule.
+	void AddLoadedModules()
+	{
+		std::vector<std::pair<std::wstring, const Mod_t*>> folders;
+		for (const Mod_t* mod : m_mods)
+		{
+			if (!mod->Path)
+			{
+				continue;
+			}
+
+			// Path may name the mod's folder or its mod.ini. Folder names can contain dots ("Foo v1.2"),
+			// so ask the file system which one it is rather than looking for an extension.
+			std::error_code ec;
+			std::filesystem::path folder = std::filesystem::absolute(mod->Path, ec).lexically_normal();
+			if (!std::filesystem::is_directory(folder, ec))
+			{
+				folder = folder.parent_path();
+			}
+
+			std::wstring prefix = folder.wstring();
+			if (!prefix.empty() && prefix.back() != L'\\')
+			{
+				prefix += L'\\';
+			}
+			folders.emplace_back(std::move(prefix), mod);
+		}
+
+		HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPMODULE, GetCurrentProcessId());
+		if (snapshot == INVALID_HANDLE_VALUE)
+		{
+			return;
+		}
+
+		MODULEENTRY32W entry{ sizeof(MODULEENTRY32W) };
+		for (BOOL found = Module32FirstW(snapshot, &entry); found; found = Module32NextW(snapshot, &entry))
+		{
+			std::wstring modulePath = std::filesystem::path(entry.szExePath).lexically_normal().wstring();
+			const Mod_t* owner = nullptr;
+			size_t ownerLength = 0;
+			for (auto const& [prefix, mod] : folders)
+			{
+				if (prefix.size() > ownerLength && modulePath.size() > prefix.size() &&
+					CompareStringOrdinal(modulePath.data(), (int)prefix.size(), prefix.data(), (int)prefix.size(), TRUE) == CSTR_EQUAL)
+				{
+					owner = mod;
+					ownerLength = prefix.size();
+				}
+			}
+
+			if (owner)
+			{
+				AddModule(owner, entry.hModule);
+			}
+		}
+
+		CloseHandle(snapshot);
+	}
+#endif
+
+	const Mod_t* FindMod(const char* id) const
+	{
+		return Find(m_ids, id);
+	}
+
+	const Mod_t* FindModEx(const void* data, int propertyType) const
+	{
+		switch (propertyType)
+		{
+		case ML_PROPERTY_TYPE_ID:
+			return Find(m_ids, static_cast<const char*>(data));
+
+		case ML_PROPERTY_TYPE_TITLE:
+			return Find(m_titles, static_cast<const char*>(data));
+
+		case ML_PROPERTY_TYPE_HMODULE:
+		{
+			auto it = m_modules.find(reinterpret_cast<uintptr_t>(data));
+			return it != m_modules.end() ? it->second : nullptr;
+		}
+
+		case ML_PROPERTY_TYPE_INDEX:
+		{
+			size_t index = reinterpret_cast<size_t>(data);
+			return index < m_mods.size() ? m_mods[index] : nullptr;
+		}
+
+		case ML_PROPERTY_TYPE_CALLER:
+		{
+			// Ranges never overlap, the candidate is the last range starting at or below the address
+			uintptr_t address = reinterpret_cast<uintptr_t>(data);
+			auto it = std::upper_bound(m_ranges.begin(), m_ranges.end(), address, [](uintptr_t a, Range const& r) { return a < r.begin; });
+			if (it == m_ranges.begin())
+			{
+				return nullptr;
+			}
+
+			--it;
+			return address < it->end ? it->mod : nullptr;
+		}
+
+		default:
+			return nullptr;
+		}
+	}
+
+	size_t GetModCount() const
+	{
+		return m_mods.size();
+	}
+
+private:
+	struct Range
+	{
+		uintptr_t begin;
+		uintptr_t end;
+		const Mod_t* mod;
+	};
+
+	using NameMap = std::unordered_map<std::string_view, const Mod_t*>;
+
+	std::vector<const Mod_t*> m_mods;
+	NameMap m_ids;
+	NameMap m_titles;
+	std::unordered_map<uintptr_t, const Mod_t*> m_modules;
+	std::vector<Range> m_ranges;		// Sorted by begin
+
+	static const Mod_t* Find(NameMap const& map, const char* name)
+	{
+		if (!name)
+		{
+			return nullptr;
+		}
+
+		auto it = map.find(name);
+		return it != map.end() ? it->second : nullptr;
+	}
+};
@@ -0,0 +1,278 @@
+#pragma once
+
+// Learns which file ranges a stage loads, in order, and reads them ahead on the next visit.
+// Every stage keeps a sequence file (<directory>\<stage>.seq), rewritten with the order observed
+// during the last visit. BeginStage loads it and a background thread reads the ranges into memory
+// until the budget is full, each range Take consumes frees room for the next one. Ranges the game
+// asks for before they are read are skipped, the game reads those itself.
+//
+// On 32-bit builds the budget can't exceed the default, a large contiguous allocation can fail long
+// before memory runs out. Failed allocations stop read-ahead for the stage instead of throwing.
+
+#include <algorithm>
+#include <cctype>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class ReadAheadCache
+{
+public:
+	static constexpr size_t c_defaultBudget = sizeof(void*) == 4 ? 48 * 1024 * 1024 : 256 * 1024 * 1024;
+
+	struct Range
+	{
+		std::string path;		// File on disk
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	explicit ReadAheadCache(std::filesystem::path directory, size_t budget = c_defaultBudget)
+		: m_directory(std::move(directory)), m_budget(sizeof(void*) == 4 ? std::min<size_t>(budget, c_defaultBudget) : budget)
+	{
+		m_thread = std::thread(&ReadAheadCache::Run, this);
+	}
+
+	~ReadAheadCache()
+	{
+		EndStage();
+		{
+			std::lock_guard lock(m_mutex);
+			m_stop = true;
+		}
+		m_wake.notify_one();
+		m_thread.join();
+	}
+
+	ReadAheadCache(ReadAheadCache const&) = delete;
+	ReadAheadCache& operator=(ReadAheadCache const&) = delete;
+
+	// Saves what the previous stage loaded and starts reading ahead for this one
+	void BeginStage(std::string const& stage)
+	{
+		EndStage();
+
+		std::vector<Range> sequence = LoadSequence(GetSequencePath(stage));
+
+		std::lock_guard lock(m_mutex);
+		m_stage = stage;
+		m_queue.assign(sequence.begin(), sequence.end());
+		m_wake.notify_one();
+	}
+
+	// Drops the cache and persists the learned order, e.g. when the loading screen ends
+	void EndStage()
+	{
+		std::string stage;
+		std::vector<Range> learned;
+		{
+			std::lock_guard lock(m_mutex);
+			if (m_stage.empty())
+			{
+				return;
+			}
+
+			stage = std::move(m_stage);
+			learned = std::move(m_learned);
+			m_stage.clear();
+			m_learned.clear();
+			m_learnedKeys.clear();
+			m_queue.clear();
+			m_skipped.clear();
+			m_cache.clear();
+			m_used = 0;
+			m_generation++;
+		}
+		m_wake.notify_one();
+
+		if (!learned.empty())
+		{
+			SaveSequence(GetSequencePath(stage), learned);
+		}
+	}
+
+	// Copies a cached range into buffer and releases it. Returns false on a miss, the range is
+	// remembered for the stage's sequence either way.
+	bool Take(std::string const& path, uint64_t offset, uint64_t size, void* buffer, size_t bufferSize)
+	{
+		std::string key = MakeKey(path, offset, size);
+
+		std::lock_guard lock(m_mutex);
+		if (m_stage.empty())
+		{
+			return false;
+		}
+
+		if (m_learnedKeys.insert(key).second)
+		{
+			m_learned.push_back({ path, offset, size });
+		}
+
+		auto it = m_cache.find(key);
+		if (it == m_cache.end())
+		{
+			m_skipped.insert(std::move(key));
+			m_missCount++;
+			return false;
+		}
+
+		bool fits = size <= bufferSize;
+		if (fits)
+		{
+			memcpy(buffer, it->second.get(), (size_t)size);
+			m_hitCount++;
+		}
+
+		m_used -= (size_t)size;
+		m_cache.erase(it);
+		m_wake.notify_one();
+		return fits;
+	}
+
+	// Since construction, over all stages
+	uint64_t GetHitCount() const
+	{
+		std::lock_guard lock(m_mutex);
+		return m_hitCount;
+	}
+
+	uint64_t GetMissCount() const
+	{
+		std::lock_guard lock(m_mutex);
+		return m_missCount;
+	}
+
+private:
+	std::filesystem::path m_directory;
+	size_t m_budget;
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::string m_stage;
+	std::deque<Range> m_queue;
+	std::unordered_set<std::string> m_skipped;
+	std::unordered_map<std::string, std::unique_ptr<uint8_t[]>> m_cache;
+	size_t m_used{};
+	uint64_t m_generation{};
+	std::vector<Range> m_learned;
+	std::unordered_set<std::string> m_learnedKeys;
+	uint64_t m_hitCount{};
+	uint64_t m_missCount{};
+	bool m_stop{ false };
+	std::thread m_thread;
+
+	static std::string MakeKey(std::string const& path, uint64_t offset, uint64_t size)
+	{
+		return path + '|' + std::to_string(offset) + '|' + std::to_string(size);
+	}
+
+	std::filesystem::path GetSequencePath(std::string const& stage) const
+	{
+		std::string name = stage;
+		for (char& c : name)
+		{
+			if (!isalnum((unsigned char)c) && c != '_' && c != '-')
+			{
+				c = '_';
+			}
+		}
+		return m_directory / (name + ".seq");
+	}
+
+	// One range per line: offset, size, path
+	static std::vector<Range> LoadSequence(std::filesystem::path const& path)
+	{
+		std::vector<Range> sequence;
+		std::ifstream stream(path);
+		unsigned long long offset, size;
+		std::string file;
+		while (stream >> offset >> size && std::getline(stream >> std::ws, file))
+		{
+			sequence.push_back({ file, offset, size });
+		}
+		return sequence;
+	}
+
+	static void SaveSequence(std::filesystem::path const& path, std::vector<Range> const& sequence)
+	{
+		std::error_code ec;
+		std::filesystem::create_directories(path.parent_path(), ec);
+
+		std::ofstream stream(path, std::ios::trunc);
+		for (Range const& range : sequence)
+		{
+			stream << range.offset << ' ' << range.size << ' ' << range.path << '\n';
+		}
+	}
+
+	void Run()
+	{
+		std::unique_lock lock(m_mutex);
+		for (;;)
+		{
+			// Oversized ranges are popped right away to be dropped
+			m_wake.wait(lock, [&] { return m_stop || (!m_queue.empty() && (m_queue.front().size > m_budget || m_used + m_queue.front().size <= m_budget)); });
+			if (m_stop)
+			{
+				return;
+			}
+
+			Range range = std::move(m_queue.front());
+			m_queue.pop_front();
+
+			std::string key = MakeKey(range.path, range.offset, range.size);
+			if (range.size > m_budget || m_skipped.count(key) || m_cache.count(key))
+			{
+				continue;
+			}
+
+			// Reserve before reading so Take can't push usage over the budget meanwhile
+			m_used += (size_t)range.size;
+			uint64_t generation = m_generation;
+			lock.unlock();
+
+			std::unique_ptr<uint8_t[]> data(new (std::nothrow) uint8_t[(size_t)range.size]);
+			bool success = data && ReadRange(range, data.get());
+
+			lock.lock();
+			if (generation != m_generation)
+			{
+				continue;
+			}
+
+			if (!data)
+			{
+				m_queue.clear();
+			}
+
+			if (!success || m_skipped.count(key))
+			{
+				m_used -= (size_t)range.size;
+				continue;
+			}
+
+			m_cache.emplace(std::move(key), std::move(data));
+		}
+	}
+
+	static bool ReadRange(Range const& range, uint8_t* data)
+	{
+		std::ifstream stream(range.path, std::ios::binary);
+		stream.seekg((std::streamoff)range.offset);
+		stream.read(reinterpret_cast<char*>(data), (std::streamsize)range.size);
+		return (bool)stream;
+	}
+};
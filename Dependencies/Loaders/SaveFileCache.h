@@ -0,0 +1,342 @@
+#pragma once
+
+// In-memory image of a redirected save file (ModLoader::SetSaveFile).
+// The game's reads and writes go to the image, Commit hands a copy to a background thread which
+// writes it to a temporary file and atomically replaces the save, so saving never blocks a frame.
+// Writes committed while a flush is running are coalesced, only the newest image reaches the disk.
+// With compression enabled the file is stored as an lz4 frame. Loading detects the frame magic,
+// so compressed and plain saves are both read transparently.
+//
+// Requires Dependencies\lz4\include in the include path and liblz4_static.lib linked.
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "../Win32.h"
+
+#include <lz4frame.h>
+
+class SaveFileCache
+{
+public:
+	// readThrough is the game's own save, used until the redirected one exists (save_read_through)
+	explicit SaveFileCache(std::filesystem::path path, std::filesystem::path readThrough = {}, bool compress = false)
+		: m_path(std::move(path)), m_readThrough(std::move(readThrough)), m_compress(compress)
+	{
+		m_thread = std::thread(&SaveFileCache::Run, this);
+	}
+
+	// Writes out anything still pending.
+	// Don't let this run from DllMain, joining the thread there deadlocks on the loader lock.
+	~SaveFileCache()
+	{
+		{
+			std::lock_guard lock(m_mutex);
+			m_stop = true;
+		}
+		m_wake.notify_one();
+		m_thread.join();
+	}
+
+	SaveFileCache(SaveFileCache const&) = delete;
+	SaveFileCache& operator=(SaveFileCache const&) = delete;
+
+	// Reads the save into memory on first use, later calls are served from the image.
+	// Returns false if there is no save yet, the image is empty then.
+	bool Load()
+	{
+		std::lock_guard lock(m_imageMutex);
+		if (m_loaded)
+		{
+			return !m_image.empty();
+		}
+
+		m_loaded = true;
+		return ReadFile(m_path, m_image) || (!m_readThrough.empty() && ReadFile(m_readThrough, m_image));
+	}
+
+	size_t Read(size_t offset, void* buffer, size_t size)
+	{
+		Load();
+
+		std::lock_guard lock(m_imageMutex);
+		if (offset >= m_image.size())
+		{
+			return 0;
+		}
+
+		size = std::min<size_t>(size, m_image.size() - offset);
+		memcpy(buffer, m_image.data() + offset, size);
+		return size;
+	}
+
+	void Write(size_t offset, const void* data, size_t size)
+	{
+		Load();
+
+		std::lock_guard lock(m_imageMutex);
+		if (offset + size > m_image.size())
+		{
+			m_image.resize(offset + size);
+		}
+
+		memcpy(m_image.data() + offset, data, size);
+		m_modified = true;
+	}
+
+	void Resize(size_t size)
+	{
+		Load();
+
+		std::lock_guard lock(m_imageMutex);
+		if (size != m_image.size())
+		{
+			m_image.resize(size);
+			m_modified = true;
+		}
+	}
+
+	size_t GetSize()
+	{
+		Load();
+
+		std::lock_guard lock(m_imageMutex);
+		return m_image.size();
+	}
+
+	// Call when the game closes the save handle. Only copies the image, disk I/O happens in the background.
+	// Does nothing unless the image was written since the last commit, closing a handle the game
+	// only read from leaves the save alone.
+	void Commit()
+	{
+		{
+			std::scoped_lock lock(m_imageMutex, m_mutex);
+			if (!m_modified)
+			{
+				return;
+			}
+
+			m_pending.assign(m_image.begin(), m_image.end());
+			m_modified = false;
+			m_dirty = true;
+		}
+		m_wake.notify_one();
+	}
+
+	// Blocks until every committed image is on disk
+	void Flush()
+	{
+		std::unique_lock lock(m_mutex);
+		m_idle.wait(lock, [&] { return !m_dirty && !m_writing; });
+	}
+
+	// False if the last background write failed, the previous save is left untouched in that case
+	bool GetLastWriteSucceeded() const
+	{
+		std::lock_guard lock(m_mutex);
+		return m_lastWriteSucceeded;
+	}
+
+	static bool ReadFile(std::filesystem::path const& path, std::vector<uint8_t>& output)
+	{
+		std::ifstream stream(path, std::ios::binary | std::ios::ate);
+		if (!stream)
+		{
+			return false;
+		}
+
+		std::vector<uint8_t> data((size_t)stream.tellg());
+		stream.seekg(0);
+		stream.read(reinterpret_cast<char*>(data.data()), (std::streamsize)data.size());
+		if (!stream)
+		{
+			return false;
+		}
+
+		uint32_t magic = 0;
+		if (data.size() >= sizeof(magic))
+		{
+			memcpy(&magic, data.data(), sizeof(magic));
+		}
+
+		if (magic != c_lz4FrameMagic)
+		{
+			output = std::move(data);
+			return true;
+		}
+
+		return Decompress(data, output);
+	}
+
+private:
+	static constexpr uint32_t c_lz4FrameMagic = 0x184D2204;
+
+	std::filesystem::path m_path;
+	std::filesystem::path m_readThrough;
+	bool m_compress;
+
+	std::mutex m_imageMutex;
+	std::vector<uint8_t> m_image;		// Game side
+	bool m_loaded{ false };
+	bool m_modified{ false };		// Written since the last commit
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_idle;
+	std::vector<uint8_t> m_pending;		// Latest committed image, swapped with the writer's buffer
+	bool m_dirty{ false };
+	bool m_writing{ false };
+	bool m_stop{ false };
+	bool m_lastWriteSucceeded{ true };
+	std::thread m_thread;
+
+	void Run()
+	{
+		std::vector<uint8_t> image;
+		std::vector<uint8_t> compressed;
+
+		std::unique_lock lock(m_mutex);
+		for (;;)
+		{
+			m_wake.wait(lock, [&] { return m_dirty || m_stop; });
+			if (!m_dirty)
+			{
+				return;
+			}
+
+			// Double buffer, the game can commit again while this one is written
+			image.swap(m_pending);
+			m_dirty = false;
+			m_writing = true;
+			lock.unlock();
+
+			bool success;
+			if (m_compress && Compress(image, compressed))
+			{
+				success = WriteAtomic(m_path, compressed);
+			}
+			else
+			{
+				success = WriteAtomic(m_path, image);
+			}
+
+			lock.lock();
+			m_writing = false;
+			m_lastWriteSucceeded = success;
+			m_idle.notify_all();
+		}
+	}
+
+	static bool Compress(std::vector<uint8_t> const& input, std::vector<uint8_t>& output)
+	{
+		LZ4F_preferences_t preferences{};
+		preferences.frameInfo.contentSize = input.size();
+		preferences.frameInfo.contentChecksumFlag = LZ4F_contentChecksumEnabled;
+
+		output.resize(LZ4F_compressFrameBound(input.size(), &preferences));
+		size_t size = LZ4F_compressFrame(output.data(), output.size(), input.data(), input.size(), &preferences);
+		if (LZ4F_isError(size))
+		{
+			return false;
+		}
+
+		output.resize(size);
+		return true;
+	}
+
+	static bool Decompress(std::vector<uint8_t> const& input, std::vector<uint8_t>& output)
+	{
+		LZ4F_dctx* context = nullptr;
+		if (LZ4F_isError(LZ4F_createDecompressionContext(&context, LZ4F_VERSION)))
+		{
+			return false;
+		}
+
+		LZ4F_frameInfo_t frameInfo{};
+		size_t consumed = input.size();
+		size_t hint = LZ4F_getFrameInfo(context, &frameInfo, input.data(), &consumed);
+
+		std::vector<uint8_t> result;
+		result.reserve(frameInfo.contentSize ? (size_t)frameInfo.contentSize : input.size() * 4);
+
+		size_t position = consumed;
+		uint8_t chunk[64 * 1024];
+		while (!LZ4F_isError(hint) && hint != 0)
+		{
+			size_t sourceSize = input.size() - position;
+			size_t destinationSize = sizeof(chunk);
+			hint = LZ4F_decompress(context, chunk, &destinationSize, input.data() + position, &sourceSize, nullptr);
+			result.insert(result.end(), chunk, chunk + destinationSize);
+			position += sourceSize;
+
+			if (!sourceSize && !destinationSize)
+			{
+				break;
+			}
+		}
+
+		LZ4F_freeDecompressionContext(context);
+		if (hint != 0)
+		{
+			return false;
+		}
+
+		output = std::move(result);
+		return true;
+	}
+
+	// Written next to the target and moved over it, a crash mid-write leaves the old save intact
+	static bool WriteAtomic(std::filesystem::path const& path, std::vector<uint8_t> const& data)
+	{
+		std::filesystem::path temporary = path;
+		temporary += ".tmp";
+
+#ifdef _WIN32
+		HANDLE file = CreateFileW(temporary.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+
+		DWORD written = 0;
+		bool success = WriteFile(file, data.data(), (DWORD)data.size(), &written, nullptr) && written == data.size() && FlushFileBuffers(file);
+		CloseHandle(file);
+
+		if (!success || !MoveFileExW(temporary.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+		{
+			DeleteFileW(temporary.c_str());
+			return false;
+		}
+#else
+		{
+			std::ofstream stream(temporary, std::ios::binary | std::ios::trunc);
+			stream.write(reinterpret_cast<const char*>(data.data()), (std::streamsize)data.size());
+			if (!stream)
+			{
+				stream.close();
+				std::error_code ec;
+				std::filesystem::remove(temporary, ec);
+				return false;
+			}
+		}
+
+		std::error_code ec;
+		std::filesystem::rename(temporary, path, ec);
+		if (ec)
+		{
+			std::filesystem::remove(temporary, ec);
+			return false;
+		}
+#endif
+
+		return true;
+	}
+};
@@ -0,0 +1,245 @@
+#pragma once
+
+// Boot timeline of every mod: DLL load, static initialization, Init and PostInit.
+// LoadModule splits LoadLibrary in two with a loader DLL notification: everything up to the last
+// module mapped by the call is DLL load (mapping, imports, relocations), everything after it is
+// DllMain and CRT static initializers, which is where SIG_SCAN and friends run.
+// Mods are expected to be loaded from one thread, as every loader does during boot.
+//
+//   HMODULE module = profiler.LoadModule(name, path);
+//   profiler.Measure(name, StartupPhase::Init, [&] { init(&info); });
+//   ...
+//   profiler.WriteReport("startup.txt");
+//   profiler.WriteChromeTrace("startup.json");	// chrome://tracing or ui.perfetto.dev
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "../Win32.h"
+
+enum class StartupPhase
+{
+	DllLoad,
+	StaticInit,
+	Init,
+	PostInit,
+	Count
+};
+
+inline const char* GetStartupPhaseName(StartupPhase phase)
+{
+	switch (phase)
+	{
+	case StartupPhase::DllLoad: return "DllLoad";
+	case StartupPhase::StaticInit: return "StaticInit";
+	case StartupPhase::Init: return "Init";
+	case StartupPhase::PostInit: return "PostInit";
+	default: return "Unknown";
+	}
+}
+
+class StartupProfiler
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	void Record(std::string const& mod, StartupPhase phase, Clock::time_point start, Clock::time_point end)
+	{
+		std::lock_guard lock(m_mutex);
+		m_events.push_back({ mod, phase, start, end, GetThreadId() });
+	}
+
+	template<typename TCallback>
+	void Measure(std::string const& mod, StartupPhase phase, TCallback&& callback)
+	{
+		Clock::time_point start = Clock::now();
+		callback();
+		Record(mod, phase, start, Clock::now());
+	}
+
+#ifdef _WIN32
+	HMODULE LoadModule(std::string const& mod, std::filesystem::path const& path, DWORD flags = LOAD_WITH_ALTERED_SEARCH_PATH)
+	{
+		using LdrRegisterDllNotification_t = LONG(NTAPI*)(ULONG flags, void* callback, void* context, void** cookie);
+		using LdrUnregisterDllNotification_t = LONG(NTAPI*)(void* cookie);
+
+		static HMODULE ntdll = GetModuleHandleW(L"ntdll.dll");
+		static auto registerNotification = reinterpret_cast<LdrRegisterDllNotification_t>(GetProcAddress(ntdll, "LdrRegisterDllNotification"));
+		static auto unregisterNotification = reinterpret_cast<LdrUnregisterDllNotification_t>(GetProcAddress(ntdll, "LdrUnregisterDllNotification"));
+
+		Clock::time_point start = Clock::now();
+		m_lastMapped = {};
+
+		void* cookie = nullptr;
+		if (registerNotification)
+		{
+			registerNotification(0, reinterpret_cast<void*>(&StartupProfiler::OnDllNotification), this, &cookie);
+		}
+
+		HMODULE module = LoadLibraryExW(path.c_str(), nullptr, flags);
+		Clock::time_point end = Clock::now();
+
+		if (cookie)
+		{
+			unregisterNotification(cookie);
+		}
+
+		// Already loaded or notifications unavailable, the whole call counts as loading
+		Clock::time_point mapped = m_lastMapped == Clock::time_point{} ? end : m_lastMapped;
+		Record(mod, StartupPhase::DllLoad, start, mapped);
+		Record(mod, StartupPhase::StaticInit, mapped, end);
+
+		return module;
+	}
+#endif
+
+	// Per mod totals, most expensive first
+	std::string FormatReport() const
+	{
+		struct Total
+		{
+			std::string mod;
+			double phases[(size_t)StartupPhase::Count]{};
+			double total{};
+		};
+
+		std::vector<Total> totals;
+		double boot = 0.0;
+		{
+			std::lock_guard lock(m_mutex);
+			std::map<std::string, size_t> indices;
+			for (Event const& event : m_events)
+			{
+				auto [it, inserted] = indices.emplace(event.mod, totals.size());
+				if (inserted)
+				{
+					totals.push_back({ event.mod });
+				}
+
+				double milliseconds = std::chrono::duration<double, std::milli>(event.end - event.start).count();
+				totals[it->second].phases[(size_t)event.phase] += milliseconds;
+				totals[it->second].total += milliseconds;
+				boot += milliseconds;
+			}
+		}
+
+		std::sort(totals.begin(), totals.end(), [](Total const& a, Total const& b) { return a.total > b.total; });
+
+		std::string report;
+		char line[512];
+		snprintf(line, sizeof(line), "%-40s %10s %10s %10s %10s %10s\n", "Mod", "Total ms", "DllLoad", "StaticInit", "Init", "PostInit");
+		report += line;
+
+		for (Total const& total : totals)
+		{
+			snprintf(line, sizeof(line), "%-40.40s %10.2f %10.2f %10.2f %10.2f %10.2f\n", total.mod.c_str(), total.total,
+				total.phases[(size_t)StartupPhase::DllLoad], total.phases[(size_t)StartupPhase::StaticInit],
+				total.phases[(size_t)StartupPhase::Init], total.phases[(size_t)StartupPhase::PostInit]);
+			report += line;
+		}
+
+		snprintf(line, sizeof(line), "%zu mods, %.2f ms total\n", totals.size(), boot);
+		report += line;
+		return report;
+	}
+
+	bool WriteReport(std::filesystem::path const& path) const
+	{
+		std::ofstream stream(path, std::ios::trunc);
+		stream << FormatReport();
+		return (bool)stream;
+	}
+
+	// Trace Event Format, one complete ("X") event per phase
+	bool WriteChromeTrace(std::filesystem::path const& path) const
+	{
+		std::ofstream stream(path, std::ios::trunc);
+		stream << "{\"traceEvents\":[";
+
+		std::lock_guard lock(m_mutex);
+		for (size_t i = 0; i < m_events.size(); i++)
+		{
+			Event const& event = m_events[i];
+			long long ts = (long long)std::chrono::duration_cast<std::chrono::microseconds>(event.start - m_origin).count();
+			long long dur = (long long)std::chrono::duration_cast<std::chrono::microseconds>(event.end - event.start).count();
+
+			stream << (i ? ",\n" : "\n")
+				<< "{\"name\":\"" << EscapeJson(event.mod) << ' ' << GetStartupPhaseName(event.phase) << "\""
+				<< ",\"cat\":\"" << GetStartupPhaseName(event.phase) << "\""
+				<< ",\"ph\":\"X\",\"ts\":" << ts << ",\"dur\":" << dur
+				<< ",\"pid\":1,\"tid\":" << event.thread
+				<< ",\"args\":{\"mod\":\"" << EscapeJson(event.mod) << "\"}}";
+		}
+
+		stream << "\n]}\n";
+		return (bool)stream;
+	}
+
+private:
+	struct Event
+	{
+		std::string mod;
+		StartupPhase phase;
+		Clock::time_point start;
+		Clock::time_point end;
+		uint32_t thread;
+	};
+
+	mutable std::mutex m_mutex;
+	std::vector<Event> m_events;
+	Clock::time_point m_origin{ Clock::now() };
+	Clock::time_point m_lastMapped{};
+
+	static uint32_t GetThreadId()
+	{
+#ifdef _WIN32
+		return (uint32_t)GetCurrentThreadId();
+#else
+		return 0;
+#endif
+	}
+
+	static std::string EscapeJson(std::string const& value)
+	{
+		std::string result;
+		result.reserve(value.size());
+		for (char c : value)
+		{
+			if (c == '"' || c == '\\')
+			{
+				result += '\\';
+				result += c;
+			}
+			else if ((unsigned char)c < 0x20)
+			{
+				char buffer[8];
+				snprintf(buffer, sizeof(buffer), "\\u%04x", (unsigned)c);
+				result += buffer;
+			}
+			else
+			{
+				result += c;
+			}
+		}
+		return result;
+	}
+
+#ifdef _WIN32
+	// LDR_DLL_NOTIFICATION_REASON_LOADED, sent for each module as it is mapped, before any initializer of the load runs
+	static void CALLBACK OnDllNotification(ULONG reason, const void* /*data*/, void* context)
+	{
+		if (reason == 1)
+		{
+			static_cast<StartupProfiler*>(context)->m_lastMapped = Clock::now();
+		}
+	}
+#endif
+};
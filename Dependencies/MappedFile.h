@@ -0,0 +1,152 @@
+#pragma once
+
+// Read-only memory mapping of a whole file.
+// Uses CreateFileMapping on Windows and mmap elsewhere.
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+#include "Win32.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+class MappedFile
+{
+public:
+	MappedFile() = default;
+
+	explicit MappedFile(std::filesystem::path const& path)
+	{
+		Open(path);
+	}
+
+	~MappedFile()
+	{
+		Close();
+	}
+
+	MappedFile(MappedFile const&) = delete;
+	MappedFile& operator=(MappedFile const&) = delete;
+
+	MappedFile(MappedFile&& other) noexcept
+	{
+		*this = std::move(other);
+	}
+
+	MappedFile& operator=(MappedFile&& other) noexcept
+	{
+		if (this != &other)
+		{
+			Close();
+			m_data = other.m_data;
+			m_size = other.m_size;
+			other.m_data = nullptr;
+			other.m_size = 0;
+		}
+		return *this;
+	}
+
+	bool Open(std::filesystem::path const& path)
+	{
+		Close();
+
+#ifdef _WIN32
+		HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+
+		LARGE_INTEGER size{};
+		if (!GetFileSizeEx(file, &size) || size.QuadPart == 0 || (uint64_t)size.QuadPart > SIZE_MAX)
+		{
+			CloseHandle(file);
+			return false;
+		}
+
+		// The view keeps its own reference to the section, both handles can go right away
+		HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		CloseHandle(file);
+		if (!mapping)
+		{
+			return false;
+		}
+
+		m_data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		CloseHandle(mapping);
+		if (!m_data)
+		{
+			return false;
+		}
+
+		m_size = (size_t)size.QuadPart;
+#else
+		int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+		{
+			return false;
+		}
+
+		struct stat info{};
+		if (fstat(fd, &info) != 0 || info.st_size == 0)
+		{
+			close(fd);
+			return false;
+		}
+
+		void* data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (data == MAP_FAILED)
+		{
+			return false;
+		}
+
+		m_data = static_cast<const uint8_t*>(data);
+		m_size = (size_t)info.st_size;
+#endif
+
+		return true;
+	}
+
+	void Close()
+	{
+		if (!m_data)
+		{
+			return;
+		}
+
+#ifdef _WIN32
+		UnmapViewOfFile(m_data);
+#else
+		munmap(const_cast<uint8_t*>(m_data), m_size);
+#endif
+
+		m_data = nullptr;
+		m_size = 0;
+	}
+
+	const uint8_t* GetData() const
+	{
+		return m_data;
+	}
+
+	size_t GetSize() const
+	{
+		return m_size;
+	}
+
+	explicit operator bool() const
+	{
+		return m_data != nullptr;
+	}
+
+private:
+	const uint8_t* m_data{};
+	size_t m_size{};
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+// Parallel mod.ini loading.
+// Requires Dependencies\oneTBB\include in the include path.
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <oneapi/tbb/parallel_for.h>
+
+#include "INIReader.h"
+
+namespace Common
+{
+
+struct ModConfig
+{
+	std::string path;
+	size_t priority{};			// Position in the active mod list, 0 is the highest priority
+	INIReader reader;
+	double parseMilliseconds{};
+};
+
+// Parse every config concurrently. Each result is written to the slot of its
+// input so the output keeps the priority order of modIniList regardless of scheduling.
+// Each config records its parse time, so callers can point out mods on slow drives.
+inline std::vector<ModConfig> LoadModConfigs(std::vector<std::string> const& modIniList)
+{
+	std::vector<ModConfig> configs(modIniList.size());
+
+	tbb::parallel_for(size_t(0), modIniList.size(), [&](size_t i)
+	{
+		auto start = std::chrono::steady_clock::now();
+
+		ModConfig& config = configs[i];
+		config.path = modIniList[i];
+		config.priority = i;
+		config.reader = INIReader(config.path);
+
+		config.parseMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	});
+
+	return configs;
+}
+
+// Prints the wall time of the whole parse and every config slower than slowThresholdMs,
+// so mods on slow or network drives stand out in the log
+inline void PrintModConfigParseTimes(std::vector<ModConfig> const& configs, double totalMilliseconds, double slowThresholdMs = 50.0)
+{
+	printf("[ModConfigLoader] Parsed %zu mod configs in %.2f ms\n", configs.size(), totalMilliseconds);
+	for (ModConfig const& config : configs)
+	{
+		if (config.parseMilliseconds >= slowThresholdMs)
+		{
+			printf("[ModConfigLoader] %s took %.2f ms to parse\n", config.path.c_str(), config.parseMilliseconds);
+		}
+	}
+}
+
+} // namespace Common
@@ -0,0 +1,399 @@
+#pragma once
+
+// Cached implementations of the mod config and file queries in Common.h, compiled in place of its
+// plain ones when a project defines COMMON_MOD_DATABASE before including it.
+// Mod configs are parsed in parallel once and served from ModsDB.snapshot on warm starts, archive
+// and file existence queries go through indexes. EnableModFolderWatcher keeps all of it current.
+//
+// Requires Dependencies\oneTBB\include and Dependencies\xxHash in the include path, tbb12.lib
+// linked and tbb12.dll shipped next to the mod.
+
+#include "FileExistenceCache.h"
+#include "ModConfigLoader.h"
+#include "ModDatabaseSnapshot.h"
+#include "ModFileIndex.h"
+
+namespace Common
+{
+
+inline bool IsFileExist(std::string const& file)
+{
+	return GetFileExistenceCache().Exists(file);
+}
+
+inline std::string GetGameDirectory()
+{
+	char buffer[MAX_PATH];
+	GetModuleFileNameA(NULL, buffer, MAX_PATH);
+	std::string exePath(buffer);
+	return exePath.substr(0, exePath.find_last_of("\\"));
+}
+
+inline std::string GetModsDatabasePath()
+{
+	std::string cpkRedirConfig = GetGameDirectory() + "\\cpkredir.ini";
+
+	if (!Common::IsFileExist(cpkRedirConfig))
+	{
+		printf("%s not exist.\n", cpkRedirConfig.c_str());
+		return {};
+	}
+
+	INIReader reader(cpkRedirConfig);
+	std::string modsDatabase = reader.Get("CPKREDIR", "ModsDbIni", "mods\\ModsDB.ini");
+
+	if (!Common::IsFileExist(modsDatabase))
+	{
+		printf("%s not exist.\n", modsDatabase.c_str());
+		return {};
+	}
+
+	return modsDatabase;
+}
+
+inline void GetModIniList(std::vector<std::string>& modIniList)
+{
+	std::string modsDatabase = GetModsDatabasePath();
+	if (modsDatabase.empty())
+	{
+		return;
+	}
+
+	INIReader modsDatabaseReader(modsDatabase);
+	int count = modsDatabaseReader.GetInteger("Main", "ActiveModCount", 0);
+	for (int i = 0; i < count; i++)
+	{
+		std::string guid = modsDatabaseReader.Get("Main", "ActiveMod" + std::to_string(i), "");
+		std::string config = modsDatabaseReader.Get("Mods", guid, "");
+		if (!config.empty() && Common::IsFileExist(config))
+		{
+			modIniList.push_back(config);
+		}
+	}
+}
+
+// Every file the mod config list is resolved from, in the order they are read
+inline std::vector<std::filesystem::path> GetModConfigSources(std::string const& modsDatabase, std::vector<ModConfig> const& configs)
+{
+	std::vector<std::filesystem::path> sources{ GetGameDirectory() + "\\cpkredir.ini", modsDatabase };
+	for (ModConfig const& config : configs)
+	{
+		sources.push_back(config.path);
+	}
+	return sources;
+}
+
+// Warm starts are served from ModsDB.snapshot next to the game executable,
+// any change to cpkredir.ini, ModsDB.ini or an active mod.ini falls back to parsing and rewrites it.
+inline std::vector<ModConfig> LoadModConfigList()
+{
+	std::string snapshot = GetGameDirectory() + "\\ModsDB.snapshot";
+	std::vector<ModConfig> configs;
+	switch (ModDatabaseSnapshot::Load(snapshot, configs))
+	{
+	case ModDatabaseSnapshot::Result::Loaded:
+		return configs;
+
+	case ModDatabaseSnapshot::Result::LoadedNeedsRefresh:
+		ModDatabaseSnapshot::Save(snapshot, GetModConfigSources(GetModsDatabasePath(), configs), configs);
+		return configs;
+
+	default:
+		break;
+	}
+
+	std::string modsDatabase = GetModsDatabasePath();
+	if (modsDatabase.empty())
+	{
+		return configs;
+	}
+
+	std::vector<std::string> modIniList;
+	GetModIniList(modIniList);
+
+	auto start = std::chrono::steady_clock::now();
+	configs = LoadModConfigs(modIniList);
+	PrintModConfigParseTimes(configs, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+	if (!ModDatabaseSnapshot::Save(snapshot, GetModConfigSources(modsDatabase, configs), configs))
+	{
+		printf("[ModDatabaseSnapshot] Failed to write %s\n", snapshot.c_str());
+	}
+
+	return configs;
+}
+
+// Shared and never modified once published, the watcher swaps in an updated copy
+using ModConfigList = std::shared_ptr<const std::vector<ModConfig>>;
+
+struct ModConfigCache
+{
+	std::mutex mutex;
+	ModConfigList configs;
+	bool valid{ false };		// Until the watcher reports a change, for the whole process without one
+};
+
+inline ModConfigCache& GetModConfigCache()
+{
+	static ModConfigCache cache;
+	return cache;
+}
+
+// Keep the returned pointer alive while iterating, ranging over *GetModConfigList() directly would
+// destroy it before the loop body runs
+inline ModConfigList GetModConfigList()
+{
+	ModConfigCache& cache = GetModConfigCache();
+	std::lock_guard lock(cache.mutex);
+	if (!cache.valid)
+	{
+		cache.configs = std::make_shared<const std::vector<ModConfig>>(LoadModConfigList());
+		cache.valid = true;
+	}
+
+	return cache.configs;
+}
+
+inline bool IsModEnabled(std::string const& testModName, std::string* o_iniPath = nullptr)
+{
+	ModConfigList configs = GetModConfigList();
+	for (ModConfig const& config : *configs)
+	{
+		std::string name = config.reader.Get("Desc", "Title", "");
+		if (name == testModName)
+		{
+			if (o_iniPath)
+			{
+				*o_iniPath = config.path;
+			}
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+inline bool IsModEnabled(std::string const& section, std::string const& name, std::string const& str, std::string* o_iniPath = nullptr)
+{
+	ModConfigList configs = GetModConfigList();
+	for (ModConfig const& config : *configs)
+	{
+		std::string value = config.reader.Get(section, name, "");
+		if (value == str)
+		{
+			if (o_iniPath)
+			{
+				*o_iniPath = config.path;
+			}
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+inline bool GetModIDFromDLL(std::string const& name, std::string& o_modID)
+{
+	bool found = false;
+	o_modID.clear();
+
+	ModConfigList configs = GetModConfigList();
+	for (ModConfig const& config : *configs)
+	{
+		INIReader const& configReader = config.reader;
+		std::string value = configReader.Get("Main", "DLLFile", "");
+		if (value == name)
+		{
+			if (found)
+			{
+				MessageBox(nullptr, TEXT("There are multiple mods with the same .dll"), TEXT("ERROR"), MB_ICONERROR);
+				exit(-1);
+			}
+
+			found = true;
+			o_modID = configReader.Get("Main", "ID", "");
+
+			if (o_modID.empty())
+			{
+				MessageBox(nullptr, TEXT("One of the mods has no valid ID"), TEXT("ERROR"), MB_ICONERROR);
+				exit(-1);
+			}
+		}
+	}
+
+	return found;
+}
+
+inline bool TestModPriority(std::string const& currentModName, std::string const& testModName, bool higherPriority)
+{
+	printf("currentModName = %s, testModName = %s\n", currentModName.c_str(), testModName.c_str());
+
+	int currentModIndex = -1;
+	int testModIndex = -1;
+
+	ModConfigList configs = GetModConfigList();
+	for (ModConfig const& config : *configs)
+	{
+		std::string name = config.reader.Get("Desc", "Title", "");
+		if (name == currentModName)
+		{
+			currentModIndex = (int)config.priority;
+		}
+		else if (name == testModName)
+		{
+			testModIndex = (int)config.priority;
+		}
+	}
+
+	if (currentModIndex != -1 && testModIndex != -1)
+	{
+		bool success = true;
+		if (higherPriority)
+		{
+			success = (testModIndex < currentModIndex);
+		}
+		else
+		{
+			success = (testModIndex > currentModIndex);
+		}
+
+		if (!success)
+		{
+			std::string errorMsg = testModName + " detected, please put it " + (higherPriority ? "higher" : "lower") + " priority than (" + (higherPriority ? "above" : "below") + ") this mod.";
+			std::wstring stemp = std::wstring(errorMsg.begin(), errorMsg.end());
+			std::wstring stemp2 = std::wstring(currentModName.begin(), currentModName.end());
+			MessageBox(nullptr, stemp.c_str(), stemp2.c_str(), MB_ICONERROR);
+			exit(-1);
+		}
+
+		return success;
+	}
+
+	// Mod not found
+	return false;
+}
+
+inline ModFileIndex& GetModFileIndex()
+{
+	static ModFileIndex index;
+	if (index.IsStale())
+	{
+		std::vector<ModFileIndex::ModFolder> mods;
+		ModConfigList configs = GetModConfigList();
+		for (ModConfig const& config : *configs)
+		{
+			mods.push_back({ config.reader.Get("Desc", "Title", ""), config.path.substr(0, config.path.length() - 7) });
+		}
+
+		index.Build(std::move(mods), GetModsDatabasePath());
+	}
+
+	return index;
+}
+
+// Keep GetModConfigList, DoesArchiveExist and IsFileExist current from file system notifications
+// instead of rereading configs and checking directory mtimes.
+inline DirectoryWatcher* EnableModFolderWatcher()
+{
+	// Intentionally leaked, joining the watcher thread during DLL unload would deadlock on the loader lock
+	static DirectoryWatcher* watcher = nullptr;
+	if (watcher)
+	{
+		return watcher;
+	}
+
+	std::filesystem::path modsDatabase = GetModsDatabasePath();
+	if (modsDatabase.empty())
+	{
+		return nullptr;
+	}
+
+	std::error_code ec;
+	modsDatabase = std::filesystem::absolute(modsDatabase, ec).lexically_normal();
+	std::filesystem::path modsDirectory = modsDatabase.parent_path();
+
+	watcher = new DirectoryWatcher();
+	watcher->Subscribe([modsDatabase](std::vector<FileChange> const& changes)
+	{
+		ModConfigCache& cache = GetModConfigCache();
+		std::lock_guard lock(cache.mutex);
+		if (!cache.valid)
+		{
+			return;
+		}
+
+		// Lists already handed out stay as they are, edits go into a copy published at the end
+		std::shared_ptr<std::vector<ModConfig>> updated;
+		for (FileChange const& change : changes)
+		{
+			if (change.type == FileChangeType::Overflow || change.path == modsDatabase)
+			{
+				cache.valid = false;
+				return;
+			}
+
+			for (size_t i = 0; i < cache.configs->size(); i++)
+			{
+				std::string const& path = (*cache.configs)[i].path;
+				std::error_code ec;
+				if (std::filesystem::absolute(path, ec).lexically_normal() != change.path)
+				{
+					continue;
+				}
+
+				if (change.type == FileChangeType::Removed)
+				{
+					cache.valid = false;
+					return;
+				}
+
+				// Only the edited config is parsed again
+				if (!updated)
+				{
+					updated = std::make_shared<std::vector<ModConfig>>(*cache.configs);
+				}
+				(*updated)[i].reader = INIReader(path);
+			}
+		}
+
+		if (updated)
+		{
+			cache.configs = std::move(updated);
+		}
+	});
+
+	watcher->Subscribe([](std::vector<FileChange> const& changes)
+	{
+		GetFileExistenceCache().ApplyChanges(changes);
+	});
+
+	ModFileIndex& index = GetModFileIndex();
+	watcher->Subscribe([&index](std::vector<FileChange> const& changes)
+	{
+		index.ApplyChanges(changes);
+	});
+
+	// Mod folders usually live under the mods directory, anything outside of it gets its own watch
+	watcher->Watch(modsDirectory);
+	GetFileExistenceCache().AddWatchedDirectory(modsDirectory);
+	for (ModFileIndex::ModFolder const& mod : index.GetMods())
+	{
+		auto mismatch = std::mismatch(modsDirectory.begin(), modsDirectory.end(), mod.folder.begin(), mod.folder.end());
+		if (mismatch.first != modsDirectory.end())
+		{
+			watcher->Watch(mod.folder);
+			GetFileExistenceCache().AddWatchedDirectory(mod.folder);
+		}
+	}
+
+	return watcher;
+}
+
+inline bool DoesArchiveExist(std::string const& archiveName, std::set<std::string> const& ignoreModList = {})
+{
+	return GetModFileIndex().Contains(archiveName, ignoreModList);
+}
+
+} // namespace Common
@@ -0,0 +1,324 @@
+#pragma once
+
+// Binary snapshot of the parsed mod database.
+// Holds every parsed mod config along with the size, mtime and hash of each file it was built from,
+// so a warm start is one mapping plus a stat per source file instead of parsing every INI again.
+// Requires Dependencies\xxHash in the include path.
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#define XXH_INLINE_ALL
+#include <xxhash.h>
+
+#include "MappedFile.h"
+#include "ModConfigLoader.h"
+
+namespace Common
+{
+
+class ModDatabaseSnapshot
+{
+public:
+	enum class Result
+	{
+		Loaded,
+		LoadedNeedsRefresh,		// Contents matched but some mtimes didn't, saving again restores the fast path
+		Missing,
+		Stale,
+		Corrupted,
+	};
+
+	// Configs are only filled in when every source file still matches
+	static Result Load(std::filesystem::path const& snapshot, std::vector<ModConfig>& configs)
+	{
+		MappedFile file(snapshot);
+		if (!file)
+		{
+			return Result::Missing;
+		}
+
+		if (file.GetSize() < sizeof(Header))
+		{
+			return Result::Corrupted;
+		}
+
+		Header header;
+		memcpy(&header, file.GetData(), sizeof(Header));
+		if (header.magic != c_magic || header.version != c_version || header.payloadSize != file.GetSize() - sizeof(Header))
+		{
+			return Result::Corrupted;
+		}
+
+		Reader reader{ file.GetData() + sizeof(Header), file.GetData() + file.GetSize() };
+		if (XXH3_64bits(reader.current, (size_t)header.payloadSize) != header.payloadHash)
+		{
+			return Result::Corrupted;
+		}
+
+		bool needsRefresh = false;
+		uint32_t sourceCount = reader.Read<uint32_t>();
+		for (uint32_t i = 0; i < sourceCount && reader.valid; i++)
+		{
+			SourceFile source;
+			source.path = reader.ReadString();
+			source.size = reader.Read<uint64_t>();
+			source.time = reader.Read<int64_t>();
+			source.hash = reader.Read<uint64_t>();
+			if (!reader.valid)
+			{
+				break;
+			}
+
+			switch (Validate(source))
+			{
+			case Validation::Match: break;
+			case Validation::ContentMatch: needsRefresh = true; break;
+			case Validation::Mismatch: return Result::Stale;
+			}
+		}
+
+		std::vector<ModConfig> result(reader.Read<uint32_t>());
+		for (ModConfig& config : result)
+		{
+			config.path = reader.ReadString();
+			config.priority = reader.Read<uint32_t>();
+
+			std::set<std::string> sections;
+			uint32_t sectionCount = reader.Read<uint32_t>();
+			for (uint32_t i = 0; i < sectionCount && reader.valid; i++)
+			{
+				sections.insert(sections.end(), reader.ReadString());
+			}
+
+			std::map<std::string, std::string> values;
+			uint32_t valueCount = reader.Read<uint32_t>();
+			for (uint32_t i = 0; i < valueCount && reader.valid; i++)
+			{
+				std::string key = reader.ReadString();
+				values.emplace_hint(values.end(), std::move(key), reader.ReadString());
+			}
+
+			if (!reader.valid)
+			{
+				break;
+			}
+
+			config.reader = INIReader(std::move(values), std::move(sections));
+		}
+
+		if (!reader.valid || reader.current != reader.end)
+		{
+			return Result::Corrupted;
+		}
+
+		configs = std::move(result);
+		return needsRefresh ? Result::LoadedNeedsRefresh : Result::Loaded;
+	}
+
+	// sources are every file the configs were resolved from (cpkredir.ini, ModsDB.ini, each mod.ini).
+	// Written next to the target and renamed over it, so a concurrent reader never maps a partial file.
+	static bool Save(std::filesystem::path const& snapshot, std::vector<std::filesystem::path> const& sources, std::vector<ModConfig> const& configs)
+	{
+		std::string payload;
+		Write(payload, (uint32_t)sources.size());
+		for (std::filesystem::path const& path : sources)
+		{
+			SourceFile source;
+			if (!Describe(path, source))
+			{
+				return false;
+			}
+
+			WriteString(payload, source.path);
+			Write(payload, source.size);
+			Write(payload, source.time);
+			Write(payload, source.hash);
+		}
+
+		Write(payload, (uint32_t)configs.size());
+		for (ModConfig const& config : configs)
+		{
+			WriteString(payload, config.path);
+			Write(payload, (uint32_t)config.priority);
+
+			Write(payload, (uint32_t)config.reader.Sections().size());
+			for (std::string const& section : config.reader.Sections())
+			{
+				WriteString(payload, section);
+			}
+
+			Write(payload, (uint32_t)config.reader.Values().size());
+			for (auto const& [key, value] : config.reader.Values())
+			{
+				WriteString(payload, key);
+				WriteString(payload, value);
+			}
+		}
+
+		Header header{ c_magic, c_version, payload.size(), XXH3_64bits(payload.data(), payload.size()) };
+
+		// Several mod DLLs can share this code, give each writer its own temporary file
+		std::filesystem::path temporary = snapshot;
+		temporary += "." + std::to_string(XXH3_64bits_withSeed(&header, sizeof(header),
+			std::hash<std::thread::id>()(std::this_thread::get_id()) ^ (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count())) + ".tmp";
+
+		{
+			std::ofstream stream(temporary, std::ios::binary | std::ios::trunc);
+			stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			stream.write(payload.data(), (std::streamsize)payload.size());
+			if (!stream)
+			{
+				stream.close();
+				std::error_code ec;
+				std::filesystem::remove(temporary, ec);
+				return false;
+			}
+		}
+
+		std::error_code ec;
+		std::filesystem::rename(temporary, snapshot, ec);
+		if (ec)
+		{
+			std::filesystem::remove(temporary, ec);
+			return false;
+		}
+
+		return true;
+	}
+
+private:
+	static constexpr uint32_t c_magic = 0x5342444D; // "MDBS"
+	static constexpr uint32_t c_version = 1;
+
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t payloadSize;
+		uint64_t payloadHash;
+	};
+
+	struct SourceFile
+	{
+		std::string path;
+		uint64_t size{};
+		int64_t time{};
+		uint64_t hash{};
+	};
+
+	enum class Validation
+	{
+		Match,
+		ContentMatch,
+		Mismatch,
+	};
+
+	struct Reader
+	{
+		const uint8_t* current;
+		const uint8_t* end;
+		bool valid{ true };
+
+		template<typename T>
+		T Read()
+		{
+			T value{};
+			if (!valid || (size_t)(end - current) < sizeof(T))
+			{
+				valid = false;
+				return value;
+			}
+
+			memcpy(&value, current, sizeof(T));
+			current += sizeof(T);
+			return value;
+		}
+
+		std::string ReadString()
+		{
+			uint32_t length = Read<uint32_t>();
+			if (!valid || (size_t)(end - current) < length)
+			{
+				valid = false;
+				return {};
+			}
+
+			std::string value(reinterpret_cast<const char*>(current), length);
+			current += length;
+			return value;
+		}
+	};
+
+	template<typename T>
+	static void Write(std::string& payload, T value)
+	{
+		payload.append(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	static void WriteString(std::string& payload, std::string_view value)
+	{
+		Write(payload, (uint32_t)value.size());
+		payload.append(value);
+	}
+
+	static uint64_t HashFile(std::filesystem::path const& path)
+	{
+		MappedFile file(path);
+		return file ? XXH3_64bits(file.GetData(), file.GetSize()) : 0;
+	}
+
+	static bool Describe(std::filesystem::path const& path, SourceFile& source)
+	{
+		std::error_code ec;
+		source.path = path.string();
+		source.size = std::filesystem::file_size(path, ec);
+		if (ec)
+		{
+			return false;
+		}
+
+		source.time = (int64_t)std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+		if (ec)
+		{
+			return false;
+		}
+
+		source.hash = HashFile(path);
+		return true;
+	}
+
+	// Size and mtime settle most checks, contents are only hashed when a file was touched without changing size
+	static Validation Validate(SourceFile const& source)
+	{
+		std::error_code ec;
+		uint64_t size = std::filesystem::file_size(source.path, ec);
+		if (ec || size != source.size)
+		{
+			return Validation::Mismatch;
+		}
+
+		int64_t time = (int64_t)std::filesystem::last_write_time(source.path, ec).time_since_epoch().count();
+		if (ec)
+		{
+			return Validation::Mismatch;
+		}
+
+		if (time == source.time)
+		{
+			return Validation::Match;
+		}
+
+		return HashFile(source.path) == source.hash ? Validation::ContentMatch : Validation::Mismatch;
+	}
+};
+
+} // namespace Common
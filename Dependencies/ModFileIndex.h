@@ -0,0 +1,491 @@
+#pragma once
+
+// Filename index over the folders of every enabled mod.
+// Requires Dependencies\oneTBB\include and Dependencies\xxHash in the include path.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <oneapi/tbb/enumerable_thread_specific.h>
+#include <oneapi/tbb/parallel_for_each.h>
+
+#define XXH_INLINE_ALL
+#include <xxhash.h>
+
+#include "DirectoryWatcher.h"
+
+namespace Common
+{
+
+// XXH3 of a lowercased name in the file system's native encoding, game paths are case-insensitive.
+// Indexed names are hashed from path::native() so names outside the ANSI code page never go through a
+// narrow conversion, which throws on Windows.
+template<typename Char>
+inline uint64_t HashNativeName(std::basic_string_view<Char> name)
+{
+	Char buffer[260];
+	std::basic_string<Char> large;
+	Char* lower = buffer;
+	if (name.size() > sizeof(buffer) / sizeof(Char))
+	{
+		large.resize(name.size());
+		lower = large.data();
+	}
+
+	for (size_t i = 0; i < name.size(); i++)
+	{
+		Char c = name[i];
+		lower[i] = c >= 'A' && c <= 'Z' ? (Char)(c - 'A' + 'a') : c;
+	}
+	return XXH3_64bits(lower, name.size() * sizeof(Char));
+}
+
+inline uint64_t HashNativeName(std::filesystem::path const& name)
+{
+	return HashNativeName(std::basic_string_view<std::filesystem::path::value_type>(name.native()));
+}
+
+// Narrow names from callers hash the same as the native name of that file
+inline uint64_t HashFileName(std::string_view name)
+{
+	using Char = std::filesystem::path::value_type;
+	if constexpr (sizeof(Char) == sizeof(char))
+	{
+		return HashNativeName(name);
+	}
+	else
+	{
+		Char buffer[260];
+		bool ascii = name.size() <= sizeof(buffer) / sizeof(Char);
+		for (size_t i = 0; ascii && i < name.size(); i++)
+		{
+			ascii = (unsigned char)name[i] < 0x80;
+			buffer[i] = (Char)name[i];
+		}
+
+		if (ascii)
+		{
+			return HashNativeName(std::basic_string_view<Char>(buffer, name.size()));
+		}
+
+		// Everything else converts through the code page exactly like path does
+		return HashNativeName(std::filesystem::path(std::string(name)));
+	}
+}
+
+class ModFileIndex
+{
+public:
+	struct ModFolder
+	{
+		std::string title;
+		std::filesystem::path folder;
+	};
+
+	// Walk every mod folder in parallel and index all file names.
+	// Mods are expected in priority order, the index of a mod in this list is what queries report.
+	void Build(std::vector<ModFolder> mods, std::filesystem::path const& database = {})
+	{
+		struct WorkItem
+		{
+			std::filesystem::path directory;
+			uint32_t modIndex;
+		};
+
+		struct LocalResult
+		{
+			std::vector<std::tuple<uint64_t, uint64_t, uint32_t>> files;
+			std::vector<std::pair<std::filesystem::path::string_type, std::filesystem::file_time_type>> directories;
+		};
+
+		std::vector<WorkItem> roots;
+		roots.reserve(mods.size());
+		for (uint32_t i = 0; i < mods.size(); i++)
+		{
+			std::error_code ec;
+			mods[i].folder = std::filesystem::absolute(mods[i].folder, ec).lexically_normal();
+			roots.push_back({ mods[i].folder, i });
+		}
+
+		tbb::enumerable_thread_specific<LocalResult> locals;
+		tbb::parallel_for_each(roots.begin(), roots.end(), [&locals](WorkItem const& item, tbb::feeder<WorkItem>& feeder)
+		{
+			LocalResult& local = locals.local();
+
+			std::error_code ec;
+			std::filesystem::file_time_type time = std::filesystem::last_write_time(item.directory, ec);
+			if (ec)
+			{
+				return;
+			}
+			local.directories.emplace_back(item.directory.native(), time);
+			uint64_t directoryHash = HashNativeName(item.directory);
+
+			// Directory names are indexed too, the original DoesArchiveExist matched any entry
+			for (std::filesystem::directory_iterator it(item.directory, ec), end; !ec && it != end; it.increment(ec))
+			{
+				std::filesystem::directory_entry const& entry = *it;
+				local.files.emplace_back(HashNativeName(entry.path().filename()), directoryHash, item.modIndex);
+				if (entry.is_directory(ec))
+				{
+					feeder.add({ entry.path(), item.modIndex });
+				}
+			}
+		});
+
+		std::unique_lock lock(m_mutex);
+		m_mods = std::move(mods);
+		m_files.clear();
+		m_directories.clear();
+		for (LocalResult& local : locals)
+		{
+			for (auto const& [hash, directoryHash, modIndex] : local.files)
+			{
+				AddFile(hash, directoryHash, modIndex);
+			}
+
+			m_directories.insert(local.directories.begin(), local.directories.end());
+		}
+
+		std::error_code ec;
+		m_database = database;
+		m_databaseTime = database.empty() ? std::filesystem::file_time_type{} : std::filesystem::last_write_time(database, ec);
+		m_lastValidation = std::chrono::steady_clock::now();
+		m_built = true;
+	}
+
+	// Mods providing a file or directory with this name, in priority order. Empty if none.
+	std::vector<uint32_t> FindProviders(std::string_view fileName) const
+	{
+		std::shared_lock lock(m_mutex);
+		std::vector<uint32_t> result;
+		if (Providers const* providers = Find(fileName))
+		{
+			for (Provider const& provider : *providers)
+			{
+				result.push_back(provider.modIndex);
+			}
+		}
+		return result;
+	}
+
+	// Same filter as the original DoesArchiveExist, a mod is skipped if its title contains any ignored name
+	template<typename TIgnoreList>
+	bool Contains(std::string_view fileName, TIgnoreList const& ignoreModList) const
+	{
+		std::shared_lock lock(m_mutex);
+		Providers const* providers = Find(fileName);
+		if (!providers)
+		{
+			return false;
+		}
+
+		for (Provider const& provider : *providers)
+		{
+			bool ignore = false;
+			std::string const& title = m_mods[provider.modIndex].title;
+			for (std::string const& ignoreMod : ignoreModList)
+			{
+				if (title.find(ignoreMod) != std::string::npos)
+				{
+					ignore = true;
+					break;
+				}
+			}
+
+			if (!ignore)
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	std::vector<ModFolder> GetMods() const
+	{
+		std::shared_lock lock(m_mutex);
+		return m_mods;
+	}
+
+	// Directory mtimes change whenever an entry is added, removed or renamed in them.
+	// Checks are throttled so a burst of queries doesn't turn into a burst of stat calls.
+	// Once a watcher feeds ApplyChanges the index is kept current and no stat calls are needed.
+	bool IsStale(std::chrono::milliseconds interval = std::chrono::milliseconds(1000))
+	{
+		std::unique_lock lock(m_mutex);
+		if (!m_built)
+		{
+			return true;
+		}
+
+		if (m_watched)
+		{
+			return false;
+		}
+
+		auto now = std::chrono::steady_clock::now();
+		if (now - m_lastValidation < interval)
+		{
+			return false;
+		}
+		m_lastValidation = now;
+
+		std::error_code ec;
+		if (!m_database.empty() && std::filesystem::last_write_time(m_database, ec) != m_databaseTime)
+		{
+			return true;
+		}
+
+		for (auto const& [directory, time] : m_directories)
+		{
+			if (std::filesystem::last_write_time(directory, ec) != time || ec)
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	void Invalidate()
+	{
+		std::unique_lock lock(m_mutex);
+		m_built = false;
+	}
+
+	// Incremental update from a DirectoryWatcher, only the reported paths are touched.
+	// Anything that can't be resolved locally (lost events, removed directories, ModsDB edits) invalidates the index.
+	void ApplyChanges(std::vector<FileChange> const& changes)
+	{
+		std::unique_lock lock(m_mutex);
+		m_watched = true;
+		if (!m_built)
+		{
+			return;
+		}
+
+		for (FileChange const& change : changes)
+		{
+			if (change.type == FileChangeType::Overflow || (!m_database.empty() && IsSamePath(change.path, m_database)))
+			{
+				m_built = false;
+				return;
+			}
+
+			uint32_t modIndex = FindMod(change.path);
+			if (modIndex == UINT32_MAX)
+			{
+				continue;
+			}
+
+			std::error_code ec;
+			switch (change.type)
+			{
+			case FileChangeType::Added:
+				if (std::filesystem::is_directory(change.path, ec))
+				{
+					AddDirectory(change.path, modIndex);
+				}
+				else
+				{
+					AddFile(change.path, modIndex);
+				}
+				break;
+
+			case FileChangeType::Removed:
+				if (m_directories.count(change.path.native()))
+				{
+					// Contents of a removed directory are gone with it, rebuild on next query
+					m_built = false;
+					return;
+				}
+				RemoveFile(change.path, modIndex);
+				break;
+
+			case FileChangeType::Modified:
+				// A directory removed and created again within the watcher's coalescing window arrives
+				// as a modification, its old contents may be gone and new ones unknown
+				if (std::filesystem::is_directory(change.path, ec))
+				{
+					RemoveDirectoryTree(change.path);
+					AddDirectory(change.path, modIndex);
+				}
+				break;
+
+			default:
+				break;
+			}
+		}
+	}
+
+private:
+	struct Provider
+	{
+		uint32_t modIndex;
+		std::vector<uint64_t> directories;	// Same file name can appear in several subdirectories of one mod
+	};
+
+	using Providers = std::vector<Provider>;
+
+	// Keys are already XXH3 hashes, no need to hash them again
+	struct IdentityHash
+	{
+		size_t operator()(uint64_t value) const { return (size_t)value; }
+	};
+
+	mutable std::shared_mutex m_mutex;
+	std::vector<ModFolder> m_mods;
+	std::unordered_map<uint64_t, Providers, IdentityHash> m_files;
+	std::unordered_map<std::filesystem::path::string_type, std::filesystem::file_time_type> m_directories;
+	std::filesystem::path m_database;
+	std::filesystem::file_time_type m_databaseTime{};
+	std::chrono::steady_clock::time_point m_lastValidation{};
+	bool m_built{ false };
+	bool m_watched{ false };
+
+	Providers const* Find(std::string_view fileName) const
+	{
+		auto it = m_files.find(HashFileName(fileName));
+		return it != m_files.end() ? &it->second : nullptr;
+	}
+
+	// Adding and removing are idempotent per directory, so overlapping watcher events can't skew the index
+	void AddFile(uint64_t hash, uint64_t directoryHash, uint32_t modIndex)
+	{
+		Providers& providers = m_files[hash];
+		auto it = std::lower_bound(providers.begin(), providers.end(), modIndex, [](Provider const& p, uint32_t i) { return p.modIndex < i; });
+		if (it == providers.end() || it->modIndex != modIndex)
+		{
+			it = providers.insert(it, { modIndex, {} });
+		}
+
+		if (std::find(it->directories.begin(), it->directories.end(), directoryHash) == it->directories.end())
+		{
+			it->directories.push_back(directoryHash);
+		}
+	}
+
+	void AddFile(std::filesystem::path const& path, uint32_t modIndex)
+	{
+		AddFile(HashNativeName(path.filename()), HashNativeName(path.parent_path()), modIndex);
+	}
+
+	void RemoveFile(std::filesystem::path const& path, uint32_t modIndex)
+	{
+		auto files = m_files.find(HashNativeName(path.filename()));
+		if (files == m_files.end())
+		{
+			return;
+		}
+
+		Providers& providers = files->second;
+		auto it = std::lower_bound(providers.begin(), providers.end(), modIndex, [](Provider const& p, uint32_t i) { return p.modIndex < i; });
+		if (it == providers.end() || it->modIndex != modIndex)
+		{
+			return;
+		}
+
+		auto directory = std::find(it->directories.begin(), it->directories.end(), HashNativeName(path.parent_path()));
+		if (directory != it->directories.end())
+		{
+			it->directories.erase(directory);
+		}
+
+		if (it->directories.empty())
+		{
+			providers.erase(it);
+			if (providers.empty())
+			{
+				m_files.erase(files);
+			}
+		}
+	}
+
+	void AddDirectory(std::filesystem::path const& directory, uint32_t modIndex)
+	{
+		std::error_code ec;
+		m_directories[directory.native()] = std::filesystem::last_write_time(directory, ec);
+		AddFile(directory, modIndex);
+		for (std::filesystem::recursive_directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec))
+		{
+			if (it->is_directory(ec))
+			{
+				m_directories[it->path().native()] = it->last_write_time(ec);
+			}
+			AddFile(it->path(), modIndex);
+		}
+	}
+
+	// Drops the directory, its subdirectories and every file in them
+	void RemoveDirectoryTree(std::filesystem::path const& directory)
+	{
+		std::unordered_set<uint64_t, IdentityHash> removed;
+		for (auto it = m_directories.begin(); it != m_directories.end();)
+		{
+			std::filesystem::path path = it->first;
+			auto mismatch = std::mismatch(directory.begin(), directory.end(), path.begin(), path.end());
+			if (mismatch.first == directory.end())
+			{
+				removed.insert(HashNativeName(std::basic_string_view<std::filesystem::path::value_type>(it->first)));
+				it = m_directories.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+
+		if (removed.empty())
+		{
+			return;
+		}
+
+		for (auto files = m_files.begin(); files != m_files.end();)
+		{
+			Providers& providers = files->second;
+			for (auto it = providers.begin(); it != providers.end();)
+			{
+				auto& directories = it->directories;
+				directories.erase(std::remove_if(directories.begin(), directories.end(), [&](uint64_t hash) { return removed.count(hash); }), directories.end());
+				it = directories.empty() ? providers.erase(it) : std::next(it);
+			}
+			files = providers.empty() ? m_files.erase(files) : std::next(files);
+		}
+	}
+
+	static bool IsSamePath(std::filesystem::path const& a, std::filesystem::path const& b)
+	{
+		std::error_code ec;
+		return std::filesystem::absolute(a, ec).lexically_normal() == std::filesystem::absolute(b, ec).lexically_normal();
+	}
+
+	// Mod folder containing this path, or UINT32_MAX
+	uint32_t FindMod(std::filesystem::path const& path) const
+	{
+		for (uint32_t i = 0; i < m_mods.size(); i++)
+		{
+			std::filesystem::path const& folder = m_mods[i].folder;
+			auto mismatch = std::mismatch(folder.begin(), folder.end(), path.begin(), path.end());
+			if (mismatch.first == folder.end() || (mismatch.first->empty() && std::next(mismatch.first) == folder.end()))
+			{
+				return i;
+			}
+		}
+		return UINT32_MAX;
+	}
+};
+
+} // namespace Common
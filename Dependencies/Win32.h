@@ -0,0 +1,14 @@
+#pragma once
+
+// <Windows.h> for the portable headers in Dependencies. NOMINMAX keeps the min/max macros from
+// breaking std::min and std::max in everything included after it. A no-op on other platforms.
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#endif
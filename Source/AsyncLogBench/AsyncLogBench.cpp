@@ -0,0 +1,249 @@
+// Stress benchmark for AsyncLog (Dependencies/Loaders/AsyncLog.h).
+// Several producer threads log as fast as they can through a handler that costs --handler-us per
+// message, once calling the handler synchronously like ModLoader::WriteLog and once through AsyncLog.
+// Reports the latency producers see per call, throughput and drops, then checks that oversized
+// messages and calls with many arguments reach the handler intact.
+//
+//   AsyncLogBench [--threads 4] [--messages 100000] [--handler-us 2] [--capacity 4096]
+
+#ifndef _WIN32
+#define __cdecl
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AsyncLog.h"
+
+struct Options
+{
+	size_t threads = 4;
+	size_t messages = 100000;
+	double handlerMicroseconds = 2.0;
+	size_t capacity = 4096;
+};
+
+using Clock = std::chrono::steady_clock;
+
+struct Handler
+{
+	std::chrono::nanoseconds cost;
+	std::atomic<uint64_t> count{ 0 };
+	std::atomic<uint64_t> checksum{ 0 };
+};
+
+// Stands in for a handler that formats and writes to disk
+static void ML_API SlowHandler(void* obj, int, int, const char* message, size_t p1, size_t, size_t*)
+{
+	Handler& handler = *static_cast<Handler*>(obj);
+	auto end = Clock::now() + handler.cost;
+	uint64_t sum = p1;
+	for (const char* c = message; *c; c++)
+	{
+		sum = sum * 31 + (unsigned char)*c;
+	}
+	while (Clock::now() < end)
+	{
+	}
+
+	handler.checksum.fetch_add(sum, std::memory_order_relaxed);
+	handler.count.fetch_add(1, std::memory_order_relaxed);
+}
+
+struct Result
+{
+	std::vector<uint64_t> latencies;	// Nanoseconds per call, every thread
+	double seconds;
+};
+
+template<typename TWrite>
+static Result Run(Options const& options, TWrite&& write)
+{
+	std::vector<std::vector<uint64_t>> latencies(options.threads);
+	std::atomic<bool> start{ false };
+	std::vector<std::thread> threads;
+	for (size_t t = 0; t < options.threads; t++)
+	{
+		threads.emplace_back([&, t]
+		{
+			latencies[t].reserve(options.messages);
+			while (!start.load(std::memory_order_acquire))
+			{
+			}
+
+			for (size_t i = 0; i < options.messages; i++)
+			{
+				auto before = Clock::now();
+				write("[Bench] thread %zu message %zu\n", t, i);
+				latencies[t].push_back((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - before).count());
+			}
+		});
+	}
+
+	auto begin = Clock::now();
+	start.store(true, std::memory_order_release);
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+
+	Result result;
+	result.seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+	for (auto& thread : latencies)
+	{
+		result.latencies.insert(result.latencies.end(), thread.begin(), thread.end());
+	}
+	std::sort(result.latencies.begin(), result.latencies.end());
+	return result;
+}
+
+static void Print(const char* name, Result const& result, uint64_t drops)
+{
+	auto percentile = [&](double p) { return result.latencies[std::min(result.latencies.size() - 1, (size_t)(result.latencies.size() * p))]; };
+	printf("%-12s p50 %7llu ns  p99 %7llu ns  p99.9 %8llu ns  max %9llu ns  %9.0f msg/s  dropped %llu\n", name,
+		(unsigned long long)percentile(0.5), (unsigned long long)percentile(0.99), (unsigned long long)percentile(0.999),
+		(unsigned long long)result.latencies.back(), result.latencies.size() / result.seconds, (unsigned long long)drops);
+}
+
+// Messages a ring cell can't hold must arrive whole
+static bool CheckOversized()
+{
+	struct Capture
+	{
+		std::string message;
+		std::string text;
+		std::vector<size_t> words;
+	} capture;
+
+	auto handler = [](void* obj, int, int, const char* message, size_t p1, size_t p2, size_t* parray)
+	{
+		Capture& capture = *static_cast<Capture*>(obj);
+		capture.message = message;
+		capture.text = reinterpret_cast<const char*>(p1);
+		capture.words = { p2 };
+		for (size_t i = 0; i < 10; i++)
+		{
+			capture.words.push_back(parray[i]);
+		}
+	};
+
+	std::string format = "%s" + std::string(300, '.');
+	for (size_t i = 0; i < 11; i++)
+	{
+		format += " %zu";
+	}
+
+	std::string text(1000, 'x');
+	std::vector<size_t> parray;
+	for (size_t i = 0; i < 10; i++)
+	{
+		parray.push_back(100 + i);
+	}
+
+	{
+		AsyncLog log(16);
+		log.AddHandler(&capture, handler);
+		std::string transient = text;
+		log.Write(ML_LOG_LEVEL_INFO, ML_LOG_CATEGORY_GENERAL, format.c_str(), reinterpret_cast<size_t>(transient.c_str()), 99, parray.data());
+		transient.assign(transient.size(), '?');
+		log.Flush();
+	}
+
+	bool words = capture.words.size() == 11 && capture.words[0] == 99;
+	for (size_t i = 0; words && i < 10; i++)
+	{
+		words = capture.words[i + 1] == parray[i];
+	}
+	return capture.message == format && capture.text == text && words;
+}
+
+static void PrintUsage()
+{
+	fprintf(stderr,
+		"Usage: AsyncLogBench [options]\n"
+		"  --threads <count>     Producer threads (default 4)\n"
+		"  --messages <count>    Messages per thread (default 100000)\n"
+		"  --handler-us <us>     Time the handler spends on each message (default 2)\n"
+		"  --capacity <count>    AsyncLog ring capacity (default 4096)\n");
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	for (int i = 1; i < argc; i++)
+	{
+		bool hasValue = i + 1 < argc;
+		if (!strcmp(argv[i], "--threads") && hasValue)
+		{
+			options.threads = std::max<size_t>(strtoull(argv[++i], nullptr, 10), 1);
+		}
+		else if (!strcmp(argv[i], "--messages") && hasValue)
+		{
+			options.messages = std::max<size_t>(strtoull(argv[++i], nullptr, 10), 1);
+		}
+		else if (!strcmp(argv[i], "--handler-us") && hasValue)
+		{
+			options.handlerMicroseconds = atof(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "--capacity") && hasValue)
+		{
+			options.capacity = strtoull(argv[++i], nullptr, 10);
+		}
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	auto cost = std::chrono::nanoseconds((int64_t)(options.handlerMicroseconds * 1000.0));
+	printf("%zu threads x %zu messages, handler %.1f us\n", options.threads, options.messages, options.handlerMicroseconds);
+
+	{
+		// ModLoader::WriteLog has no lock either, the handler runs on whichever thread logged
+		Handler handler;
+		handler.cost = cost;
+		Result result = Run(options, [&](const char* format, size_t p1, size_t p2)
+		{
+			SlowHandler(&handler, ML_LOG_LEVEL_INFO, ML_LOG_CATEGORY_GENERAL, format, p1, p2, nullptr);
+		});
+		Print("synchronous", result, 0);
+	}
+
+	{
+		Handler handler;
+		handler.cost = cost;
+		uint64_t drops;
+		{
+			AsyncLog log(options.capacity);
+			log.AddHandler(&handler, SlowHandler);
+			Result result = Run(options, [&](const char* format, size_t p1, size_t p2)
+			{
+				log.Write(ML_LOG_LEVEL_INFO, ML_LOG_CATEGORY_GENERAL, format, p1, p2, nullptr);
+			});
+			log.Flush();
+			drops = log.GetDropCount();
+			Print("AsyncLog", result, drops);
+		}
+
+		// Every message was either delivered or counted as dropped, plus one report per batch of drops
+		uint64_t delivered = handler.count.load();
+		uint64_t written = options.threads * options.messages;
+		if (delivered < written - drops || delivered > written - drops + written)
+		{
+			printf("delivery    MISMATCH, %llu delivered of %llu\n", (unsigned long long)delivered, (unsigned long long)written);
+			return 1;
+		}
+	}
+
+	bool oversized = CheckOversized();
+	printf("oversized   %s\n", oversized ? "intact" : "MISMATCH");
+	return oversized ? 0 : 1;
+}
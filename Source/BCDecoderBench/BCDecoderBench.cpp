@@ -0,0 +1,475 @@
+// Tests and benchmark for BCDecoder (Dependencies/DDSTextureLoader/BCDecoder.h).
+// Every check compares against a reference decoder written here straight from the BC1-BC5 format
+// description: bit by bit index extraction and palettes interpolated in floating point, rounded to
+// nearest. Checked are hand decoded blocks, --blocks random blocks of every format, surfaces whose
+// size isn't a multiple of 4 and a whole file with mips. Then every format is timed decoding square
+// surfaces from 256 up to --size and whole files with their mip chains, the sizes the loaders see.
+//
+//   BCDecoderBench [--blocks 1000000] [--size 2048] [--runs 5]
+//
+// Returns nonzero if any decode differs from the reference.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "BCDecoder.h"
+
+using Compression = DDSLayout::Compression;
+
+struct Options
+{
+	size_t blocks = 1000000;
+	uint32_t size = 2048;
+	size_t runs = 5;
+};
+
+static const Compression c_formats[] = { Compression::BC1, Compression::BC2, Compression::BC3, Compression::BC4, Compression::BC5 };
+
+static const char* GetName(Compression compression)
+{
+	switch (compression)
+	{
+	case Compression::BC1: return "BC1";
+	case Compression::BC2: return "BC2";
+	case Compression::BC3: return "BC3";
+	case Compression::BC4: return "BC4";
+	case Compression::BC5: return "BC5";
+	default: return "?";
+	}
+}
+
+static uint32_t GetBlockBytes(Compression compression)
+{
+	return compression == Compression::BC1 || compression == Compression::BC4 ? 8 : 16;
+}
+
+namespace Reference
+{
+
+static uint32_t GetBits(const uint8_t* data, uint32_t offset, uint32_t count)
+{
+	uint32_t value = 0;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t bit = offset + i;
+		value |= (uint32_t)((data[bit / 8] >> (bit % 8)) & 1) << i;
+	}
+	return value;
+}
+
+static uint8_t Round(double value)
+{
+	return (uint8_t)std::floor(value + 0.5);
+}
+
+struct Color
+{
+	uint8_t r, g, b, a;
+};
+
+// 565 endpoints are UNORM values, interpolated unrounded and converted to 8 bits once
+static Color ColorAt(const uint8_t* block, bool punchThrough, uint32_t pixel)
+{
+	uint32_t value0 = GetBits(block, 0, 16), value1 = GetBits(block, 16, 16);
+	uint32_t index = GetBits(block, 32 + 2 * pixel, 2);
+
+	bool fourColors = !punchThrough || value0 > value1;
+	double weight1;
+	switch (index)
+	{
+	case 0: weight1 = 0.0; break;
+	case 1: weight1 = 1.0; break;
+	case 2: weight1 = fourColors ? 1.0 / 3.0 : 0.5; break;
+	default:
+		if (!fourColors)
+		{
+			return { 0, 0, 0, 0 };
+		}
+		weight1 = 2.0 / 3.0;
+		break;
+	}
+
+	auto channel = [&](uint32_t shift, uint32_t bits)
+	{
+		// Interpolating before normalizing keeps the halfway BC1 entries exact, 127.5 rounds up
+		double maximum = (1 << bits) - 1;
+		double value = GetBits(block, shift, bits) * (1.0 - weight1) + GetBits(block, 16 + shift, bits) * weight1;
+		return Round(value / maximum * 255.0);
+	};
+
+	return { channel(11, 5), channel(5, 6), channel(0, 5), 255 };
+}
+
+static uint8_t ChannelAt(const uint8_t* block, uint32_t pixel)
+{
+	double value0 = GetBits(block, 0, 8), value1 = GetBits(block, 8, 8);
+	uint32_t index = GetBits(block, 16 + 3 * pixel, 3);
+	if (index < 2)
+	{
+		return (uint8_t)(index ? value1 : value0);
+	}
+
+	if (value0 > value1)
+	{
+		return Round(value0 + (value1 - value0) * (index - 1) / 7.0);
+	}
+
+	if (index >= 6)
+	{
+		return index == 6 ? 0 : 255;
+	}
+	return Round(value0 + (value1 - value0) * (index - 1) / 5.0);
+}
+
+// Pixel of a block in the decoder's output format, B8G8R8A8 or R8
+static void DecodePixel(Compression compression, const uint8_t* block, uint32_t pixel, uint8_t* output)
+{
+	Color color{};
+	switch (compression)
+	{
+	case Compression::BC1:
+		color = ColorAt(block, true, pixel);
+		break;
+	case Compression::BC2:
+		color = ColorAt(block + 8, false, pixel);
+		color.a = (uint8_t)(GetBits(block, 4 * pixel, 4) * 255 / 15);
+		break;
+	case Compression::BC3:
+		color = ColorAt(block + 8, false, pixel);
+		color.a = ChannelAt(block, pixel);
+		break;
+	case Compression::BC4:
+		output[0] = ChannelAt(block, pixel);
+		return;
+	case Compression::BC5:
+		color = { ChannelAt(block, pixel), ChannelAt(block + 8, pixel), 0, 255 };
+		break;
+	default:
+		return;
+	}
+
+	output[0] = color.b;
+	output[1] = color.g;
+	output[2] = color.r;
+	output[3] = color.a;
+}
+
+static void DecodeSurface(Compression compression, const uint8_t* source, uint32_t width, uint32_t height, uint8_t* output)
+{
+	uint32_t bytes = BCDecoder::GetOutputBytes(compression);
+	uint32_t blocksWide = (width + 3) / 4;
+	for (uint32_t y = 0; y < height; y++)
+	{
+		for (uint32_t x = 0; x < width; x++)
+		{
+			const uint8_t* block = source + ((size_t)(y / 4) * blocksWide + x / 4) * GetBlockBytes(compression);
+			DecodePixel(compression, block, (y % 4) * 4 + x % 4, output + ((size_t)y * width + x) * bytes);
+		}
+	}
+}
+
+} // namespace Reference
+
+static size_t g_failures = 0;
+
+static void Report(bool success, const char* format, ...)
+{
+	if (!success)
+	{
+		g_failures++;
+		if (g_failures > 20)
+		{
+			return;
+		}
+	}
+
+	va_list arguments;
+	va_start(arguments, format);
+	printf("%-8s", success ? "ok" : "FAILED");
+	vprintf(format, arguments);
+	printf("\n");
+	va_end(arguments);
+}
+
+// Blocks decoded by hand, independent of both decoders
+static void CheckKnownBlocks()
+{
+	struct KnownBlock
+	{
+		Compression compression;
+		uint8_t block[16];
+		uint8_t row[16];		// First row of the decoded block
+		const char* name;
+	};
+
+	const KnownBlock blocks[] =
+	{
+		{ Compression::BC1, { 0xFF, 0xFF, 0x00, 0x00, 0xE4, 0xE4, 0xE4, 0xE4 },
+			{ 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0xFF, 0xAA, 0xAA, 0xAA, 0xFF, 0x55, 0x55, 0x55, 0xFF }, "BC1 white to black" },
+		{ Compression::BC1, { 0x00, 0x00, 0xFF, 0xFF, 0xE4, 0xE4, 0xE4, 0xE4 },
+			{ 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x80, 0x80, 0x80, 0xFF, 0x00, 0x00, 0x00, 0x00 }, "BC1 punch through" },
+		{ Compression::BC1, { 0x00, 0xF8, 0x1F, 0x00, 0x00, 0x00, 0x00, 0x00 },
+			{ 0x00, 0x00, 0xFF, 0xFF, 0x00, 0x00, 0xFF, 0xFF, 0x00, 0x00, 0xFF, 0xFF, 0x00, 0x00, 0xFF, 0xFF }, "BC1 solid red" },
+		{ Compression::BC4, { 0xFF, 0x00, 0x88, 0xC6, 0xFA },
+			{ 0xFF, 0x00, 0xDB, 0xB6 }, "BC4 eight values" },
+		{ Compression::BC4, { 0x00, 0xFF, 0x88, 0xC6, 0xFA },
+			{ 0x00, 0xFF, 0x33, 0x66 }, "BC4 six values" },
+		{ Compression::BC2, { 0x0F, 0xF0, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF, 0xFF, 0xFF, 0, 0, 0, 0 },
+			{ 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0xFF, 0xFF, 0xFF, 0x00, 0xFF, 0xFF, 0xFF, 0xFF }, "BC2 explicit alpha" },
+	};
+
+	for (KnownBlock const& known : blocks)
+	{
+		uint32_t bytes = BCDecoder::GetOutputBytes(known.compression);
+		uint8_t decoded[64], reference[64];
+		BCDecoder::DecodeBlock(known.compression, known.block, decoded, 4 * bytes);
+		for (uint32_t pixel = 0; pixel < 16; pixel++)
+		{
+			Reference::DecodePixel(known.compression, known.block, pixel, reference + pixel * bytes);
+		}
+
+		bool success = !memcmp(decoded, known.row, 4 * bytes) && !memcmp(reference, known.row, 4 * bytes);
+		Report(success, "%s", known.name);
+	}
+}
+
+static void CheckRandomBlocks(size_t count, std::mt19937& random)
+{
+	for (Compression compression : c_formats)
+	{
+		uint32_t bytes = BCDecoder::GetOutputBytes(compression);
+		size_t mismatches = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			uint8_t block[16];
+			for (uint8_t& value : block)
+			{
+				value = (uint8_t)random();
+			}
+
+			// Equal endpoints are the edge case of both palette modes
+			if (i % 16 == 0)
+			{
+				memcpy(block + (compression == Compression::BC1 ? 2 : 1), block, compression == Compression::BC1 ? 2 : 1);
+				if (compression == Compression::BC2 || compression == Compression::BC3)
+				{
+					memcpy(block + 10, block + 8, 2);
+				}
+			}
+
+			uint8_t decoded[64], reference[64];
+			BCDecoder::DecodeBlock(compression, block, decoded, 4 * bytes);
+			for (uint32_t pixel = 0; pixel < 16; pixel++)
+			{
+				Reference::DecodePixel(compression, block, pixel, reference + pixel * bytes);
+			}
+
+			mismatches += memcmp(decoded, reference, 16 * bytes) != 0;
+		}
+
+		Report(mismatches == 0, "%s %zu random blocks, %zu differ", GetName(compression), count, mismatches);
+	}
+}
+
+static std::vector<uint8_t> RandomBlocks(Compression compression, uint32_t width, uint32_t height, std::mt19937& random)
+{
+	std::vector<uint8_t> data((size_t)((width + 3) / 4) * ((height + 3) / 4) * GetBlockBytes(compression));
+	for (uint8_t& value : data)
+	{
+		value = (uint8_t)random();
+	}
+	return data;
+}
+
+static void CheckSurfaces(std::mt19937& random)
+{
+	const uint32_t sizes[][2] = { { 1, 1 }, { 2, 7 }, { 5, 3 }, { 30, 18 }, { 64, 64 }, { 129, 67 } };
+	for (Compression compression : c_formats)
+	{
+		uint32_t bytes = BCDecoder::GetOutputBytes(compression);
+		bool success = true;
+		for (auto const& size : sizes)
+		{
+			std::vector<uint8_t> source = RandomBlocks(compression, size[0], size[1], random);
+			std::vector<uint8_t> decoded((size_t)size[0] * size[1] * bytes), reference(decoded.size());
+			BCDecoder::DecodeSurface(compression, source.data(), size[0], size[1], decoded.data(), (size_t)size[0] * bytes);
+			Reference::DecodeSurface(compression, source.data(), size[0], size[1], reference.data());
+			success &= decoded == reference;
+		}
+
+		Report(success, "%s surfaces of odd sizes", GetName(compression));
+	}
+}
+
+// A DX10 file of random blocks with arraySize items of mipCount mips
+static std::vector<uint8_t> RandomFile(Compression compression, uint32_t width, uint32_t height, uint32_t mipCount, uint32_t arraySize, std::mt19937& random)
+{
+	uint32_t dxgiFormat = compression == Compression::BC1 ? 71 : compression == Compression::BC2 ? 74 : compression == Compression::BC3 ? 77 : compression == Compression::BC4 ? 80 : 83;
+
+	DDSLayout::Header header{};
+	header.size = sizeof(header);
+	header.width = width;
+	header.height = height;
+	header.mipMapCount = mipCount;
+	header.ddspf.size = sizeof(DDSLayout::PixelFormat);
+	header.ddspf.flags = DDSLayout::c_fourCCFlag;
+	header.ddspf.fourCC = DDSLayout::MakeFourCC('D', 'X', '1', '0');
+	DDSLayout::HeaderDXT10 dxt10{ dxgiFormat, 3, 0, arraySize, 0 };
+
+	std::vector<uint8_t> file(sizeof(uint32_t) + sizeof(header) + sizeof(dxt10));
+	memcpy(file.data(), &DDSLayout::c_magic, sizeof(uint32_t));
+	memcpy(file.data() + sizeof(uint32_t), &header, sizeof(header));
+	memcpy(file.data() + sizeof(uint32_t) + sizeof(header), &dxt10, sizeof(dxt10));
+
+	DDSLayout probe;
+	probe.compression = compression;
+	uint64_t dataSize = 0;
+	for (uint32_t mip = 0, w = header.width, h = header.height; mip < header.mipMapCount; mip++, w = std::max<uint32_t>(w >> 1, 1), h = std::max<uint32_t>(h >> 1, 1))
+	{
+		uint32_t rowPitch, rowCount;
+		probe.GetSurfaceInfo(w, h, rowPitch, rowCount);
+		dataSize += (uint64_t)rowPitch * rowCount;
+	}
+
+	for (uint64_t i = 0; i < dataSize * dxt10.arraySize; i++)
+	{
+		file.push_back((uint8_t)random());
+	}
+	return file;
+}
+
+static uint32_t GetMipCount(uint32_t width, uint32_t height)
+{
+	uint32_t count = 1;
+	while (width > 1 || height > 1)
+	{
+		width = std::max<uint32_t>(width >> 1, 1);
+		height = std::max<uint32_t>(height >> 1, 1);
+		count++;
+	}
+	return count;
+}
+
+// A file with a full mip chain, two array items, width and height not multiples of 4
+static void CheckFile(std::mt19937& random)
+{
+	for (Compression compression : c_formats)
+	{
+		std::vector<uint8_t> file = RandomFile(compression, 90, 46, 7, 2, random);
+
+		DDSLayout layout;
+		std::vector<uint8_t> decoded;
+		bool success = layout.Parse(file.data(), file.size()) && BCDecoder::Decode(layout, file.data(), decoded);
+
+		uint32_t bytes = BCDecoder::GetOutputBytes(compression);
+		size_t offset = 0;
+		for (size_t i = 0; success && i < layout.subresources.size(); i++)
+		{
+			DDSLayout::Subresource const& subresource = layout.subresources[i];
+			std::vector<uint8_t> reference((size_t)subresource.width * subresource.height * bytes);
+			Reference::DecodeSurface(compression, file.data() + subresource.offset, subresource.width, subresource.height, reference.data());
+			success = offset + reference.size() <= decoded.size() && !memcmp(decoded.data() + offset, reference.data(), reference.size());
+			offset += reference.size();
+		}
+
+		Report(success && offset == decoded.size(), "%s file with 2 items of 7 mips", GetName(compression));
+	}
+}
+
+template<typename T>
+static double BestOf(size_t runs, T&& function)
+{
+	double best = 0;
+	for (size_t run = 0; run < runs; run++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		function();
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		best = run == 0 ? seconds : std::min<double>(best, seconds);
+	}
+	return best;
+}
+
+static void Benchmark(Options const& options, std::mt19937& random)
+{
+	printf("\nDecodeSurface of the top mip and Decode of the whole file with mips, best of %zu runs\n", options.runs);
+	printf("size      format   DecodeSurface     Decode\n");
+
+	for (uint32_t size = std::min<uint32_t>(256, options.size); size <= options.size; size *= 2)
+	{
+		double megapixels = (double)size * size / 1e6;
+		for (Compression compression : c_formats)
+		{
+			uint32_t bytes = BCDecoder::GetOutputBytes(compression);
+			std::vector<uint8_t> source = RandomBlocks(compression, size, size, random);
+			std::vector<uint8_t> output((size_t)size * size * bytes);
+			size_t pitch = (size_t)size * bytes;
+			double surface = BestOf(options.runs, [&] { BCDecoder::DecodeSurface(compression, source.data(), size, size, output.data(), pitch); });
+
+			std::vector<uint8_t> file = RandomFile(compression, size, size, GetMipCount(size, size), 1, random);
+			DDSLayout layout;
+			layout.Parse(file.data(), file.size());
+			std::vector<uint8_t> decoded;
+			double whole = BestOf(options.runs, [&] { BCDecoder::Decode(layout, file.data(), decoded); });
+
+			printf("%-9u %-8s %8.1f MP/s     %8.2f ms\n", size, GetName(compression), megapixels / surface, whole * 1000.0);
+		}
+	}
+}
+
+static void PrintUsage()
+{
+	fprintf(stderr,
+		"Usage: BCDecoderBench [options]\n"
+		"  --blocks <count>   Random blocks checked per format (default 1000000)\n"
+		"  --size <pixels>    Largest timed width and height, a multiple of 4 (default 2048)\n"
+		"  --runs <count>     Timed runs per format, the best is reported (default 5)\n");
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	for (int i = 1; i < argc; i++)
+	{
+		bool hasValue = i + 1 < argc;
+		if (!strcmp(argv[i], "--blocks") && hasValue)
+		{
+			options.blocks = strtoull(argv[++i], nullptr, 10);
+		}
+		else if (!strcmp(argv[i], "--size") && hasValue)
+		{
+			options.size = std::max<uint32_t>((uint32_t)strtoul(argv[++i], nullptr, 10) & ~3u, 4);
+		}
+		else if (!strcmp(argv[i], "--runs") && hasValue)
+		{
+			options.runs = std::max<size_t>(strtoull(argv[++i], nullptr, 10), 1);
+		}
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	std::mt19937 random(46);
+	CheckKnownBlocks();
+	CheckRandomBlocks(options.blocks, random);
+	CheckSurfaces(random);
+	CheckFile(random);
+	Benchmark(options, random);
+
+	if (g_failures)
+	{
+		printf("\n%zu checks failed\n", g_failures);
+		return 1;
+	}
+	return 0;
+}
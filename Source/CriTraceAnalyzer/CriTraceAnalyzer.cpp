@@ -0,0 +1,409 @@
+// Offline analyzer for CRI load traces (Dependencies/Loaders/CriLoadTrace.h).
+// Replays every stage's loads against a seek/throughput disk model, proposes a packing layout
+// that keeps each stage's files contiguous and in load order, and reports the projected savings.
+//
+//   CriTraceAnalyzer [--seek-ms 8] [--mbps 120] [--gap-kb 256] [--layout layout.txt] trace.bin...
+//
+// Also accepts text traces, one load per line: <timestamp us> <offset> <size> <path>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "CriLoadTrace.h"
+
+struct Access
+{
+	uint64_t time;			// Nanoseconds
+	std::string stage;
+	std::string path;
+	uint64_t container;		// Archive the data lives in, a loose file is a container of its own
+	uint64_t position;		// Byte position within the container
+	uint64_t offset;		// Requested offset within the file
+	uint64_t bytes;			// Bytes read from disk
+	uint64_t fileSize;		// On disk size of the whole file
+};
+
+struct DiskModel
+{
+	double seekMilliseconds = 8.0;
+	double bytesPerMillisecond = 120.0 * 1024 * 1024 / 1000.0;
+	uint64_t maxGap = 256 * 1024;		// Forward gaps up to this are read through instead of seeking
+
+	struct Head
+	{
+		uint64_t container = UINT64_MAX;
+		uint64_t position = 0;
+	};
+
+	double Read(Head& head, uint64_t container, uint64_t position, uint64_t bytes) const
+	{
+		double milliseconds = bytes / bytesPerMillisecond;
+		if (container == head.container && position >= head.position && position - head.position <= maxGap)
+		{
+			milliseconds += (position - head.position) / bytesPerMillisecond;
+		}
+		else
+		{
+			milliseconds += seekMilliseconds;
+		}
+
+		head = { container, position + bytes };
+		return milliseconds;
+	}
+};
+
+static bool ReadBinaryTrace(const char* path, uint64_t traceIndex, std::vector<Access>& accesses)
+{
+	CriTrace::Trace trace;
+	if (!trace.Read(path))
+	{
+		return false;
+	}
+
+	std::unordered_map<std::string, uint64_t> looseFiles;
+	for (CriTrace::TraceLoadRecord const& record : trace.loads)
+	{
+		if (record.status != (uint32_t)CriTrace::LoadStatus::Complete)
+		{
+			continue;
+		}
+
+		Access access{};
+		access.time = record.issueTime;
+		access.stage = record.stageId == UINT32_MAX ? "(no stage)" : trace.GetString(record.stageId);
+		access.path = trace.GetString(record.pathId);
+		access.offset = (uint64_t)std::max<int64_t>(record.offset, 0);
+
+		// CriFsBinderFileInfo: offset is where the file starts in its binder, read_size what's stored on disk,
+		// extract_size what it decompresses to. Compressed files are always read whole.
+		bool packed = (record.flags & CriTrace::LoadFlags_Found) && !(record.flags & CriTrace::LoadFlags_ModBinder);
+		if (record.flags & CriTrace::LoadFlags_Found)
+		{
+			access.fileSize = (uint64_t)std::max<int64_t>(record.readSize, 0);
+			bool compressed = record.extractSize > record.readSize;
+			access.bytes = compressed ? access.fileSize : std::min(access.fileSize - std::min(access.offset, access.fileSize), (uint64_t)std::max<int64_t>(record.loadSize, 0));
+			access.offset = compressed ? 0 : access.offset;
+		}
+		else
+		{
+			access.bytes = (uint64_t)std::max<int64_t>(record.loadSize, 0);
+			access.fileSize = access.offset + access.bytes;
+		}
+
+		if (packed)
+		{
+			access.container = (traceIndex << 32) | record.binderId;
+			access.position = (uint64_t)record.fileOffset + access.offset;
+		}
+		else
+		{
+			auto it = looseFiles.emplace(access.path, looseFiles.size()).first;
+			access.container = (1ull << 63) | (traceIndex << 32) | it->second;
+			access.position = access.offset;
+		}
+
+		accesses.push_back(std::move(access));
+	}
+
+	return true;
+}
+
+static bool ReadTextTrace(const char* path, std::vector<Access>& accesses)
+{
+	std::ifstream stream(path);
+	if (!stream)
+	{
+		return false;
+	}
+
+	std::unordered_map<std::string, uint64_t> looseFiles;
+	std::string stage = "(no stage)";
+	std::string line;
+	while (std::getline(stream, line))
+	{
+		// "# stage <name>" switches stages
+		if (line.rfind("# stage ", 0) == 0)
+		{
+			stage = line.substr(8);
+			continue;
+		}
+
+		unsigned long long time, offset, size;
+		int consumed = 0;
+		if (line.empty() || line[0] == '#' || sscanf(line.c_str(), "%llu %llu %llu %n", &time, &offset, &size, &consumed) != 3)
+		{
+			continue;
+		}
+
+		Access access{};
+		access.time = time * 1000;
+		access.stage = stage;
+		access.path = line.substr(consumed);
+		access.container = (1ull << 63) | (1ull << 62) | looseFiles.emplace(access.path, looseFiles.size()).first->second;
+		access.offset = offset;
+		access.position = offset;
+		access.bytes = size;
+		access.fileSize = offset + size;
+		accesses.push_back(std::move(access));
+	}
+
+	return true;
+}
+
+static bool IsBinaryTrace(const char* path)
+{
+	uint32_t magic = 0;
+	FILE* file = fopen(path, "rb");
+	if (!file)
+	{
+		return false;
+	}
+
+	bool binary = fread(&magic, sizeof(magic), 1, file) == 1 && magic == CriTrace::c_magic;
+	fclose(file);
+	return binary;
+}
+
+struct Layout
+{
+	struct Group
+	{
+		std::set<std::string> stages;
+		std::vector<std::string> files;
+		uint64_t size = 0;
+	};
+
+	std::vector<Group> groups;
+	std::unordered_map<std::string, std::pair<uint64_t, uint64_t>> placement;		// Path to group and position
+};
+
+// Files are grouped by the exact set of stages loading them, so a stage never reads past data it
+// doesn't need. Within a group files follow the order the earliest of those stages first loaded them.
+static Layout ProposeLayout(std::map<std::string, std::vector<Access>> const& stages)
+{
+	struct FileInfo
+	{
+		std::set<std::string> stages;
+		uint64_t size = 0;
+		std::pair<uint64_t, uint64_t> firstUse{ UINT64_MAX, UINT64_MAX };	// Stage order, access order
+	};
+
+	std::unordered_map<std::string, FileInfo> files;
+	uint64_t stageIndex = 0;
+	for (auto const& [stage, accesses] : stages)
+	{
+		for (size_t i = 0; i < accesses.size(); i++)
+		{
+			FileInfo& file = files[accesses[i].path];
+			file.stages.insert(stage);
+			file.size = std::max(file.size, accesses[i].fileSize);
+			file.firstUse = std::min(file.firstUse, std::make_pair(stageIndex, (uint64_t)i));
+		}
+		stageIndex++;
+	}
+
+	std::map<std::set<std::string>, std::vector<std::pair<std::pair<uint64_t, uint64_t>, std::string>>> grouped;
+	for (auto const& [path, file] : files)
+	{
+		grouped[file.stages].push_back({ file.firstUse, path });
+	}
+
+	Layout layout;
+	for (auto& [stageSet, members] : grouped)
+	{
+		std::sort(members.begin(), members.end());
+
+		Layout::Group group;
+		group.stages = stageSet;
+		for (auto const& [order, path] : members)
+		{
+			layout.placement[path] = { layout.groups.size(), group.size };
+			group.files.push_back(path);
+			group.size += files[path].size;
+		}
+		layout.groups.push_back(std::move(group));
+	}
+
+	// Groups shared by the most stages first
+	std::vector<size_t> order(layout.groups.size());
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		order[i] = i;
+	}
+
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return layout.groups[a].stages.size() > layout.groups[b].stages.size(); });
+
+	Layout sorted;
+	for (size_t index : order)
+	{
+		for (std::string const& path : layout.groups[index].files)
+		{
+			sorted.placement[path] = { sorted.groups.size(), layout.placement[path].second };
+		}
+		sorted.groups.push_back(std::move(layout.groups[index]));
+	}
+
+	return sorted;
+}
+
+static double Simulate(DiskModel const& model, std::vector<Access> const& accesses, Layout const* layout)
+{
+	DiskModel::Head head;
+	double milliseconds = 0.0;
+	for (Access const& access : accesses)
+	{
+		if (layout)
+		{
+			auto const& [group, position] = layout->placement.at(access.path);
+			milliseconds += model.Read(head, group, position + access.offset, access.bytes);
+		}
+		else
+		{
+			milliseconds += model.Read(head, access.container, access.position, access.bytes);
+		}
+	}
+	return milliseconds;
+}
+
+static void PrintUsage()
+{
+	fprintf(stderr,
+		"Usage: CriTraceAnalyzer [options] trace...\n"
+		"  --seek-ms <ms>      Average seek time (default 8)\n"
+		"  --mbps <MB/s>       Sequential throughput (default 120)\n"
+		"  --gap-kb <KB>       Largest forward gap read through instead of seeking (default 256)\n"
+		"  --layout <file>     Write the proposed file order, one group per block\n");
+}
+
+int main(int argc, char** argv)
+{
+	DiskModel model;
+	const char* layoutPath = nullptr;
+	std::vector<const char*> traces;
+
+	for (int i = 1; i < argc; i++)
+	{
+		bool hasValue = i + 1 < argc;
+		if (!strcmp(argv[i], "--seek-ms") && hasValue)
+		{
+			model.seekMilliseconds = atof(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "--mbps") && hasValue)
+		{
+			model.bytesPerMillisecond = atof(argv[++i]) * 1024 * 1024 / 1000.0;
+		}
+		else if (!strcmp(argv[i], "--gap-kb") && hasValue)
+		{
+			model.maxGap = strtoull(argv[++i], nullptr, 10) * 1024;
+		}
+		else if (!strcmp(argv[i], "--layout") && hasValue)
+		{
+			layoutPath = argv[++i];
+		}
+		else if (argv[i][0] == '-')
+		{
+			PrintUsage();
+			return 1;
+		}
+		else
+		{
+			traces.push_back(argv[i]);
+		}
+	}
+
+	if (traces.empty() || model.bytesPerMillisecond <= 0.0)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	std::vector<Access> accesses;
+	for (size_t i = 0; i < traces.size(); i++)
+	{
+		bool success = IsBinaryTrace(traces[i]) ? ReadBinaryTrace(traces[i], i, accesses) : ReadTextTrace(traces[i], accesses);
+		if (!success)
+		{
+			fprintf(stderr, "Failed to read %s\n", traces[i]);
+			return 1;
+		}
+	}
+
+	std::map<std::string, std::vector<Access>> stages;
+	for (Access& access : accesses)
+	{
+		stages[access.stage].push_back(std::move(access));
+	}
+
+	for (auto& [stage, stageAccesses] : stages)
+	{
+		std::stable_sort(stageAccesses.begin(), stageAccesses.end(), [](Access const& a, Access const& b) { return a.time < b.time; });
+	}
+
+	Layout layout = ProposeLayout(stages);
+
+	printf("%-32s %8s %12s %12s %12s %8s\n", "Stage", "Loads", "MB read", "Current ms", "Packed ms", "Saved");
+	double totalCurrent = 0.0, totalPacked = 0.0;
+	for (auto const& [stage, stageAccesses] : stages)
+	{
+		uint64_t bytes = 0;
+		for (Access const& access : stageAccesses)
+		{
+			bytes += access.bytes;
+		}
+
+		double current = Simulate(model, stageAccesses, nullptr);
+		double packed = Simulate(model, stageAccesses, &layout);
+		totalCurrent += current;
+		totalPacked += packed;
+
+		printf("%-32.32s %8zu %12.2f %12.1f %12.1f %7.1f%%\n", stage.c_str(), stageAccesses.size(), bytes / (1024.0 * 1024.0),
+			current, packed, current > 0.0 ? (current - packed) * 100.0 / current : 0.0);
+	}
+
+	printf("%-32s %8s %12s %12.1f %12.1f %7.1f%%\n", "Total", "", "", totalCurrent, totalPacked,
+		totalCurrent > 0.0 ? (totalCurrent - totalPacked) * 100.0 / totalCurrent : 0.0);
+
+	printf("\n%zu groups proposed\n", layout.groups.size());
+	for (size_t i = 0; i < layout.groups.size(); i++)
+	{
+		Layout::Group const& group = layout.groups[i];
+		std::string stageList;
+		for (std::string const& stage : group.stages)
+		{
+			stageList += stageList.empty() ? stage : ", " + stage;
+		}
+
+		printf("  group %zu: %zu files, %.2f MB, loaded by %s\n", i, group.files.size(), group.size / (1024.0 * 1024.0), stageList.c_str());
+	}
+
+	if (layoutPath)
+	{
+		std::ofstream stream(layoutPath, std::ios::trunc);
+		for (size_t i = 0; i < layout.groups.size(); i++)
+		{
+			stream << "[group " << i << "]\n";
+			for (std::string const& path : layout.groups[i].files)
+			{
+				stream << path << '\n';
+			}
+			stream << '\n';
+		}
+
+		if (!stream)
+		{
+			fprintf(stderr, "Failed to write %s\n", layoutPath);
+			return 1;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,250 @@
+// Packs DDS files into .dds.lz4 containers read by DDSTextureLoader9/11 and DDSTextureStreamer.
+//
+//   DDSLz4Packer [-l level] [--min-saving percent] [--keep] file-or-directory...
+//   DDSLz4Packer -d file.dds.lz4...
+//
+// Directories are searched recursively for .dds files. A file is only replaced by its container
+// when that saves at least --min-saving percent (default 10), small or already dense textures
+// aren't worth the decompression. Every container is decompressed and compared before it's kept.
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "DDSLayout.h"
+#include "DDSLz4.h"
+
+struct Options
+{
+	int level = LZ4HC_CLEVEL_DEFAULT;
+	double minSaving = 10.0;
+	bool keep = false;
+	bool unpack = false;
+};
+
+static bool ReadFile(std::filesystem::path const& path, std::vector<uint8_t>& data)
+{
+	std::ifstream stream(path, std::ios::binary | std::ios::ate);
+	if (!stream)
+	{
+		return false;
+	}
+
+	data.resize((size_t)stream.tellg());
+	stream.seekg(0);
+	stream.read(reinterpret_cast<char*>(data.data()), (std::streamsize)data.size());
+	return (bool)stream;
+}
+
+static bool WriteFile(std::filesystem::path const& path, std::vector<uint8_t> const& data)
+{
+	std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+	stream.write(reinterpret_cast<const char*>(data.data()), (std::streamsize)data.size());
+	return (bool)stream;
+}
+
+static bool Unpack(std::vector<uint8_t> const& packed, std::vector<uint8_t>& output)
+{
+	size_t size = DDSLz4::GetContentSize(packed.data(), packed.size());
+	if (!size)
+	{
+		return false;
+	}
+
+	output.resize(size);
+	return DDSLz4::Decompress(packed.data(), packed.size(), output.data(), output.size());
+}
+
+// Returns false on errors, skipped files are not errors
+static bool PackFile(std::filesystem::path const& path, Options const& options, uint64_t& inputTotal, uint64_t& outputTotal)
+{
+	std::vector<uint8_t> data;
+	if (!ReadFile(path, data))
+	{
+		fprintf(stderr, "%s: failed to read\n", path.string().c_str());
+		return false;
+	}
+
+	uint32_t magic = 0;
+	memcpy(&magic, data.data(), std::min(data.size(), sizeof(magic)));
+	if (magic != DDSLayout::c_magic)
+	{
+		fprintf(stderr, "%s: not a DDS file\n", path.string().c_str());
+		return false;
+	}
+
+	std::vector<uint8_t> packed, verify;
+	if (!DDSLz4::Compress(data.data(), data.size(), packed, options.level) || !Unpack(packed, verify) || verify != data)
+	{
+		fprintf(stderr, "%s: compression failed\n", path.string().c_str());
+		return false;
+	}
+
+	double saving = 100.0 - packed.size() * 100.0 / data.size();
+	inputTotal += data.size();
+	if (saving < options.minSaving)
+	{
+		printf("%s: skipped, %.1f%% smaller\n", path.string().c_str(), saving);
+		outputTotal += data.size();
+		return true;
+	}
+
+	std::filesystem::path output = path;
+	output += ".lz4";
+	if (!WriteFile(output, packed))
+	{
+		fprintf(stderr, "%s: failed to write\n", output.string().c_str());
+		return false;
+	}
+
+	std::error_code ec;
+	if (!options.keep)
+	{
+		std::filesystem::remove(path, ec);
+	}
+
+	printf("%s: %zu -> %zu bytes, %.1f%% smaller\n", path.string().c_str(), data.size(), packed.size(), saving);
+	outputTotal += packed.size();
+	return true;
+}
+
+static bool UnpackFile(std::filesystem::path const& path, Options const& options)
+{
+	std::vector<uint8_t> packed, data;
+	if (!ReadFile(path, packed) || !DDSLz4::IsFrame(packed.data(), packed.size()) || !Unpack(packed, data))
+	{
+		fprintf(stderr, "%s: not a valid .dds.lz4 container\n", path.string().c_str());
+		return false;
+	}
+
+	std::filesystem::path output = path;
+	output.replace_extension();
+	if (!WriteFile(output, data))
+	{
+		fprintf(stderr, "%s: failed to write\n", output.string().c_str());
+		return false;
+	}
+
+	std::error_code ec;
+	if (!options.keep)
+	{
+		std::filesystem::remove(path, ec);
+	}
+
+	printf("%s -> %s\n", path.string().c_str(), output.string().c_str());
+	return true;
+}
+
+static bool HasExtension(std::filesystem::path const& path, const char* extension)
+{
+	std::string name = path.filename().string();
+	size_t length = strlen(extension);
+	if (name.size() < length)
+	{
+		return false;
+	}
+
+	for (size_t i = 0; i < length; i++)
+	{
+		if (tolower((unsigned char)name[name.size() - length + i]) != extension[i])
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static void PrintUsage()
+{
+	fprintf(stderr,
+		"Usage: DDSLz4Packer [options] file-or-directory...\n"
+		"  -l <level>            lz4hc level 1-12, 0 for the fast compressor (default 9)\n"
+		"  --min-saving <pct>    Leave files that shrink less than this (default 10)\n"
+		"  --keep                Keep the input files\n"
+		"  -d                    Unpack .dds.lz4 containers instead\n");
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	std::vector<std::filesystem::path> inputs;
+
+	for (int i = 1; i < argc; i++)
+	{
+		bool hasValue = i + 1 < argc;
+		if (!strcmp(argv[i], "-l") && hasValue)
+		{
+			options.level = atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "--min-saving") && hasValue)
+		{
+			options.minSaving = atof(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "--keep"))
+		{
+			options.keep = true;
+		}
+		else if (!strcmp(argv[i], "-d"))
+		{
+			options.unpack = true;
+		}
+		else if (argv[i][0] == '-')
+		{
+			PrintUsage();
+			return 1;
+		}
+		else
+		{
+			inputs.push_back(argv[i]);
+		}
+	}
+
+	if (inputs.empty())
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	const char* extension = options.unpack ? ".dds.lz4" : ".dds";
+	std::vector<std::filesystem::path> files;
+	for (std::filesystem::path const& input : inputs)
+	{
+		std::error_code ec;
+		if (!std::filesystem::is_directory(input, ec))
+		{
+			files.push_back(input);
+			continue;
+		}
+
+		for (std::filesystem::recursive_directory_iterator it(input, ec), end; !ec && it != end; it.increment(ec))
+		{
+			if (it->is_regular_file(ec) && HasExtension(it->path(), extension))
+			{
+				files.push_back(it->path());
+			}
+		}
+	}
+
+	bool success = true;
+	uint64_t inputTotal = 0, outputTotal = 0;
+	for (std::filesystem::path const& file : files)
+	{
+		success &= options.unpack ? UnpackFile(file, options) : PackFile(file, options, inputTotal, outputTotal);
+	}
+
+	if (!options.unpack && inputTotal)
+	{
+		printf("%zu files, %llu -> %llu bytes, %.1f%% smaller\n", files.size(), (unsigned long long)inputTotal,
+			(unsigned long long)outputTotal, 100.0 - outputTotal * 100.0 / inputTotal);
+	}
+
+	return success ? 0 : 1;
+}
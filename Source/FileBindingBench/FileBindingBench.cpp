@@ -0,0 +1,484 @@
+// Replay benchmark for FileBindingTable (Dependencies/Loaders/FileBindingTable.h).
+// Generates --bindings BindFile / BindDirectory bindings spread over --mods mods with conflicting
+// priorities, and creates the bound directories under --root with some of their files, so
+// directories overlap file bindings and lack files their lower priority rivals have. Both a
+// compiled and an unexpanded table replay a trace of game file opens through Resolve. The first
+// --verify opens are also resolved by ranking every binding that covers the path and taking the
+// first one that is a file binding or holds the file on disk, and both results must agree.
+//
+//   FileBindingBench [--bindings 100000] [--mods 50] [--opens 500000] [--verify 2000] [--root dir] [--trace file] [--record file]
+//
+// --trace replays a recorded trace instead, one game path per line as the game passed it.
+// --record writes the generated trace in that format.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "FileBindingTable.h"
+
+struct Options
+{
+	size_t bindings = 100000;
+	size_t mods = 50;
+	size_t opens = 500000;
+	size_t verify = 2000;
+	std::string root = (std::filesystem::temp_directory_path() / "FileBindingBench").string();
+	std::string trace;
+	std::string record;
+};
+
+struct Binding
+{
+	std::string path;
+	std::string destination;
+	int priority;
+	bool directory;
+};
+
+static constexpr size_t c_streams = 10;		// stream<n>.dat names under every bound directory
+
+static std::string StreamName(size_t index)
+{
+	return "stream" + std::to_string(index) + ".dat";
+}
+
+static std::vector<Binding> GenerateBindings(Options const& options, std::mt19937& random)
+{
+	std::vector<Binding> bindings;
+	bindings.reserve(options.bindings);
+
+	size_t directories = options.bindings / 10;
+	size_t directoryPaths = directories / 2 + 1;
+	for (size_t i = 0; i < options.bindings; i++)
+	{
+		int mod = (int)(random() % options.mods);
+		std::string root = options.root + "/mod" + std::to_string(mod) + "/";
+
+		if (i < directories)
+		{
+			// Nested directory binds so ancestors and descendants compete
+			std::string path = "data\\dir" + std::to_string(i % directoryPaths);
+			if (i % 3 == 0)
+			{
+				path += "\\sub" + std::to_string(i % 7);
+			}
+			bindings.push_back({ path, root + "d" + std::to_string(i), mod, true });
+			continue;
+		}
+
+		// One in five file binds replaces a file under a bound directory
+		if (random() % 5 == 0)
+		{
+			std::string path = "data\\dir" + std::to_string(random() % directoryPaths) + "\\" + StreamName(random() % c_streams);
+			bindings.push_back({ path, root + "f" + std::to_string(i), mod, false });
+			continue;
+		}
+
+		// About one in eight file binds rebinds a path another mod already bound
+		size_t file = random() % 8 == 0 ? random() % (i - directories + 1) : i;
+		std::string path = "data\\area" + std::to_string(file % 300) + "\\file" + std::to_string(file) + ".bin";
+		bindings.push_back({ path, root + "f" + std::to_string(i), mod, false });
+	}
+
+	return bindings;
+}
+
+// Each bound directory holds about half of the stream files, bound files don't need to exist
+static void CreateTree(Options const& options, std::vector<Binding> const& bindings, std::mt19937& random)
+{
+	std::error_code ec;
+	std::filesystem::remove_all(options.root, ec);
+	for (Binding const& binding : bindings)
+	{
+		if (!binding.directory)
+		{
+			continue;
+		}
+
+		std::filesystem::create_directories(binding.destination, ec);
+		for (size_t i = 0; i < c_streams; i++)
+		{
+			if (random() % 2)
+			{
+				std::ofstream(binding.destination + "/" + StreamName(i));
+			}
+		}
+	}
+}
+
+// Opens as the game issues them: mixed case and separators, bound files, files under bound
+// directories and files nobody replaced
+static std::vector<std::string> GenerateTrace(Options const& options, std::vector<Binding> const& bindings, std::mt19937& random)
+{
+	std::vector<std::string> trace;
+	trace.reserve(options.opens);
+
+	for (size_t i = 0; i < options.opens; i++)
+	{
+		Binding const& binding = bindings[random() % bindings.size()];
+		std::string path;
+		switch (random() % 5)
+		{
+		case 0:
+		case 1:
+			path = binding.path;
+			break;
+		case 2:
+		case 3:
+			path = binding.directory ? binding.path + "\\" + StreamName(random() % c_streams) : binding.path + ".stream";
+			break;
+		default:
+			path = "data\\unbound" + std::to_string(random() % 5000) + "\\file.bin";
+			break;
+		}
+
+		for (char& c : path)
+		{
+			if (c == '\\' && random() % 2)
+			{
+				c = '/';
+			}
+			else if (random() % 4 == 0)
+			{
+				c = (char)toupper((unsigned char)c);
+			}
+		}
+
+		if (random() % 10 == 0)
+		{
+			path = ".\\" + path;
+		}
+
+		trace.push_back(std::move(path));
+	}
+
+	return trace;
+}
+
+static size_t Depth(std::string const& path)
+{
+	return path.empty() ? 0 : std::count(path.begin(), path.end(), '\\') + 1;
+}
+
+// Ranks every binding covering the path: higher priority, then file bindings, then deeper
+// directories, then the one added first. The first file binding or directory holding the file wins.
+static bool ResolveLinear(std::vector<Binding> const& bindings, std::string const& path, std::string& destination)
+{
+	std::string normalized = FileBindingTable::Normalize(path);
+
+	std::vector<size_t> candidates;
+	for (size_t i = 0; i < bindings.size(); i++)
+	{
+		Binding const& binding = bindings[i];
+		bool covers = binding.directory ?
+			binding.path.empty() || normalized == binding.path ||
+			(normalized.size() > binding.path.size() && normalized.compare(0, binding.path.size(), binding.path) == 0 && normalized[binding.path.size()] == '\\') :
+			binding.path == normalized;
+		if (covers)
+		{
+			candidates.push_back(i);
+		}
+	}
+
+	std::stable_sort(candidates.begin(), candidates.end(), [&](size_t a, size_t b)
+	{
+		Binding const& x = bindings[a];
+		Binding const& y = bindings[b];
+		if (x.priority != y.priority)
+		{
+			return x.priority > y.priority;
+		}
+		if (x.directory != y.directory)
+		{
+			return !x.directory;
+		}
+		return x.directory && Depth(x.path) > Depth(y.path);
+	});
+
+	for (size_t index : candidates)
+	{
+		Binding const& binding = bindings[index];
+		if (!binding.directory)
+		{
+			destination = binding.destination;
+			return true;
+		}
+
+		std::filesystem::path file = binding.destination;
+		if (normalized.size() > binding.path.size())
+		{
+			std::string remainder = normalized.substr(binding.path.size() + (binding.path.empty() ? 0 : 1));
+			std::replace(remainder.begin(), remainder.end(), '\\', '/');
+			file /= remainder;
+		}
+
+		std::error_code ec;
+		if (std::filesystem::exists(file, ec))
+		{
+			destination = file.string();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Hand-picked conflicts with their answers written out
+static size_t CheckCases(std::string const& root)
+{
+	namespace fs = std::filesystem;
+	std::error_code ec;
+	fs::path base = fs::path(root) / "cases";
+	fs::remove_all(base, ec);
+	for (char const* file : { "high/x.bin", "high/v.bin", "high/c/w.bin", "empty/keep", "low/y.bin", "first/z.bin", "second/z.bin", "outer/d/w.bin", "inner/w.bin" })
+	{
+		fs::create_directories((base / file).parent_path(), ec);
+		std::ofstream(base / file);
+	}
+
+	auto at = [&](char const* file) { return (base / file).string(); };
+
+	FileBindingTable::Builder builder;
+	builder.BindFile("a\\x.bin", at("file/x.bin"), 1);			// A higher directory holding the file beats it
+	builder.BindDirectory("a", at("high"), 5);
+	builder.BindDirectory("b", at("empty"), 5);				// Lacks y.bin, the lower one has it
+	builder.BindDirectory("b", at("low"), 1);
+	builder.BindDirectory("e", at("first"), 3);				// Equal priorities, first added wins
+	builder.BindDirectory("e", at("second"), 3);
+	builder.BindDirectory("g", at("outer"), 2);				// Equal priorities, the deeper directory wins
+	builder.BindDirectory("g\\d", at("inner"), 2);
+	builder.BindFile("h\\v.bin", at("file/v.bin"), 2);		// Equal priorities, a file beats a directory
+	builder.BindDirectory("h", at("high"), 2);
+
+	struct Case
+	{
+		char const* path;
+		std::string expected;
+	};
+
+	std::vector<Case> cases
+	{
+		{ "A/X.BIN", at("high/x.bin") },
+		{ "b\\y.bin", at("low/y.bin") },
+		{ "e\\z.bin", at("first/z.bin") },
+		{ "g\\d\\w.bin", at("inner/w.bin") },
+		{ "h\\v.bin", at("file/v.bin") },
+		{ "b\\missing.bin", "" },
+		{ "a\\later.bin", at("high/later.bin") },
+	};
+
+	size_t failures = 0;
+	for (bool expand : { true, false })
+	{
+		std::shared_ptr<const FileBindingTable> table = builder.Compile(expand);
+		std::ofstream(base / "high/later.bin");		// Created after compiling, only the trie can find it
+
+		for (Case const& check : cases)
+		{
+			std::string destination;
+			bool resolved = table->Resolve(check.path, destination);
+			std::string expected = check.expected.empty() ? "" : fs::path(check.expected).lexically_normal().string();
+			std::string actual = resolved ? fs::path(destination).lexically_normal().string() : "";
+			if (expected != actual)
+			{
+				fprintf(stderr, "Case %s (%s): expected %s, got %s\n", check.path, expand ? "compiled" : "unexpanded",
+					expected.empty() ? "(none)" : expected.c_str(), actual.empty() ? "(none)" : actual.c_str());
+				failures++;
+			}
+		}
+
+		fs::remove(base / "high/later.bin", ec);
+	}
+
+	fs::remove_all(base, ec);
+	return failures;
+}
+
+static void PrintUsage()
+{
+	fprintf(stderr,
+		"Usage: FileBindingBench [options]\n"
+		"  --bindings <count>   Bindings to generate, a tenth of them directories (default 100000)\n"
+		"  --mods <count>       Mods the bindings are spread over, also their priorities (default 50)\n"
+		"  --opens <count>      Opens in the generated trace (default 500000)\n"
+		"  --verify <count>     Opens checked against a walk over all bindings (default 2000)\n"
+		"  --root <dir>         Where bound directories are created, removed afterwards (default temp)\n"
+		"  --trace <file>       Replay a recorded trace, one game path per line\n"
+		"  --record <file>      Write the generated trace to a file\n");
+}
+
+static size_t Verify(FileBindingTable const& table, std::vector<Binding> const& bindings, std::vector<std::string> const& trace, size_t count, char const* name)
+{
+	size_t mismatches = 0;
+	std::string destination;
+	for (size_t i = 0; i < count; i++)
+	{
+		std::string expected;
+		bool found = ResolveLinear(bindings, trace[i], expected);
+		bool resolved = table.Resolve(trace[i], destination);
+		bool same = found == resolved && (!found || std::filesystem::path(expected).lexically_normal() == std::filesystem::path(destination).lexically_normal());
+		if (!same && mismatches++ < 10)
+		{
+			fprintf(stderr, "Mismatch (%s) for %s: expected %s, got %s\n", name, trace[i].c_str(), found ? expected.c_str() : "(none)", resolved ? destination.c_str() : "(none)");
+		}
+	}
+	return mismatches;
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	for (int i = 1; i < argc; i++)
+	{
+		bool hasValue = i + 1 < argc;
+		if (!strcmp(argv[i], "--bindings") && hasValue)
+		{
+			options.bindings = std::max<size_t>(strtoull(argv[++i], nullptr, 10), 10);
+		}
+		else if (!strcmp(argv[i], "--mods") && hasValue)
+		{
+			options.mods = std::max<size_t>(strtoull(argv[++i], nullptr, 10), 1);
+		}
+		else if (!strcmp(argv[i], "--opens") && hasValue)
+		{
+			options.opens = std::max<size_t>(strtoull(argv[++i], nullptr, 10), 1);
+		}
+		else if (!strcmp(argv[i], "--verify") && hasValue)
+		{
+			options.verify = strtoull(argv[++i], nullptr, 10);
+		}
+		else if (!strcmp(argv[i], "--root") && hasValue)
+		{
+			options.root = argv[++i];
+		}
+		else if (!strcmp(argv[i], "--trace") && hasValue)
+		{
+			options.trace = argv[++i];
+		}
+		else if (!strcmp(argv[i], "--record") && hasValue)
+		{
+			options.record = argv[++i];
+		}
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	std::mt19937 random(1234);
+	std::vector<Binding> bindings = GenerateBindings(options, random);
+	CreateTree(options, bindings, random);
+
+	std::vector<std::string> trace;
+	if (!options.trace.empty())
+	{
+		std::ifstream stream(options.trace);
+		if (!stream)
+		{
+			fprintf(stderr, "Can't open %s\n", options.trace.c_str());
+			return 1;
+		}
+
+		for (std::string line; std::getline(stream, line);)
+		{
+			if (!line.empty() && line.back() == '\r')
+			{
+				line.pop_back();
+			}
+			if (!line.empty())
+			{
+				trace.push_back(line);
+			}
+		}
+	}
+	else
+	{
+		trace = GenerateTrace(options, bindings, random);
+	}
+
+	if (!options.record.empty())
+	{
+		std::ofstream stream(options.record, std::ios::trunc);
+		for (std::string const& path : trace)
+		{
+			stream << path << '\n';
+		}
+	}
+
+	FileBindingTable::Builder builder;
+	for (Binding const& binding : bindings)
+	{
+		if (binding.directory)
+		{
+			builder.BindDirectory(binding.path, binding.destination, binding.priority);
+		}
+		else
+		{
+			builder.BindFile(binding.path, binding.destination, binding.priority);
+		}
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	std::shared_ptr<const FileBindingTable> table = builder.Compile();
+	double compile = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	std::shared_ptr<const FileBindingTable> unexpanded = builder.Compile(false);
+
+	size_t hits = 0;
+	std::string destination;
+	start = std::chrono::steady_clock::now();
+	for (std::string const& path : trace)
+	{
+		hits += table->Resolve(path, destination);
+	}
+	double resolve = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+	size_t files = 0;
+	start = std::chrono::steady_clock::now();
+	for (std::string const& path : trace)
+	{
+		files += table->FindFile(path) != nullptr;
+	}
+	double find = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+	size_t unexpandedHits = 0;
+	start = std::chrono::steady_clock::now();
+	for (std::string const& path : trace)
+	{
+		unexpandedHits += unexpanded->Resolve(path, destination);
+	}
+	double resolveUnexpanded = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+	size_t verify = std::min<size_t>(options.verify, trace.size());
+	start = std::chrono::steady_clock::now();
+	size_t mismatches = Verify(*table, bindings, trace, verify, "compiled");
+	double linear = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+	mismatches += Verify(*unexpanded, bindings, trace, verify, "unexpanded");
+
+	size_t caseFailures = CheckCases(options.root);
+
+	std::error_code ec;
+	std::filesystem::remove_all(options.root, ec);
+
+	printf("%zu bindings over %zu mods, %zu unique files, %zu opens\n", bindings.size(), options.mods, table->GetFileCount(), trace.size());
+	printf("compile     %8.1f ms\n", compile);
+	printf("Resolve     %8.1f ns per open, %zu resolved\n", resolve / trace.size(), hits);
+	printf("FindFile    %8.1f ns per open, %zu bound files\n", find / trace.size(), files);
+	printf("unexpanded  %8.1f ns per open, %zu resolved\n", resolveUnexpanded / trace.size(), unexpandedHits);
+	if (verify)
+	{
+		printf("linear walk %8.1f ns per open over %zu opens\n", linear / verify, verify);
+	}
+	printf("verified    %zu opens, %zu mismatches\n", verify, mismatches);
+	printf("cases       %zu failures\n", caseFailures);
+	return mismatches || caseFailures ? 1 : 0;
+}
@@ -0,0 +1,244 @@
+// Benchmark for FileExistenceCache (Dependencies/FileExistenceCache.h).
+// Creates --dirs directories of --files files each and probes --probes paths in them the way the
+// loaders do, half of them missing, through std::filesystem::exists, a cache revalidating on every
+// probe and caches with the default interval and a watched root. Reports time per probe and the
+// stat calls and directory enumerations each one made, counted by interposing the C library.
+// Then checks that added and removed files show up after the interval, InvalidateDirectory and
+// ApplyChanges.
+//
+//   FileExistenceBench [--dirs 50] [--files 200] [--probes 200000] [--dir path] [--keep]
+//
+// Files go to a temporary directory unless --dir is given and are removed unless --keep is.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <dlfcn.h>
+#include <sys/stat.h>
+
+#include "FileExistenceCache.h"
+
+static std::atomic<size_t> g_stats;
+static std::atomic<size_t> g_enumerations;
+
+// std::filesystem goes through these, so counting them counts its syscalls
+extern "C" int stat(const char* path, struct stat* buffer)
+{
+	static auto next = (int(*)(const char*, struct stat*))dlsym(RTLD_NEXT, "stat");
+	g_stats++;
+	return next(path, buffer);
+}
+
+extern "C" int lstat(const char* path, struct stat* buffer)
+{
+	static auto next = (int(*)(const char*, struct stat*))dlsym(RTLD_NEXT, "lstat");
+	g_stats++;
+	return next(path, buffer);
+}
+
+extern "C" DIR* fdopendir(int fd)
+{
+	static auto next = (DIR*(*)(int))dlsym(RTLD_NEXT, "fdopendir");
+	g_enumerations++;
+	return next(fd);
+}
+
+extern "C" DIR* opendir(const char* path)
+{
+	static auto next = (DIR*(*)(const char*))dlsym(RTLD_NEXT, "opendir");
+	g_enumerations++;
+	return next(path);
+}
+
+struct Options
+{
+	size_t dirs = 50;
+	size_t files = 200;
+	size_t probes = 200000;
+	std::filesystem::path directory;
+	bool keep = false;
+};
+
+struct Result
+{
+	double nanoseconds;
+	size_t stats;
+	size_t enumerations;
+	size_t found;
+};
+
+template<typename TExists>
+static Result Run(std::vector<std::filesystem::path> const& probes, TExists&& exists)
+{
+	size_t stats = g_stats;
+	size_t enumerations = g_enumerations;
+	size_t found = 0;
+
+	auto start = std::chrono::steady_clock::now();
+	for (std::filesystem::path const& path : probes)
+	{
+		found += exists(path);
+	}
+	double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+	return { elapsed / probes.size(), g_stats - stats, g_enumerations - enumerations, found };
+}
+
+static void Print(const char* name, Result const& result)
+{
+	printf("%-22s %8.1f ns per probe %10zu stat calls %8zu enumerations %8zu found\n", name, result.nanoseconds, result.stats, result.enumerations, result.found);
+}
+
+static bool Check(bool condition, const char* name)
+{
+	printf("%-40s %s\n", name, condition ? "ok" : "FAILED");
+	return condition;
+}
+
+static bool RunChecks(std::filesystem::path const& directory)
+{
+	using namespace Common;
+	bool success = true;
+
+	std::filesystem::path folder = directory / "checks";
+	std::filesystem::create_directories(folder);
+	std::filesystem::path file = folder / "added.bin";
+
+	FileExistenceCache throttled(std::chrono::milliseconds(200));
+	FileExistenceCache watched;
+	watched.AddWatchedDirectory(folder);
+	success &= Check(!throttled.Exists(file) && !watched.Exists(file), "missing file is missing");
+
+	std::ofstream(file).put('x');
+	success &= Check(!throttled.Exists(file), "throttled cache trusts its listing");
+	std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+	success &= Check(throttled.Exists(file), "added file shows after the interval");
+	success &= Check(throttled.Exists(folder / ".." / "checks" / "." / "added.bin"), "dotted path finds the same listing");
+	success &= Check(!watched.Exists(file), "watched cache waits for its watcher");
+
+	watched.ApplyChanges({ { FileChangeType::Added, file } });
+	success &= Check(watched.Exists(file), "added file shows after ApplyChanges");
+
+	std::filesystem::remove(file);
+	throttled.InvalidateDirectory(folder);
+	success &= Check(!throttled.Exists(file), "removed file goes after InvalidateDirectory");
+
+	uint64_t generation = watched.GetGeneration();
+	watched.Invalidate();
+	success &= Check(!watched.Exists(file) && watched.GetGeneration() == generation + 1, "removed file goes after Invalidate");
+	return success;
+}
+
+static void PrintUsage()
+{
+	fprintf(stderr,
+		"Usage: FileExistenceBench [options]\n"
+		"  --dirs <count>     Directories to create (default 50)\n"
+		"  --files <count>    Files per directory (default 200)\n"
+		"  --probes <count>   Paths to probe, half of them missing (default 200000)\n"
+		"  --dir <path>       Where to create them (default temp)\n"
+		"  --keep             Don't remove them afterwards\n");
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	for (int i = 1; i < argc; i++)
+	{
+		bool hasValue = i + 1 < argc;
+		if (!strcmp(argv[i], "--dirs") && hasValue)
+		{
+			options.dirs = std::max<size_t>(strtoull(argv[++i], nullptr, 10), 1);
+		}
+		else if (!strcmp(argv[i], "--files") && hasValue)
+		{
+			options.files = std::max<size_t>(strtoull(argv[++i], nullptr, 10), 1);
+		}
+		else if (!strcmp(argv[i], "--probes") && hasValue)
+		{
+			options.probes = std::max<size_t>(strtoull(argv[++i], nullptr, 10), 1);
+		}
+		else if (!strcmp(argv[i], "--dir") && hasValue)
+		{
+			options.directory = argv[++i];
+		}
+		else if (!strcmp(argv[i], "--keep"))
+		{
+			options.keep = true;
+		}
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (options.directory.empty())
+	{
+		options.directory = std::filesystem::temp_directory_path() / "FileExistenceBench";
+	}
+	options.directory = std::filesystem::absolute(options.directory);
+
+	std::error_code ec;
+	std::filesystem::remove_all(options.directory, ec);
+	for (size_t i = 0; i < options.dirs; i++)
+	{
+		std::filesystem::path folder = options.directory / ("dir" + std::to_string(i));
+		std::filesystem::create_directories(folder);
+		for (size_t j = 0; j < options.files; j++)
+		{
+			std::ofstream(folder / ("file" + std::to_string(j) + ".bin")).put('x');
+		}
+	}
+
+	// Odd draws name files past the last one created
+	std::mt19937 random(1234);
+	std::vector<std::filesystem::path> probes;
+	probes.reserve(options.probes);
+	for (size_t i = 0; i < options.probes; i++)
+	{
+		size_t file = random() % (options.files * 2);
+		std::string name = "file" + std::to_string(file % 2 ? options.files + file : file / 2) + ".bin";
+		probes.push_back(options.directory / ("dir" + std::to_string(random() % options.dirs)) / name);
+	}
+
+	printf("%zu directories of %zu files, %zu probes\n", options.dirs, options.files, probes.size());
+
+	Result direct = Run(probes, [](std::filesystem::path const& path) { std::error_code ec; return std::filesystem::exists(path, ec); });
+	Print("std::filesystem", direct);
+
+	Common::FileExistenceCache everyProbe(std::chrono::milliseconds(0));
+	Result unthrottled = Run(probes, [&](std::filesystem::path const& path) { return everyProbe.Exists(path); });
+	Print("cache, every probe", unthrottled);
+
+	Common::FileExistenceCache interval;
+	Result throttled = Run(probes, [&](std::filesystem::path const& path) { return interval.Exists(path); });
+	Print("cache, 1 s interval", throttled);
+
+	Common::FileExistenceCache watched;
+	watched.AddWatchedDirectory(options.directory);
+	Result trusted = Run(probes, [&](std::filesystem::path const& path) { return watched.Exists(path); });
+	Print("cache, watched", trusted);
+
+	bool success = direct.found == unthrottled.found && direct.found == throttled.found && direct.found == trusted.found;
+	success &= Check(throttled.stats < unthrottled.stats, "interval makes fewer stat calls");
+	success &= RunChecks(options.directory);
+
+	if (!options.keep)
+	{
+		std::filesystem::remove_all(options.directory, ec);
+	}
+
+	return success ? 0 : 1;
+}
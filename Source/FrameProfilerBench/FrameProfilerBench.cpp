@@ -0,0 +1,157 @@
+// Overhead benchmark for FrameProfiler (Dependencies/Loaders/FrameProfiler.h).
+// Simulates --mods mods with --handlers update handlers each over --frames frames and reports what
+// Measure adds to every handler call and EndFrame to every frame. Then checks that a mod's
+// handlers are summed into a single sample per frame.
+//
+//   FrameProfilerBench [--mods 40] [--handlers 2] [--frames 20000]
+
+#ifndef _WIN32
+#define __cdecl
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "FrameProfiler.h"
+
+using Clock = std::chrono::steady_clock;
+
+struct Options
+{
+	size_t mods = 40;
+	size_t handlers = 2;
+	size_t frames = 20000;
+};
+
+static volatile uint64_t g_sink;
+
+static void Handler(size_t seed)
+{
+	g_sink = g_sink + seed;
+}
+
+static void Spin(std::chrono::microseconds duration)
+{
+	auto end = Clock::now() + duration;
+	while (Clock::now() < end)
+	{
+	}
+}
+
+static double Nanoseconds(Clock::duration duration)
+{
+	return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+}
+
+// Two 200 us handlers of one mod make a 400 us frame, not two 200 us samples
+static bool CheckPerFrameSamples()
+{
+	Mod_t mod{ "Check", "", "check", 0, nullptr };
+	FrameProfiler profiler;
+	FrameProfiler::Slot* slot = profiler.Register(&mod);
+	for (size_t frame = 0; frame < 20; frame++)
+	{
+		profiler.Measure(slot, [] { Spin(std::chrono::microseconds(200)); });
+		profiler.Measure(slot, [] { Spin(std::chrono::microseconds(200)); });
+		profiler.EndFrame();
+	}
+
+	ModFrameStats_t stats{};
+	profiler.GetStats(&mod, stats);
+	printf("per frame   %zu samples, mean %.3f ms for two 0.2 ms handlers\n", stats.SampleCount, stats.MeanMilliseconds);
+	return stats.SampleCount == 20 && stats.MeanMilliseconds >= 0.4 && stats.MeanMilliseconds < 0.6;
+}
+
+static void PrintUsage()
+{
+	fprintf(stderr,
+		"Usage: FrameProfilerBench [options]\n"
+		"  --mods <count>       Profiled mods (default 40)\n"
+		"  --handlers <count>   Update handlers per mod (default 2)\n"
+		"  --frames <count>     Simulated frames (default 20000)\n");
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	for (int i = 1; i < argc; i++)
+	{
+		bool hasValue = i + 1 < argc;
+		if (!strcmp(argv[i], "--mods") && hasValue)
+		{
+			options.mods = std::max<size_t>(strtoull(argv[++i], nullptr, 10), 1);
+		}
+		else if (!strcmp(argv[i], "--handlers") && hasValue)
+		{
+			options.handlers = std::max<size_t>(strtoull(argv[++i], nullptr, 10), 1);
+		}
+		else if (!strcmp(argv[i], "--frames") && hasValue)
+		{
+			options.frames = std::max<size_t>(strtoull(argv[++i], nullptr, 10), 1);
+		}
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	std::vector<std::string> names(options.mods);
+	std::vector<Mod_t> mods(options.mods);
+	for (size_t i = 0; i < options.mods; i++)
+	{
+		names[i] = "Mod" + std::to_string(i);
+		mods[i] = { names[i].c_str(), "", names[i].c_str(), i, nullptr };
+	}
+
+	// Plain calls first, the difference is what profiling costs
+	auto start = Clock::now();
+	for (size_t frame = 0; frame < options.frames; frame++)
+	{
+		for (size_t call = 0; call < options.mods * options.handlers; call++)
+		{
+			Handler(call);
+		}
+	}
+	auto plain = Clock::now() - start;
+
+	FrameProfiler profiler;
+	std::vector<FrameProfiler::Slot*> slots;
+	for (Mod_t const& mod : mods)
+	{
+		slots.push_back(profiler.Register(&mod));
+	}
+
+	Clock::duration endFrame{};
+	start = Clock::now();
+	for (size_t frame = 0; frame < options.frames; frame++)
+	{
+		for (size_t call = 0; call < options.mods * options.handlers; call++)
+		{
+			profiler.Measure(slots[call % options.mods], [call] { Handler(call); });
+		}
+
+		auto before = Clock::now();
+		profiler.EndFrame();
+		endFrame += Clock::now() - before;
+	}
+	auto profiled = Clock::now() - start;
+
+	double calls = (double)options.frames * options.mods * options.handlers;
+	printf("%zu mods x %zu handlers, %zu frames\n", options.mods, options.handlers, options.frames);
+	printf("Measure     %6.1f ns per handler call\n", (Nanoseconds(profiled - endFrame) - Nanoseconds(plain)) / calls);
+	printf("EndFrame    %6.1f ns per frame\n", Nanoseconds(endFrame) / options.frames);
+	printf("per frame   %6.3f us total overhead\n", (Nanoseconds(profiled) - Nanoseconds(plain)) / options.frames / 1000.0);
+
+	std::string report = profiler.FormatReport(3);
+	printf("%s\n", report.c_str());
+
+	bool perFrame = CheckPerFrameSamples();
+	printf("samples     %s\n", perFrame ? "one per mod per frame" : "MISMATCH");
+	return perFrame ? 0 : 1;
+}
@@ -0,0 +1,227 @@
+// Routing check and benchmark for MessageRouter (Dependencies/Loaders/MessageRouter.h).
+// Builds --mods receivers, of which --catch-all never subscribe and the rest subscribe to a few of
+// --ids message ids each, then checks every broadcast and IsSubscribed answer against a scan over
+// the subscriptions: delivery order, no receiver reached twice, catch-all receivers on every id.
+// Afterwards times broadcasts and IsSubscribed against every mod filtering by itself.
+//
+//   MessageRouterBench [--mods 40] [--catch-all 8] [--ids 64] [--messages 2000000] [--seed 1]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "MessageRouter.h"
+
+using Clock = std::chrono::steady_clock;
+
+struct Options
+{
+	size_t mods = 40;
+	size_t catchAll = 8;
+	size_t ids = 64;
+	size_t messages = 2000000;
+	uint32_t seed = 1;
+};
+
+struct Mod
+{
+	bool catchAll;
+	std::vector<size_t> ids;
+};
+
+static volatile size_t g_sink;
+
+// What delivery looked like before routing: every mod in order, filtered by its own subscriptions
+static bool Wants(Mod const& mod, size_t id, std::vector<size_t> const& subscribedIds)
+{
+	if (mod.catchAll)
+	{
+		return true;
+	}
+
+	// Subscribers only see the ids they asked for, ids nobody asked for only reach catch-all mods
+	return std::find(mod.ids.begin(), mod.ids.end(), id) != mod.ids.end() && std::find(subscribedIds.begin(), subscribedIds.end(), id) != subscribedIds.end();
+}
+
+static double Nanoseconds(Clock::duration duration)
+{
+	return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+}
+
+static void PrintUsage()
+{
+	fprintf(stderr,
+		"Usage: MessageRouterBench [options]\n"
+		"  --mods <count>       Receivers (default 40)\n"
+		"  --catch-all <count>  Receivers that never subscribe (default 8)\n"
+		"  --ids <count>        Message ids in use (default 64)\n"
+		"  --messages <count>   Timed broadcasts (default 2000000)\n"
+		"  --seed <value>       Subscription and message seed (default 1)\n");
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	for (int i = 1; i < argc; i++)
+	{
+		bool hasValue = i + 1 < argc;
+		if (!strcmp(argv[i], "--mods") && hasValue)
+		{
+			options.mods = std::max<size_t>(strtoull(argv[++i], nullptr, 10), 1);
+		}
+		else if (!strcmp(argv[i], "--catch-all") && hasValue)
+		{
+			options.catchAll = strtoull(argv[++i], nullptr, 10);
+		}
+		else if (!strcmp(argv[i], "--ids") && hasValue)
+		{
+			options.ids = std::max<size_t>(strtoull(argv[++i], nullptr, 10), 1);
+		}
+		else if (!strcmp(argv[i], "--messages") && hasValue)
+		{
+			options.messages = std::max<size_t>(strtoull(argv[++i], nullptr, 10), 1);
+		}
+		else if (!strcmp(argv[i], "--seed") && hasValue)
+		{
+			options.seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+		}
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+	options.catchAll = std::min<size_t>(options.catchAll, options.mods);
+
+	// Catch-all mods are spread over the list so routes have to interleave them with subscribers
+	std::mt19937 random(options.seed);
+	std::vector<Mod> mods(options.mods);
+	std::vector<size_t> order(options.mods);
+	for (size_t i = 0; i < options.mods; i++)
+	{
+		order[i] = i;
+	}
+	std::shuffle(order.begin(), order.end(), random);
+	for (size_t i = 0; i < options.catchAll; i++)
+	{
+		mods[order[i]].catchAll = true;
+	}
+
+	// A quarter of the ids is left unsubscribed, those only reach the catch-all mods
+	size_t subscribable = std::max<size_t>(options.ids * 3 / 4, 1);
+	std::vector<size_t> subscribedIds;
+	MessageRouter<const Mod*> router;
+	for (Mod& mod : mods)
+	{
+		router.AddReceiver(&mod);
+	}
+	for (Mod& mod : mods)
+	{
+		if (mod.catchAll)
+		{
+			continue;
+		}
+
+		size_t count = 1 + random() % 4;
+		for (size_t i = 0; i < count; i++)
+		{
+			size_t id = 0x100 + random() % subscribable;
+			mod.ids.push_back(id);
+			router.Subscribe(&mod, id);
+			router.Subscribe(&mod, id);		// Repeats must not duplicate deliveries
+			if (std::find(subscribedIds.begin(), subscribedIds.end(), id) == subscribedIds.end())
+			{
+				subscribedIds.push_back(id);
+			}
+		}
+	}
+	router.Build();
+
+	size_t mismatches = 0;
+	for (size_t id = 0x100; id < 0x100 + options.ids; id++)
+	{
+		std::vector<const Mod*> expected;
+		for (Mod const& mod : mods)
+		{
+			if (Wants(mod, id, subscribedIds))
+			{
+				expected.push_back(&mod);
+			}
+		}
+
+		std::vector<const Mod*> delivered;
+		router.Broadcast(id, [&](const Mod* mod) { delivered.push_back(mod); });
+		mismatches += delivered != expected;
+
+		for (Mod const& mod : mods)
+		{
+			mismatches += router.IsSubscribed(&mod, id) != Wants(mod, id, subscribedIds);
+		}
+	}
+
+	Mod stranger{};
+	mismatches += router.IsSubscribed(&stranger, 0x100);
+
+	std::vector<size_t> messages(options.messages);
+	for (size_t& id : messages)
+	{
+		id = 0x100 + random() % options.ids;
+	}
+
+	// Unrouted, every mod gets the message and checks its own ids
+	auto start = Clock::now();
+	for (size_t id : messages)
+	{
+		for (Mod const& mod : mods)
+		{
+			if (mod.catchAll || std::find(mod.ids.begin(), mod.ids.end(), id) != mod.ids.end())
+			{
+				g_sink = g_sink + (size_t)&mod;
+			}
+		}
+	}
+	auto scan = Clock::now() - start;
+
+	start = Clock::now();
+	for (size_t id : messages)
+	{
+		router.Broadcast(id, [](const Mod* mod) { g_sink = g_sink + (size_t)mod; });
+	}
+	auto routed = Clock::now() - start;
+
+	start = Clock::now();
+	for (size_t i = 0; i < messages.size(); i++)
+	{
+		g_sink = g_sink + router.IsSubscribed(&mods[i % mods.size()], messages[i]);
+	}
+	auto subscribed = Clock::now() - start;
+
+	// Finding the receiver first, as a lookup without the built table has to
+	start = Clock::now();
+	for (size_t i = 0; i < messages.size(); i++)
+	{
+		const Mod* receiver = &mods[i % mods.size()];
+		for (Mod const& mod : mods)
+		{
+			if (&mod == receiver)
+			{
+				g_sink = g_sink + (mod.catchAll || std::find(mod.ids.begin(), mod.ids.end(), messages[i]) != mod.ids.end());
+				break;
+			}
+		}
+	}
+	auto subscribedScan = Clock::now() - start;
+
+	printf("%zu mods (%zu catch-all), %zu ids, %zu messages\n", options.mods, options.catchAll, options.ids, options.messages);
+	printf("scan          %6.1f ns per broadcast\n", Nanoseconds(scan) / messages.size());
+	printf("Broadcast     %6.1f ns per broadcast\n", Nanoseconds(routed) / messages.size());
+	printf("lookup scan   %6.1f ns per query\n", Nanoseconds(subscribedScan) / messages.size());
+	printf("IsSubscribed  %6.1f ns per query\n", Nanoseconds(subscribed) / messages.size());
+	printf("routes        %zu mismatches\n", mismatches);
+	return mismatches ? 1 : 0;
+}
@@ -0,0 +1,185 @@
+// Throughput benchmark for MipGenerator (Dependencies/DDSTextureLoader/MipGenerator.h).
+// Times full chains of a --size x --size texture, linear and sRGB, and reports megapixels of top
+// level per second. Before timing, chains of odd sized textures are checked against a plain
+// box filter written here: linear output must match exactly, sRGB output within one step of an
+// unquantized floating point conversion.
+//
+//   MipGeneratorBench [--size 2048] [--runs 5]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "MipGenerator.h"
+
+struct Options
+{
+	uint32_t size = 2048;
+	size_t runs = 5;
+};
+
+static double ToLinear(uint8_t value)
+{
+	double v = value / 255.0;
+	return v <= 0.04045 ? v / 12.92 : std::pow((v + 0.055) / 1.055, 2.4);
+}
+
+static double FromLinear(double value)
+{
+	return value <= 0.0031308 ? value * 12.92 : 1.055 * std::pow(value, 1.0 / 2.4) - 0.055;
+}
+
+// Next level of a 2x2 box filter, trailing rows and columns clamped
+static std::vector<uint8_t> ReferenceLevel(std::vector<uint8_t> const& source, uint32_t width, uint32_t height, bool srgb)
+{
+	uint32_t nextWidth = std::max<uint32_t>(width >> 1, 1), nextHeight = std::max<uint32_t>(height >> 1, 1);
+	std::vector<uint8_t> level((size_t)nextWidth * nextHeight * 4);
+	for (uint32_t y = 0; y < nextHeight; y++)
+	{
+		for (uint32_t x = 0; x < nextWidth; x++)
+		{
+			uint32_t xs[2] = { std::min<uint32_t>(x * 2, width - 1), std::min<uint32_t>(x * 2 + 1, width - 1) };
+			uint32_t ys[2] = { std::min<uint32_t>(y * 2, height - 1), std::min<uint32_t>(y * 2 + 1, height - 1) };
+			for (uint32_t channel = 0; channel < 4; channel++)
+			{
+				uint32_t sum = 0;
+				double linear = 0;
+				for (uint32_t sy : ys)
+				{
+					for (uint32_t sx : xs)
+					{
+						uint8_t value = source[((size_t)sy * width + sx) * 4 + channel];
+						sum += value;
+						linear += ToLinear(value);
+					}
+				}
+
+				uint8_t& output = level[((size_t)y * nextWidth + x) * 4 + channel];
+				output = srgb && channel < 3 ? (uint8_t)std::lround(FromLinear(linear / 4) * 255.0) : (uint8_t)((sum + 2) / 4);
+			}
+		}
+	}
+	return level;
+}
+
+// Largest difference between the chain and the reference, over every level and item
+static uint32_t CompareChain(uint32_t width, uint32_t height, uint32_t arraySize, bool srgb, std::mt19937& random)
+{
+	std::vector<uint8_t> top((size_t)width * height * 4 * arraySize);
+	for (uint8_t& value : top)
+	{
+		value = (uint8_t)random();
+	}
+
+	std::vector<uint8_t> chain;
+	MipGenerator::GenerateChain(top.data(), width, height, arraySize, srgb, chain);
+	size_t chainSize = MipGenerator::GetChainSize(width, height);
+	if (chain.size() != chainSize * arraySize)
+	{
+		return 256;
+	}
+
+	uint32_t worst = 0;
+	for (uint32_t item = 0; item < arraySize; item++)
+	{
+		std::vector<uint8_t> level(top.begin() + (size_t)width * height * 4 * item, top.begin() + (size_t)width * height * 4 * (item + 1));
+		const uint8_t* generated = chain.data() + chainSize * item;
+		uint32_t w = width, h = height;
+		for (uint32_t mip = 0; mip < MipGenerator::GetMipCount(width, height); mip++)
+		{
+			for (size_t i = 0; i < level.size(); i++)
+			{
+				worst = std::max<uint32_t>(worst, (uint32_t)std::abs(generated[i] - level[i]));
+			}
+
+			generated += level.size();
+			level = ReferenceLevel(level, w, h, srgb);
+			w = std::max<uint32_t>(w >> 1, 1);
+			h = std::max<uint32_t>(h >> 1, 1);
+		}
+	}
+	return worst;
+}
+
+static void PrintUsage()
+{
+	fprintf(stderr,
+		"Usage: MipGeneratorBench [options]\n"
+		"  --size <pixels>   Width and height of the timed texture (default 2048)\n"
+		"  --runs <count>    Timed runs per mode, the best is reported (default 5)\n");
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	for (int i = 1; i < argc; i++)
+	{
+		bool hasValue = i + 1 < argc;
+		if (!strcmp(argv[i], "--size") && hasValue)
+		{
+			options.size = std::max<uint32_t>((uint32_t)strtoul(argv[++i], nullptr, 10), 1);
+		}
+		else if (!strcmp(argv[i], "--runs") && hasValue)
+		{
+			options.runs = std::max<size_t>(strtoull(argv[++i], nullptr, 10), 1);
+		}
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	std::mt19937 random(47);
+#ifdef MIP_GENERATOR_SSE2
+	printf("SIMD path: SSE2\n");
+#else
+	printf("SIMD path: none\n");
+#endif
+
+	const uint32_t sizes[][3] = { { 1, 1, 1 }, { 3, 1, 1 }, { 7, 5, 2 }, { 64, 64, 1 }, { 129, 67, 3 }, { 300, 17, 1 } };
+	bool success = true;
+	for (bool srgb : { false, true })
+	{
+		uint32_t worst = 0;
+		for (auto const& size : sizes)
+		{
+			worst = std::max<uint32_t>(worst, CompareChain(size[0], size[1], size[2], srgb, random));
+		}
+
+		bool matches = worst <= (srgb ? 1u : 0u);
+		success &= matches;
+		printf("%-8s %s chains, largest difference to the reference %u\n", matches ? "ok" : "FAILED", srgb ? "sRGB" : "linear", worst);
+	}
+
+	uint32_t size = options.size;
+	std::vector<uint8_t> top((size_t)size * size * 4);
+	for (uint8_t& value : top)
+	{
+		value = (uint8_t)random();
+	}
+
+	printf("\n%ux%u chain of %u levels, best of %zu runs\n", size, size, MipGenerator::GetMipCount(size, size), options.runs);
+	for (bool srgb : { false, true })
+	{
+		std::vector<uint8_t> chain;
+		double best = 0;
+		for (size_t run = 0; run < options.runs; run++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			MipGenerator::GenerateChain(top.data(), size, size, 1, srgb, chain);
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			best = run == 0 ? seconds : std::min<double>(best, seconds);
+		}
+
+		printf("%-8s %8.2f ms  %8.1f MP/s\n", srgb ? "sRGB" : "linear", best * 1000.0, (double)size * size / 1e6 / best);
+	}
+
+	return success ? 0 : 1;
+}
@@ -0,0 +1,163 @@
+// Benchmark for LoadModConfigs (Dependencies/ModConfigLoader.h) over a generated mod directory tree.
+// Creates --mods mod folders each holding a mod.ini with --keys config values, then times parsing
+// them one by one with INIReader against the parallel loader and checks both agree.
+//
+//   ModConfigBench [--mods 500] [--keys 200] [--runs 5] [--dir path] [--keep]
+//
+// The tree goes to a temporary directory unless --dir is given and is removed unless --keep is.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "ModConfigLoader.h"
+
+struct Options
+{
+	size_t mods = 500;
+	size_t keys = 200;
+	size_t runs = 5;
+	std::filesystem::path directory;
+	bool keep = false;
+};
+
+static std::vector<std::string> GenerateTree(Options const& options)
+{
+	std::vector<std::string> modIniList;
+	for (size_t mod = 0; mod < options.mods; mod++)
+	{
+		std::filesystem::path folder = options.directory / ("Mod" + std::to_string(mod));
+		std::filesystem::create_directories(folder);
+
+		std::filesystem::path config = folder / "mod.ini";
+		std::ofstream stream(config, std::ios::trunc);
+		stream << "[Desc]\nTitle=Mod " << mod << "\nAuthor=Bench\nVersion=1.0\n\n";
+		stream << "[Main]\nID=bench.mod" << mod << "\nDLLFile=Mod" << mod << ".dll\nIncludeDir0=.\nIncludeDirCount=1\n\n";
+		stream << "[Config]\n";
+		for (size_t key = 0; key < options.keys; key++)
+		{
+			stream << "Value" << key << "=" << (mod * 31 + key) << "\n";
+		}
+
+		modIniList.push_back(config.string());
+	}
+	return modIniList;
+}
+
+template<typename T>
+static double Time(T&& function)
+{
+	auto start = std::chrono::steady_clock::now();
+	function();
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void PrintUsage()
+{
+	fprintf(stderr,
+		"Usage: ModConfigBench [options]\n"
+		"  --mods <count>      Mod folders to generate (default 500)\n"
+		"  --keys <count>      Config values per mod.ini (default 200)\n"
+		"  --runs <count>      Timed runs of each loader, the best is reported (default 5)\n"
+		"  --dir <path>        Where to generate the tree (default a temporary directory)\n"
+		"  --keep              Leave the generated tree behind\n");
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	for (int i = 1; i < argc; i++)
+	{
+		bool hasValue = i + 1 < argc;
+		if (!strcmp(argv[i], "--mods") && hasValue)
+		{
+			options.mods = strtoull(argv[++i], nullptr, 10);
+		}
+		else if (!strcmp(argv[i], "--keys") && hasValue)
+		{
+			options.keys = strtoull(argv[++i], nullptr, 10);
+		}
+		else if (!strcmp(argv[i], "--runs") && hasValue)
+		{
+			options.runs = std::max<size_t>(strtoull(argv[++i], nullptr, 10), 1);
+		}
+		else if (!strcmp(argv[i], "--dir") && hasValue)
+		{
+			options.directory = argv[++i];
+		}
+		else if (!strcmp(argv[i], "--keep"))
+		{
+			options.keep = true;
+		}
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (options.directory.empty())
+	{
+		options.directory = std::filesystem::temp_directory_path() / "ModConfigBench";
+	}
+
+	std::vector<std::string> modIniList = GenerateTree(options);
+	printf("%zu mods, %zu values each, in %s\n", options.mods, options.keys, options.directory.string().c_str());
+
+	double sequential = 1e30, parallel = 1e30;
+	std::vector<Common::ModConfig> configs;
+	for (size_t run = 0; run < options.runs; run++)
+	{
+		sequential = std::min(sequential, Time([&]
+		{
+			std::vector<INIReader> readers;
+			readers.reserve(modIniList.size());
+			for (std::string const& path : modIniList)
+			{
+				readers.emplace_back(path);
+			}
+		}));
+
+		parallel = std::min(parallel, Time([&] { configs = Common::LoadModConfigs(modIniList); }));
+	}
+
+	// Same order and contents as parsing one by one
+	bool match = configs.size() == modIniList.size();
+	for (size_t i = 0; match && i < configs.size(); i++)
+	{
+		INIReader reader(modIniList[i]);
+		match = configs[i].priority == i && configs[i].path == modIniList[i] &&
+			configs[i].reader.Get("Main", "ID", "") == reader.Get("Main", "ID", "") &&
+			configs[i].reader.GetInteger("Config", "Value" + std::to_string(options.keys - 1), -1) == reader.GetInteger("Config", "Value" + std::to_string(options.keys - 1), -1);
+	}
+
+	std::vector<double> times;
+	for (Common::ModConfig const& config : configs)
+	{
+		times.push_back(config.parseMilliseconds);
+	}
+	std::sort(times.begin(), times.end());
+
+	printf("sequential  %8.2f ms\n", sequential);
+	printf("parallel    %8.2f ms  (%.2fx)\n", parallel, sequential / parallel);
+	if (!times.empty())
+	{
+		printf("per file    median %.3f ms, p95 %.3f ms, max %.3f ms\n", times[times.size() / 2], times[times.size() * 95 / 100], times.back());
+	}
+	printf("results     %s\n", match ? "match" : "MISMATCH");
+
+	if (!options.keep)
+	{
+		std::error_code ec;
+		std::filesystem::remove_all(options.directory, ec);
+	}
+
+	return match ? 0 : 1;
+}
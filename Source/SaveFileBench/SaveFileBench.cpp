@@ -0,0 +1,215 @@
+// Benchmark for SaveFileCache (Dependencies/Loaders/SaveFileCache.h).
+// Saves a --size KiB file --saves times the way the game does, write then close, once
+// synchronously and once through the cache, and reports how long the game thread is blocked.
+// Then checks plain and lz4 saves read back intact, that read-through serves the game's own
+// save, and that closing a handle without writing leaves the file alone.
+//
+//   SaveFileBench [--size 2048] [--saves 50] [--dir path] [--keep]
+//
+// Files go to a temporary directory unless --dir is given and are removed unless --keep is.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "SaveFileCache.h"
+
+struct Options
+{
+	size_t size = 2048;
+	size_t saves = 50;
+	std::filesystem::path directory;
+	bool keep = false;
+};
+
+// Save data compresses about as well as real saves: mostly small counters and flags
+static std::vector<uint8_t> GenerateSave(size_t size, uint32_t seed)
+{
+	std::mt19937 random(seed);
+	std::vector<uint8_t> data(size);
+	for (uint8_t& value : data)
+	{
+		value = random() % 4 == 0 ? (uint8_t)random() : 0;
+	}
+	return data;
+}
+
+static void WriteSynchronous(std::filesystem::path const& path, std::vector<uint8_t> const& data)
+{
+	std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+	stream.write(reinterpret_cast<const char*>(data.data()), (std::streamsize)data.size());
+}
+
+static double Milliseconds(std::chrono::steady_clock::duration duration)
+{
+	return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+static bool Check(bool condition, const char* name)
+{
+	printf("%-40s %s\n", name, condition ? "ok" : "FAILED");
+	return condition;
+}
+
+static bool RunChecks(std::filesystem::path const& directory)
+{
+	bool success = true;
+	std::vector<uint8_t> save = GenerateSave(256 * 1024, 7);
+
+	for (bool compress : { false, true })
+	{
+		std::filesystem::path path = directory / (compress ? "check.lz4.sav" : "check.sav");
+		{
+			SaveFileCache cache(path, {}, compress);
+			cache.Write(0, save.data(), save.size());
+			cache.Commit();
+		}
+
+		std::vector<uint8_t> stored;
+		SaveFileCache::ReadFile(path, stored);
+		success &= Check(stored == save, compress ? "lz4 save reads back" : "plain save reads back");
+		if (compress)
+		{
+			success &= Check(std::filesystem::file_size(path) < save.size(), "lz4 save is smaller");
+		}
+
+		SaveFileCache cache(path, {}, compress);
+		std::vector<uint8_t> read(save.size());
+		success &= Check(cache.Read(0, read.data(), read.size()) == save.size() && read == save, "cache serves the stored save");
+	}
+
+	// The game's own save is used until the redirected one exists
+	std::filesystem::path original = directory / "original.sav";
+	std::filesystem::path redirected = directory / "redirected.sav";
+	WriteSynchronous(original, save);
+	{
+		SaveFileCache cache(redirected, original);
+		success &= Check(cache.GetSize() == save.size(), "read-through serves the original");
+		cache.Commit();
+		cache.Flush();
+		success &= Check(!std::filesystem::exists(redirected), "read-only close writes nothing");
+
+		uint8_t value = 0x5A;
+		cache.Write(10, &value, 1);
+		cache.Commit();
+		cache.Flush();
+		std::vector<uint8_t> stored;
+		success &= Check(SaveFileCache::ReadFile(redirected, stored) && stored.size() == save.size() && stored[10] == 0x5A, "write after read-through is saved");
+	}
+
+	// Closing before anything was read or written must not replace the save with an empty image
+	{
+		SaveFileCache cache(original);
+		cache.Commit();
+		cache.Flush();
+	}
+	success &= Check(std::filesystem::file_size(original) == save.size(), "commit before any access keeps the save");
+
+	return success;
+}
+
+static void PrintUsage()
+{
+	fprintf(stderr,
+		"Usage: SaveFileBench [options]\n"
+		"  --size <KiB>      Save file size (default 2048)\n"
+		"  --saves <count>   Saves timed for each mode (default 50)\n"
+		"  --dir <path>      Where to write the files (default a temporary directory)\n"
+		"  --keep            Leave the files behind\n");
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	for (int i = 1; i < argc; i++)
+	{
+		bool hasValue = i + 1 < argc;
+		if (!strcmp(argv[i], "--size") && hasValue)
+		{
+			options.size = std::max<size_t>(strtoull(argv[++i], nullptr, 10), 1);
+		}
+		else if (!strcmp(argv[i], "--saves") && hasValue)
+		{
+			options.saves = std::max<size_t>(strtoull(argv[++i], nullptr, 10), 1);
+		}
+		else if (!strcmp(argv[i], "--dir") && hasValue)
+		{
+			options.directory = argv[++i];
+		}
+		else if (!strcmp(argv[i], "--keep"))
+		{
+			options.keep = true;
+		}
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (options.directory.empty())
+	{
+		options.directory = std::filesystem::temp_directory_path() / ("SaveFileBench" + std::to_string(std::random_device()()));
+	}
+	std::filesystem::create_directories(options.directory);
+
+	std::vector<std::vector<uint8_t>> saves;
+	for (size_t i = 0; i < 4; i++)
+	{
+		saves.push_back(GenerateSave(options.size * 1024, (uint32_t)i));
+	}
+
+	std::chrono::steady_clock::duration synchronous{};
+	std::chrono::steady_clock::duration worst{};
+	for (size_t i = 0; i < options.saves; i++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		WriteSynchronous(options.directory / "sync.sav", saves[i % saves.size()]);
+		auto elapsed = std::chrono::steady_clock::now() - start;
+		synchronous += elapsed;
+		worst = std::max(worst, elapsed);
+	}
+	printf("%zu saves of %zu KiB\n", options.saves, options.size);
+	printf("synchronous  %8.3f ms mean, %8.3f ms worst\n", Milliseconds(synchronous) / options.saves, Milliseconds(worst));
+
+	for (bool compress : { false, true })
+	{
+		SaveFileCache cache(options.directory / (compress ? "cache.lz4.sav" : "cache.sav"), {}, compress);
+		std::chrono::steady_clock::duration blocked{};
+		worst = {};
+
+		auto total = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < options.saves; i++)
+		{
+			std::vector<uint8_t> const& save = saves[i % saves.size()];
+			auto start = std::chrono::steady_clock::now();
+			cache.Write(0, save.data(), save.size());
+			cache.Commit();
+			auto elapsed = std::chrono::steady_clock::now() - start;
+			blocked += elapsed;
+			worst = std::max(worst, elapsed);
+		}
+		cache.Flush();
+
+		printf("%-12s %8.3f ms mean, %8.3f ms worst on the game thread, %.1f ms until on disk\n",
+			compress ? "cached lz4" : "cached", Milliseconds(blocked) / options.saves, Milliseconds(worst), Milliseconds(std::chrono::steady_clock::now() - total));
+	}
+
+	bool success = RunChecks(options.directory);
+
+	if (!options.keep)
+	{
+		std::error_code ec;
+		std::filesystem::remove_all(options.directory, ec);
+	}
+
+	return success ? 0 : 1;
+}